@@ -0,0 +1,333 @@
+/*****************************************************************************
+ TripPlanner explores various issues common to navigation and booking systems.
+
+ Copyrights from the libraries used by the program:
+ - (c) 2017 Boost (www.boost.org)
+		License: <http://www.boost.org/LICENSE_1_0.txt>
+ 
+ (c) 2017 Florin Tulba <florintulba@yahoo.com>
+
+ This program is free software: you can use its results,
+ redistribute it and/or modify it under the terms of the GNU
+ Affero General Public License version 3 as published by the
+ Free Software Foundation.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU Affero General Public License for more details.
+
+ You should have received a copy of the GNU Affero General Public License
+ along with this program ('agpl-3.0.txt').
+ If not, see <http://www.gnu.org/licenses/agpl-3.0.txt>.
+ *****************************************************************************/
+
+#include "planner.h"
+#include "jsonSource.h"
+#include "constraints.h"
+#include "customDateTimeProcessor.h"
+#include "util.h"
+
+#pragma warning ( push, 0 )
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <thread>
+
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+
+#pragma warning ( pop )
+
+using namespace std;
+using namespace boost::posix_time;
+using namespace tp;
+using namespace tp::specs;
+using namespace tp::queries;
+
+/// The shape of the generated network and of the measured load
+struct Settings {
+  unsigned places = 500U;         ///< count of the places
+  unsigned routes = 200U;         ///< count of the routes
+  unsigned stops = 6U;            ///< stops per route
+  unsigned alternatives = 8U;     ///< alternatives (timetables) per route
+  double density = .7;            ///< chance of operating on each day of the week
+  size_t searches = 200ULL;       ///< searches performed for each count of threads
+  vector<unsigned> threads{ 1U, 2U, 4U, 8U }; ///< counts of the client threads
+  unsigned searchThreads = 1U;    ///< threads sharing the categories of a search
+  unsigned seed = 2017U;          ///< seed of the generator
+  string out;                     ///< where to save the scenario (optional)
+};
+
+/// @return the count of milliseconds between the 2 moments
+static double millisBetween(const chrono::steady_clock::time_point &from,
+                            const chrono::steady_clock::time_point &to) {
+  return chrono::duration<double, milli>(to - from).count();
+}
+
+/// @return minutes as `h:m`, allowing hours beyond 24 (for the next days)
+static string hoursAndMinutes(unsigned minutes) {
+  return to_string(minutes / 60U) + ':' + to_string(minutes % 60U);
+}
+
+/**
+Generates a scenario following the schema of input.json.
+
+The places lie on a grid whose cells are much larger than the walking
+distance, so the map contains no footpaths. The first routes chain
+the places one after the other, covering all of them and keeping
+the network connected. The rest of the routes visit random places.
+
+@throw invalid_argument when the routes cannot cover all the places
+*/
+static string generateScenario(const Settings &s) {
+  if(s.places < 2U || s.stops < 2U || s.stops > s.places ||
+     s.alternatives == 0U || s.density <= 0. || s.density > 1.)
+    throw invalid_argument(string(__func__) +
+                           " needs places >= stops >= 2, alternatives > 0 "
+                           "and density within (0, 1]!");
+  const unsigned chainRoutes = (s.places - 2U) / (s.stops - 1U) + 1U;
+  if(s.routes < chainRoutes)
+    throw invalid_argument(string(__func__) + " needs at least " +
+                           to_string(chainRoutes) + " routes to cover " +
+                           to_string(s.places) + " places with " +
+                           to_string(s.stops) + " stops per route!");
+
+  mt19937 rng(s.seed);
+  const auto below = [&rng] (unsigned limit) {
+    return uniform_int_distribution<unsigned>(0U, limit - 1U)(rng);
+  };
+
+  ostringstream oss;
+  oss<<fixed<<setprecision(4)<<"{\"Scenario\": {\n\"Places\": [";
+
+  const unsigned cols = (unsigned)ceil(sqrt(2. * s.places)),
+    rows = (s.places + cols - 1U) / cols;
+  for(unsigned i = 0U; i < s.places; ++i) {
+    const double lat = -70. + 140. * (i / cols) / max(rows - 1U, 1U),
+      lon = -175. + 350. * (i % cols) / max(cols - 1U, 1U);
+    oss<<(i ? ",\n" : "\n")<<"{\"id\": "<<i + 1U<<", \"names\": \"b"<<i + 1U
+      <<"\", \"lat\": "<<lat<<", \"long\": "<<lon<<'}';
+  }
+  oss<<"],\n\"Routes\": [";
+
+  static const char* modes[] { "Road", "Rail", "Water", "Air" };
+  static const unsigned kmPerHour[] { 70U, 100U, 30U, 600U };
+  vector<unsigned> stops(s.stops);
+  for(unsigned r = 0U; r < s.routes; ++r) {
+    if(r < chainRoutes) {
+      for(unsigned k = 0U; k < s.stops; ++k)
+        stops[k] = (r * (s.stops - 1U) + k) % s.places;
+    } else {
+      for(unsigned k = 0U; k < s.stops; ++k)
+        do stops[k] = below(s.places);
+        while(find(begin(stops), begin(stops) + k, stops[k]) !=
+              begin(stops) + k);
+    }
+
+    // Mostly rides on the ground; about 1 route in 10 uses planes
+    const unsigned mode = below(10U) == 0U ? 3U : below(3U);
+    oss<<(r ? ",\n" : "\n")<<"{\"RouteId\": "<<r + 1U
+      <<", \"TM\": \""<<modes[mode]<<"\", \"EF\": "<<1 + below(5U);
+    if(mode == 3U)
+      oss<<", \"BF\": 9, \"LFF\": 0.4, \"HFF\": 3.5";
+
+    vector<unsigned> dists(s.stops - 1U);
+    oss<<",\n \"Route\": {\"StartPlaceId\": "<<stops[0] + 1U<<", \"Links\": [";
+    for(unsigned k = 1U; k < s.stops; ++k) {
+      dists[k - 1U] = 20U + below(380U);
+      oss<<(k > 1U ? ", " : "")<<"{\"NextPlaceId\": "<<stops[k] + 1U
+        <<", \"dist\": "<<dists[k - 1U]<<'}';
+    }
+    oss<<"]},\n \"Alternatives\": [";
+
+    for(unsigned a = 0U; a < s.alternatives; ++a) {
+      string odw(7ULL, '0');
+      for(char &day : odw)
+        if(uniform_real_distribution<double>()(rng) < s.density)
+          day = '1';
+      odw[below(7U)] = '1';
+
+      // The stops follow each other within the next days, when necessary
+      unsigned minutes = below(24U * 60U);
+      string tt;
+      for(unsigned k = 0U; k + 1U < s.stops; ++k) {
+        const unsigned ride = max(5U, dists[k] * 60U / kmPerHour[mode]);
+        if(k > 0U)
+          tt += '|';
+        tt += hoursAndMinutes(minutes) + '-' + hoursAndMinutes(minutes + ride);
+        minutes += ride + 5U + below(20U);
+      }
+      oss<<(a ? ",\n  " : "\n  ")<<"{\"ESA\": "<<20U + below(180U);
+      if(mode == 3U)
+        oss<<", \"BSA\": 20";
+      oss<<", \"ReturnTrip\": "<<(a % 2U ? "true" : "false")
+        <<", \"TT\": \""<<tt<<'"';
+      // ODW must operate less than the route, which operates daily
+      if(odw.find('0') != string::npos)
+        oss<<", \"ODW\": \""<<odw<<'"';
+      oss<<'}';
+    }
+    oss<<"]}";
+  }
+  oss<<"]\n}}\n";
+  return oss.str();
+}
+
+/// @return the p-th percentile (0..100) of the sorted values
+static double percentile(const vector<double> &sorted, double p) {
+  if(sorted.empty())
+    return 0.;
+  const size_t rank = (size_t)ceil(p / 100. * sorted.size());
+  return sorted[rank ? rank - 1ULL : 0ULL];
+}
+
+/**
+Performs s.searches random searches shared by the client threads,
+each with the leave day dayOffset days from today, so that
+the rounds don't reuse each other`s cached results.
+Reports the latency percentiles and the throughput.
+*/
+static void measureSearches(const TripPlanner &tp, const Settings &s,
+                            unsigned clients, long dayOffset) {
+  const ptime leaveFirst(nowUTC().date() + boost::gregorian::days(dayOffset));
+  const TimeConstraints tc(time_period(leaveFirst, hours(24L)),
+                           time_period(leaveFirst, hours(72L)));
+
+  // The ends of the trips are drawn in advance, to keep the generator
+  // out of the measured interval
+  mt19937 rng(s.seed + (unsigned)dayOffset);
+  uniform_int_distribution<unsigned> place(1U, s.places);
+  vector<pair<string, string>> trips(s.searches);
+  for(auto &trip : trips) {
+    const unsigned from = place(rng);
+    unsigned to;
+    do to = place(rng); while(to == from);
+    trip = make_pair("b" + to_string(from), "b" + to_string(to));
+  }
+
+  vector<double> latencies(s.searches);
+  atomic<size_t> nextSearch{ 0ULL }, connected{ 0ULL }, failed{ 0ULL };
+  const auto client = [&] {
+    for(size_t i; (i = nextSearch++) < s.searches; ) {
+      const auto start = chrono::steady_clock::now();
+      try {
+        if(nullptr != tp.search(trips[i].first, trips[i].second, 4ULL, &tc))
+          ++connected;
+      } catch(exception&) {
+        ++failed;
+      }
+      latencies[i] = millisBetween(start, chrono::steady_clock::now());
+    }
+  };
+
+  const auto start = chrono::steady_clock::now();
+  vector<thread> workers;
+  for(unsigned c = 1U; c < clients; ++c)
+    workers.emplace_back(client);
+  client();
+  for(thread &worker : workers)
+    worker.join();
+  const double elapsed = millisBetween(start, chrono::steady_clock::now());
+
+  sort(begin(latencies), end(latencies));
+  cout<<setw(7)<<clients
+    <<setw(10)<<percentile(latencies, 50.)
+    <<setw(10)<<percentile(latencies, 90.)
+    <<setw(10)<<percentile(latencies, 99.)
+    <<setw(10)<<latencies.back()
+    <<setw(12)<<s.searches * 1000. / elapsed
+    <<setw(11)<<100. * connected / s.searches<<'%';
+  if(failed > 0ULL)
+    cout<<" ("<<failed<<" failed)";
+  cout<<endl;
+}
+
+/// @return the values from a comma-separated list, like `1,2,4`
+static vector<unsigned> parseList(const char *list) {
+  vector<unsigned> result;
+  istringstream iss(list);
+  for(string item; getline(iss, item, ','); )
+    result.push_back((unsigned)stoul(item));
+  return result;
+}
+
+/**
+Usage:
+  Benchmark [--places N] [--routes R] [--stops S] [--alternatives A]
+            [--density D] [--searches Q] [--threads 1,2,4,8]
+            [--search-threads K] [--seed X] [--out scenario.json]
+
+Generates a scenario with the given shape, optionally saving it to
+be used as input.json, and then reports:
+- the time to parse and validate it (JsonSource)
+- the time to build the map (TripPlanner)
+- the latency percentiles (milliseconds) and the throughput (searches / s)
+  of Q random searches performed by each count of client threads
+*/
+int main(int argc, const char* argv[]) {
+  Settings s;
+  try {
+    for(int i = 1; i < argc; ++i) {
+      if(i + 1 == argc)
+        throw invalid_argument("Missing the value of "s + argv[i]);
+      const char *option = argv[i], *value = argv[++i];
+      if(strcmp(option, "--places") == 0) s.places = (unsigned)stoul(value);
+      else if(strcmp(option, "--routes") == 0) s.routes = (unsigned)stoul(value);
+      else if(strcmp(option, "--stops") == 0) s.stops = (unsigned)stoul(value);
+      else if(strcmp(option, "--alternatives") == 0)
+        s.alternatives = (unsigned)stoul(value);
+      else if(strcmp(option, "--density") == 0) s.density = stod(value);
+      else if(strcmp(option, "--searches") == 0) s.searches = stoull(value);
+      else if(strcmp(option, "--threads") == 0) s.threads = parseList(value);
+      else if(strcmp(option, "--search-threads") == 0)
+        s.searchThreads = (unsigned)stoul(value);
+      else if(strcmp(option, "--seed") == 0) s.seed = (unsigned)stoul(value);
+      else if(strcmp(option, "--out") == 0) s.out = value;
+      else throw invalid_argument("Unknown option "s + option);
+    }
+    if(s.searches == 0ULL || s.threads.empty() ||
+       find(CBOUNDS(s.threads), 0U) != cend(s.threads))
+      throw invalid_argument("Needs some searches and client threads!");
+
+    auto start = chrono::steady_clock::now();
+    const string scenario = generateScenario(s);
+    cout<<"Generated "<<s.places<<" places and "<<s.routes<<" routes with "
+      <<s.stops<<" stops and "<<s.alternatives<<" alternatives ("
+      <<scenario.size() / 1024ULL<<" KB) in "
+      <<millisBetween(start, chrono::steady_clock::now())<<" ms"<<endl;
+    if(!s.out.empty())
+      ofstream(s.out)<<scenario;
+
+    // The scenario outlives the source, which keeps its address
+    start = chrono::steady_clock::now();
+    unique_ptr<JsonSource> infoSrc = make_unique<JsonSource>(scenario);
+    cout<<"JsonSource load: "<<millisBetween(start, chrono::steady_clock::now())
+      <<" ms"<<endl;
+
+    start = chrono::steady_clock::now();
+    const TripPlanner tp(move(infoSrc), nullptr, s.searchThreads);
+    cout<<"Map build:       "<<millisBetween(start, chrono::steady_clock::now())
+      <<" ms"<<endl;
+
+    cout<<"\n"<<s.searches<<" searches per row; latencies in ms\n"
+      <<"clients       p50       p90       p99       max  searches/s  connected"
+      <<endl;
+    cout<<fixed<<setprecision(2);
+    long dayOffset = 1L;
+    for(unsigned clients : s.threads)
+      measureSearches(tp, s, clients, dayOffset++);
+
+  } catch(exception &e) {
+    cerr<<e.what()<<endl;
+    return 1;
+  }
+  return 0;
+}
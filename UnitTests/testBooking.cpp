@@ -0,0 +1,336 @@
+/*****************************************************************************
+ TripPlanner explores various issues common to navigation and booking systems.
+
+ Copyrights from the libraries used by the program:
+ - (c) 2017 Boost (www.boost.org)
+		License: <http://www.boost.org/LICENSE_1_0.txt>
+ 
+ (c) 2017 Florin Tulba <florintulba@yahoo.com>
+
+ This program is free software: you can use its results,
+ redistribute it and/or modify it under the terms of the GNU
+ Affero General Public License version 3 as published by the
+ Free Software Foundation.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU Affero General Public License for more details.
+
+ You should have received a copy of the GNU Affero General Public License
+ along with this program ('agpl-3.0.txt').
+ If not, see <http://www.gnu.org/licenses/agpl-3.0.txt>.
+ *****************************************************************************/
+
+#include "CppUnitTest.h"
+#include "bookingSystem.h"
+#include "planner.h"
+#include "jsonSource.h"
+#include "customDateTimeProcessor.h"
+
+#include <stdexcept>
+#include <thread>
+#include <atomic>
+#include <fstream>
+#include <iterator>
+
+#include <boost/date_time/gregorian/parsers.hpp>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace std;
+using namespace boost::posix_time;
+using namespace boost::gregorian;
+using namespace boost::filesystem;
+using namespace tp;
+using namespace tp::var;
+using namespace tp::specs;
+using namespace tp::bookings;
+
+namespace UnitTests {
+	TEST_CLASS(Booking) {
+    const ptime refMoment = ptime(from_simple_string("2017-Sep-16"s));
+
+    // Route alternative 0 travels by road Monday - Friday and has 20 economy seats
+    const date monday = from_simple_string("2017-Sep-18"s);
+    const date sunday = from_simple_string("2017-Sep-17"s);
+
+  public:
+		TEST_METHOD(Booking_InvalidParams_Throws) {
+			Logger::WriteMessage(__FUNCTION__);
+
+      // Make sure the next 100 configurations of UDYA consider that 'today' is 2017-Sep-16
+      nowReplacements.resize(100ULL, refMoment);
+
+      try {
+        JsonSource js(path("../../UnitTests/TestFiles/specsOk.json"));
+        BookingSystem bs(js);
+        unsigned bookingId = 0U, maxPersons = 0U;
+
+        // No legs or no persons
+        Assert::ExpectException<invalid_argument>([&] {
+          bs.book({}, 1U, bookingId, maxPersons); });
+        Assert::ExpectException<invalid_argument>([&] {
+          bs.book({ Leg { 0U, monday, true } }, 0U, bookingId, maxPersons); });
+
+        // Route alternative 0 doesn't operate on Sundays
+        Assert::ExpectException<invalid_argument>([&] {
+          bs.book({ Leg { 0U, sunday, true } }, 1U, bookingId, maxPersons); });
+
+        // Unknown route alternative
+        Assert::ExpectException<domain_error>([&] {
+          bs.book({ Leg { 1000U, monday, true } }, 1U, bookingId, maxPersons); });
+
+        // Unknown booking
+        Assert::ExpectException<invalid_argument>([&] { bs.cancel(1234U, 1U); });
+
+        Assert::IsTrue(bs.book({ Leg { 0U, monday, true } }, 2U,
+                               bookingId, maxPersons));
+
+        // Cancel 0 or more than the booked persons
+        Assert::ExpectException<invalid_argument>([&] {
+          bs.cancel(bookingId, 0U); });
+        Assert::ExpectException<invalid_argument>([&] {
+          bs.cancel(bookingId, 3U); });
+        Assert::AreEqual(2U, bs.bookedPersons(bookingId));
+			} catch(exception &e) {
+				Logger::WriteMessage(e.what());
+				Assert::Fail();
+			}
+
+      nowReplacements.clear(); // don't influence other tests
+		}
+
+		TEST_METHOD(Booking_OverbookingAndCancel_ReportsAvailableSeats) {
+			Logger::WriteMessage(__FUNCTION__);
+
+      // Make sure the next 100 configurations of UDYA consider that 'today' is 2017-Sep-16
+      nowReplacements.resize(100ULL, refMoment);
+
+      try {
+        JsonSource js(path("../../UnitTests/TestFiles/specsOk.json"));
+        BookingSystem bs(js);
+        const Leg leg { 0U, monday, true };
+        unsigned bookingId1 = 0U, bookingId2 = 0U, maxPersons = 0U;
+
+        Assert::AreEqual(20U, bs.availableSeats(leg));
+        Assert::IsTrue(bs.book({ leg }, 15U, bookingId1, maxPersons));
+        Assert::AreEqual(5U, bs.availableSeats(leg));
+
+        // Not enough seats
+        Assert::IsFalse(bs.book({ leg }, 6U, bookingId2, maxPersons));
+        Assert::AreEqual(5U, maxPersons);
+        Assert::AreEqual(5U, bs.availableSeats(leg));
+
+        // Partial cancellation frees the seats and keeps the booking
+        bs.cancel(bookingId1, 4U);
+        Assert::AreEqual(11U, bs.bookedPersons(bookingId1));
+        Assert::AreEqual(9U, bs.availableSeats(leg));
+        Assert::IsTrue(bs.book({ leg }, 6U, bookingId2, maxPersons));
+        Assert::AreNotEqual(bookingId1, bookingId2);
+        Assert::AreEqual(3U, bs.availableSeats(leg));
+
+        // Full cancellation forgets the booking
+        bs.cancel(bookingId1, 11U);
+        Assert::AreEqual(0U, bs.bookedPersons(bookingId1));
+        Assert::AreEqual(14U, bs.availableSeats(leg));
+        Assert::ExpectException<invalid_argument>([&] {
+          bs.cancel(bookingId1, 1U); });
+
+        // Other dates are unaffected
+        Assert::AreEqual(20U,
+          bs.availableSeats(Leg { 0U, monday + days(1), true }));
+        Assert::AreEqual(0U, bs.availableSeats(Leg { 0U, sunday, true }));
+			} catch(exception &e) {
+				Logger::WriteMessage(e.what());
+				Assert::Fail();
+			}
+
+      nowReplacements.clear(); // don't influence other tests
+		}
+
+		TEST_METHOD(Booking_MultiLegWithFullLeg_ReservesNothing) {
+			Logger::WriteMessage(__FUNCTION__);
+
+      // Make sure the next 100 configurations of UDYA consider that 'today' is 2017-Sep-16
+      nowReplacements.resize(100ULL, refMoment);
+
+      try {
+        JsonSource js(path("../../UnitTests/TestFiles/specsOk.json"));
+        BookingSystem bs(js);
+
+        // Rail (raId 8) has 50 business seats; road (raId 0) has 20 economy seats
+        const Leg railLeg { 8U, monday, false }, roadLeg { 0U, monday, true };
+        unsigned bookingId = 0U, maxPersons = 0U;
+
+        Assert::IsTrue(bs.book({ roadLeg }, 18U, bookingId, maxPersons));
+
+        Assert::IsFalse(bs.book({ railLeg, roadLeg }, 3U, bookingId, maxPersons));
+        Assert::AreEqual(2U, maxPersons);
+        Assert::AreEqual(50U, bs.availableSeats(railLeg)); // rolled back
+        Assert::AreEqual(2U, bs.availableSeats(roadLeg));
+
+        Assert::IsTrue(bs.book({ railLeg, roadLeg }, 2U, bookingId, maxPersons));
+        Assert::AreEqual(48U, bs.availableSeats(railLeg));
+        Assert::AreEqual(0U, bs.availableSeats(roadLeg));
+        Assert::AreEqual(800U, bs.availableSeats(Leg { 8U, monday, true }));
+			} catch(exception &e) {
+				Logger::WriteMessage(e.what());
+				Assert::Fail();
+			}
+
+      nowReplacements.clear(); // don't influence other tests
+		}
+
+		TEST_METHOD(Booking_ConcurrentBookings_NeverOverbook) {
+			Logger::WriteMessage(__FUNCTION__);
+
+      // Make sure the next 100 configurations of UDYA consider that 'today' is 2017-Sep-16
+      nowReplacements.resize(100ULL, refMoment);
+
+      try {
+        JsonSource js(path("../../UnitTests/TestFiles/specsOk.json"));
+        BookingSystem bs(js);
+        const Leg roadLeg { 0U, monday, true }, railLeg { 8U, monday, false };
+        atomic<unsigned> succeeded(0U);
+
+        vector<thread> clients;
+        for(unsigned i = 0U; i < 8U; ++i)
+          clients.emplace_back([&] {
+            for(unsigned j = 0U; j < 10U; ++j) {
+              unsigned bookingId = 0U, maxPersons = 0U;
+              if(bs.book({ railLeg, roadLeg }, 1U, bookingId, maxPersons))
+                ++succeeded;
+            }
+          });
+        for(thread &client : clients)
+          client.join();
+
+        Assert::AreEqual(20U, succeeded.load());
+        Assert::AreEqual(0U, bs.availableSeats(roadLeg));
+        Assert::AreEqual(30U, bs.availableSeats(railLeg));
+			} catch(exception &e) {
+				Logger::WriteMessage(e.what());
+				Assert::Fail();
+			}
+
+      nowReplacements.clear(); // don't influence other tests
+		}
+
+		TEST_METHOD(Booking_SeatInventoryManyCounters_VisibleToReaders) {
+			Logger::WriteMessage(__FUNCTION__);
+
+      // The tables of the stripes get replaced several times meanwhile
+      SeatInventory inventory;
+      const shared_ptr<const IOccupancyView> view = inventory.view();
+      atomic<bool> done(false), wrongCount(false);
+      thread reader([&] {
+        while(!done)
+          for(unsigned raId = 0U; raId < 4U; ++raId)
+            for(long day = 0L; day < 1000L; ++day)
+              if(view->occupied(Leg { raId, monday + days(day), true }) > 1U)
+                wrongCount = true;
+      });
+
+      vector<thread> writers;
+      for(unsigned raId = 0U; raId < 4U; ++raId)
+        writers.emplace_back([&, raId] {
+          for(long day = 0L; day < 1000L; ++day) {
+            unsigned freeSeats = 0U;
+            inventory.tryOccupy(inventory.occupancy(raId, monday + days(day)).
+                                  seats(true), 1U, 1U, freeSeats);
+          }
+        });
+      for(thread &writer : writers)
+        writer.join();
+      done = true;
+      reader.join();
+
+      Assert::IsFalse(wrongCount);
+      for(unsigned raId = 0U; raId < 4U; ++raId)
+        for(long day = 0L; day < 1000L; ++day) {
+          const Leg leg { raId, monday + days(day), true };
+          Assert::AreEqual(1U, view->occupied(leg));
+          Assert::AreEqual(0U, inventory.occupied(Leg { raId, leg.date, false }));
+        }
+      Assert::IsNull(inventory.find(4U, monday));
+		}
+
+		TEST_METHOD(Booking_ChangedTimetableOrCalendar_ReportsAffectedBookings) {
+			Logger::WriteMessage(__FUNCTION__);
+
+      // Make sure the next 1000 configurations of UDYA consider that 'today' is 2017-Sep-16.
+      // Every reload of the specifications configures UDYA again
+      nowReplacements.resize(1000ULL, refMoment);
+
+      try {
+        ifstream ifs("../../UnitTests/TestFiles/specsOk.json");
+        string specs((istreambuf_iterator<char>(ifs)), istreambuf_iterator<char>());
+				TripPlanner tp(make_unique<JsonSource>(specs));
+
+        const date tuesday = monday + days(1);
+        unsigned id1 = 0U, id2 = 0U, id3 = 0U, id4 = 0U, id5 = 0U, maxPersons = 0U;
+        Assert::IsTrue(tp.book({ Leg { 0U, monday, true } }, 1U, id1, maxPersons));
+        Assert::IsTrue(tp.book({ Leg { 1U, monday, true } }, 1U, id2, maxPersons));
+        Assert::IsTrue(tp.book({ Leg { 8U, monday, true } }, 1U, id3, maxPersons));
+        Assert::IsTrue(tp.book({ Leg { 2U, monday, true },
+                                 Leg { 8U, tuesday, false } }, 2U, id4, maxPersons));
+        Assert::IsTrue(tp.book({ Leg { 0U, tuesday, true } }, 1U, id5, maxPersons));
+        tp.cancel(id5, 1U); // forgotten booking
+
+        // Reloading unchanged specifications affects no booking
+        tp.allowDataAccess(false);
+        tp.allowDataAccess(true);
+        Assert::IsTrue(tp.bookingsAffectedByLastUpdate().empty());
+
+        // Route alternative 0 leaves later and
+        // route alternative 8 doesn't operate on tuesday anymore
+        tp.allowDataAccess(false);
+        specs.replace(specs.find("\"7:30-9:0|9:10-10:15") + 1ULL, 4ULL, "7:45");
+        const string ra8Odw = "\"ODW\" : \"0111110\"}";
+        specs.replace(specs.find(ra8Odw), ra8Odw.size(),
+          "\"ODW\" : \"0111110\", "
+          "\"UDYA\" : \"Jan-1|Jan-2|Jan-3|Apr-4|July-4|Jul-14|Sep-19|Dec-25|Dec-31\"}");
+        tp.allowDataAccess(true);
+
+        const set<unsigned> &affected = tp.bookingsAffectedByLastUpdate();
+        Assert::AreEqual(2ULL, (unsigned long long)affected.size());
+        Assert::AreEqual(1ULL, (unsigned long long)affected.count(id1));
+        Assert::AreEqual(1ULL, (unsigned long long)affected.count(id4));
+			} catch(exception &e) {
+				Logger::WriteMessage(e.what());
+				Assert::Fail();
+			}
+
+      nowReplacements.clear(); // don't influence other tests
+		}
+
+		TEST_METHOD(Booking_ThroughPlannerWhenBlockedDataAccess_Throws) {
+			Logger::WriteMessage(__FUNCTION__);
+
+      // Make sure the next 100 configurations of UDYA consider that 'today' is 2017-Sep-16
+      nowReplacements.resize(100ULL, refMoment);
+
+      try {
+				TripPlanner tp(make_unique<JsonSource>(
+          path("../../UnitTests/TestFiles/specsOk.json")));
+        unsigned bookingId = 0U, maxPersons = 0U;
+        Assert::IsTrue(tp.book({ Leg { 0U, monday, true } }, 1U,
+                               bookingId, maxPersons));
+
+        tp.allowDataAccess(false);
+        Assert::ExpectException<runtime_error>([&] {
+          tp.book({ Leg { 0U, monday, true } }, 1U, bookingId, maxPersons); });
+        Assert::ExpectException<runtime_error>([&] {
+          tp.cancel(bookingId, 1U); });
+        tp.allowDataAccess(true);
+
+        tp.cancel(bookingId, 1U);
+			} catch(exception &e) {
+				Logger::WriteMessage(e.what());
+				Assert::Fail();
+			}
+
+      nowReplacements.clear(); // don't influence other tests
+		}
+	};
+}
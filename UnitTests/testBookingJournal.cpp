@@ -0,0 +1,230 @@
+/*****************************************************************************
+ TripPlanner explores various issues common to navigation and booking systems.
+
+ Copyrights from the libraries used by the program:
+ - (c) 2017 Boost (www.boost.org)
+		License: <http://www.boost.org/LICENSE_1_0.txt>
+ 
+ (c) 2017 Florin Tulba <florintulba@yahoo.com>
+
+ This program is free software: you can use its results,
+ redistribute it and/or modify it under the terms of the GNU
+ Affero General Public License version 3 as published by the
+ Free Software Foundation.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU Affero General Public License for more details.
+
+ You should have received a copy of the GNU Affero General Public License
+ along with this program ('agpl-3.0.txt').
+ If not, see <http://www.gnu.org/licenses/agpl-3.0.txt>.
+ *****************************************************************************/
+
+#include "CppUnitTest.h"
+#include "bookingSystem.h"
+#include "jsonSource.h"
+#include "customDateTimeProcessor.h"
+
+#include <stdexcept>
+#include <fstream>
+#include <thread>
+
+#include <boost/date_time/gregorian/parsers.hpp>
+#include <boost/filesystem/operations.hpp>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace std;
+using namespace boost::posix_time;
+using namespace boost::gregorian;
+using namespace boost::filesystem;
+using namespace tp;
+using namespace tp::var;
+using namespace tp::specs;
+using namespace tp::bookings;
+
+namespace UnitTests {
+	TEST_CLASS(BookingJournal) {
+    const ptime refMoment = ptime(from_simple_string("2017-Sep-16"s));
+    const date monday = from_simple_string("2017-Sep-18"s);
+
+    // Route alternative 0 travels by road and has 20 economy seats
+    // Route alternative 8 travels by rail and has 800 economy seats
+    const Leg roadLeg { 0U, monday, true }, railLeg { 8U, monday, true };
+
+  public:
+		TEST_METHOD(BookingJournal_Restart_RecoversBookings) {
+			Logger::WriteMessage(__FUNCTION__);
+
+      // Make sure the next 100 configurations of UDYA consider that 'today' is 2017-Sep-16
+      nowReplacements.resize(100ULL, refMoment);
+
+      const path dir = temp_directory_path() / unique_path();
+      try {
+        JsonSource js(path("../../UnitTests/TestFiles/specsOk.json"));
+        unsigned id1 = 0U, id2 = 0U, id3 = 0U, maxPersons = 0U;
+        {
+          BookingSystem bs(js, make_unique<tp::bookings::BookingJournal>(dir));
+          Assert::IsTrue(bs.book({ roadLeg, railLeg }, 5U, id1, maxPersons));
+          Assert::IsTrue(bs.book({ roadLeg }, 4U, id2, maxPersons));
+          Assert::IsTrue(bs.book({ railLeg }, 7U, id3, maxPersons));
+          bs.cancel(id1, 2U);
+          bs.cancel(id2, 4U);
+        }
+
+        // The journal was compacted once, at the first start.
+        // Now the records are replayed
+        BookingSystem bs(js, make_unique<tp::bookings::BookingJournal>(dir));
+        Assert::AreEqual(3U, bs.bookedPersons(id1));
+        Assert::AreEqual(0U, bs.bookedPersons(id2));
+        Assert::AreEqual(7U, bs.bookedPersons(id3));
+        Assert::AreEqual(17U, bs.availableSeats(roadLeg));
+        Assert::AreEqual(790U, bs.availableSeats(railLeg));
+
+        // The recovered bookings can be cancelled and the ids aren't reused
+        bs.cancel(id3, 7U);
+        Assert::AreEqual(797U, bs.availableSeats(railLeg));
+        unsigned id4 = 0U;
+        Assert::IsTrue(bs.book({ roadLeg }, 1U, id4, maxPersons));
+        Assert::IsTrue(id4 > id3);
+			} catch(exception &e) {
+				Logger::WriteMessage(e.what());
+				Assert::Fail();
+			}
+
+      remove_all(dir);
+      nowReplacements.clear(); // don't influence other tests
+		}
+
+		TEST_METHOD(BookingJournal_SnapshotAndTornRecord_RecoversDurableRecords) {
+			Logger::WriteMessage(__FUNCTION__);
+
+      Assert::ExpectException<invalid_argument>([] {
+        tp::bookings::BookingJournal bj(temp_directory_path(), 0ULL); });
+
+      const path dir = temp_directory_path() / unique_path();
+      try {
+        {
+          tp::bookings::BookingJournal bj(dir, 2ULL);
+          bj.bookingDone(1U, { roadLeg }, 2U);
+          bj.bookingDone(2U, { railLeg, roadLeg }, 3U); // triggers a snapshot
+          bj.cancellationDone(1U, 1U);
+          Assert::AreEqual(3ULL, (unsigned long long)bj.durableSequence());
+
+          // Only the record after the snapshot is still in the journal
+          Assert::IsTrue(file_size(dir / "bookings.journal") > 0ULL);
+          bj.compact();
+          Assert::AreEqual(0ULL,
+                           (unsigned long long)file_size(dir / "bookings.journal"));
+          bj.bookingDone(3U, { railLeg }, 4U);
+        }
+
+        // Simulate a crash while writing a record, which still parses:
+        // it might have been the cancellation of 12 persons
+        {
+          ofstream ofs((dir / "bookings.journal").string(), ios::app);
+          ofs<<"C 5 3 1";
+        }
+
+        tp::bookings::BookingJournal bj(dir, 2ULL);
+        const auto &bookings = bj.activeBookings();
+        Assert::AreEqual(3ULL, (unsigned long long)bookings.size());
+        Assert::AreEqual(1U, bookings.at(1U).persons);
+        Assert::AreEqual(3U, bookings.at(2U).persons);
+        Assert::AreEqual(2ULL, (unsigned long long)bookings.at(2U).legs.size());
+        Assert::IsTrue(bookings.at(2U).legs[1ULL].date == monday);
+        Assert::AreEqual(4U, bookings.at(3U).persons);
+        Assert::AreEqual(4U, bj.nextBookingId());
+			} catch(exception &e) {
+				Logger::WriteMessage(e.what());
+				Assert::Fail();
+			}
+
+      remove_all(dir);
+		}
+
+		TEST_METHOD(BookingJournal_ConcurrentBookings_AllDurable) {
+			Logger::WriteMessage(__FUNCTION__);
+
+      // Make sure the next 100 configurations of UDYA consider that 'today' is 2017-Sep-16
+      nowReplacements.resize(100ULL, refMoment);
+
+      const path dir = temp_directory_path() / unique_path();
+      try {
+        JsonSource js(path("../../UnitTests/TestFiles/specsOk.json"));
+        {
+          auto journal = make_unique<tp::bookings::BookingJournal>(dir, 25ULL);
+          const tp::bookings::BookingJournal &bj = *journal;
+          BookingSystem bs(js, move(journal));
+
+          vector<thread> clients;
+          for(unsigned i = 0U; i < 8U; ++i)
+            clients.emplace_back([&] {
+              for(unsigned j = 0U; j < 10U; ++j) {
+                unsigned bookingId = 0U, maxPersons = 0U;
+                bs.book({ railLeg }, 1U, bookingId, maxPersons);
+              }
+            });
+          for(thread &client : clients)
+            client.join();
+
+          Assert::AreEqual(80ULL, (unsigned long long)bj.durableSequence());
+          Assert::IsTrue(bj.groupCommits() <= 80ULL);
+        }
+
+        BookingSystem bs(js, make_unique<tp::bookings::BookingJournal>(dir));
+        Assert::AreEqual(720U, bs.availableSeats(railLeg));
+			} catch(exception &e) {
+				Logger::WriteMessage(e.what());
+				Assert::Fail();
+			}
+
+      remove_all(dir);
+      nowReplacements.clear(); // don't influence other tests
+		}
+
+		TEST_METHOD(BookingJournal_ConcurrentCancellations_ForgetBookingOnce) {
+			Logger::WriteMessage(__FUNCTION__);
+
+      // Make sure the next 100 configurations of UDYA consider that 'today' is 2017-Sep-16
+      nowReplacements.resize(100ULL, refMoment);
+
+      const path dir = temp_directory_path() / unique_path();
+      try {
+        JsonSource js(path("../../UnitTests/TestFiles/specsOk.json"));
+        {
+          auto journal = make_unique<tp::bookings::BookingJournal>(dir);
+          const tp::bookings::BookingJournal &bj = *journal;
+          BookingSystem bs(js, move(journal));
+
+          unsigned bookingId = 0U, maxPersons = 0U;
+          Assert::IsTrue(bs.book({ railLeg }, 8U, bookingId, maxPersons));
+
+          // Each client cancels 1 person, while the others wait for the journal
+          vector<thread> clients;
+          for(unsigned i = 0U; i < 8U; ++i)
+            clients.emplace_back([&] { bs.cancel(bookingId, 1U); });
+          for(thread &client : clients)
+            client.join();
+
+          Assert::AreEqual(9ULL, (unsigned long long)bj.durableSequence());
+          Assert::AreEqual(0U, bs.bookedPersons(bookingId));
+          Assert::AreEqual(800U, bs.availableSeats(railLeg));
+          Assert::ExpectException<invalid_argument>([&] {
+            bs.cancel(bookingId, 1U);
+          });
+        }
+
+        BookingSystem bs(js, make_unique<tp::bookings::BookingJournal>(dir));
+        Assert::AreEqual(800U, bs.availableSeats(railLeg));
+			} catch(exception &e) {
+				Logger::WriteMessage(e.what());
+				Assert::Fail();
+			}
+
+      remove_all(dir);
+      nowReplacements.clear(); // don't influence other tests
+		}
+	};
+}
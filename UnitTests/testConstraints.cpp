@@ -78,4 +78,58 @@ namespace UnitTests {
 			}
 		}
 	};
+
+	TEST_CLASS(PlaceConstraints) {
+	public:
+		TEST_METHOD(PlaceConstraints_VariousCtorParams_NormalizedOrThrows) {
+			Logger::WriteMessage(__FUNCTION__);
+
+			// Too many via places
+			Assert::ExpectException<invalid_argument>([] {
+				::PlaceConstraints pc({ 1U, 2U, 3U, 4U, 5U });
+			});
+
+			// A place both to pass through and to avoid
+			Assert::ExpectException<invalid_argument>([] {
+				::PlaceConstraints pc({ 1U, 2U }, { 3U, 2U });
+			});
+
+			try {
+				// Duplicates don't count
+				const ::PlaceConstraints pc({ 4U, 2U, 4U, 3U, 1U, 2U },
+											{ 7U, 5U, 7U }, { 9U, 8U });
+				Assert::IsTrue(vector<unsigned>({ 1U, 2U, 3U, 4U }) == pc.viaPlaces());
+				Assert::IsTrue(vector<unsigned>({ 5U, 7U }) == pc.avoidedPlaces());
+				Assert::IsTrue(vector<unsigned>({ 8U, 9U }) == pc.avoidedRoutes());
+
+				const ::PlaceConstraints none;
+				Assert::IsTrue(none.viaPlaces().empty());
+				Assert::IsTrue(none.avoidedPlaces().empty());
+				Assert::IsTrue(none.avoidedRoutes().empty());
+			} catch(exception &e) {
+				Logger::WriteMessage(e.what());
+				Assert::Fail();
+			}
+		}
+	};
+
+	TEST_CLASS(SearchLimits) {
+	public:
+		TEST_METHOD(SearchLimits_DeadlineOrCancellation_Exceeded) {
+			Logger::WriteMessage(__FUNCTION__);
+
+			const ::SearchLimits unlimited;
+			Assert::IsFalse(unlimited.exceeded());
+
+			const ::SearchLimits expired(chrono::milliseconds(0));
+			Assert::IsTrue(expired.exceeded());
+
+			CancellationToken token;
+			const ::SearchLimits cancellable(chrono::hours(1), &token);
+			Assert::IsFalse(cancellable.exceeded());
+			token.cancel();
+			Assert::IsTrue(token.cancelled());
+			Assert::IsTrue(cancellable.exceeded());
+		}
+	};
 }
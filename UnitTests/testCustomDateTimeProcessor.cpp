@@ -25,6 +25,9 @@
 #include "CppUnitTest.h"
 #include "customDateTimeProcessor.h"
 
+#include <thread>
+#include <set>
+
 #include <boost/date_time/posix_time/posix_time_types.hpp>
 #include <boost/date_time/gregorian/parsers.hpp>
 #include <boost/date_time/posix_time/time_parsers.hpp>
@@ -73,5 +76,71 @@ namespace UnitTests {
 				ptime(from_simple_string("2017-Jan-25"s), duration_from_string("22:50"s))).
 				compare("Wed Jan-25-2017 22:50"));
 		}
+
+		TEST_METHOD(BufferFormatters_VariousValues_SameTextAsStringFormatters) {
+			Logger::WriteMessage(__FUNCTION__);
+
+			char timeText[TimePointBufferSize];
+			const ptime moments[] {
+				ptime(from_simple_string("2017-Oct-7"s), duration_from_string("0:0"s)),
+				ptime(from_simple_string("2018-Dec-31"s), duration_from_string("23:59"s)),
+				ptime(from_simple_string("9999-Sep-30"s), duration_from_string("12:5"s))
+			};
+			for(const ptime &mom : moments) {
+				const string expected = formatTimePoint(mom);
+				Assert::AreEqual(expected.size(), formatTimePoint(mom, timeText));
+				Assert::AreEqual(expected, string(timeText));
+			}
+			formatTimePoint(moments[0], timeText);
+			Assert::AreEqual("Sat Oct-7-2017 00:00"s, string(timeText));
+
+			char durationText[DurationBufferSize];
+			Assert::AreEqual(27ULL, (unsigned long long)
+				formatDuration(hours(49) + minutes(1), durationText));
+			Assert::AreEqual("2 days, 1 hour and 1 minute"s, string(durationText));
+			formatDuration(hours(100'000'000) + minutes(59), durationText);
+			Assert::AreEqual("4166666 days, 16 hours and 59 minutes"s, string(durationText));
+			formatDuration(minutes(-90), durationText);
+			Assert::AreEqual("-1 hour and 30 minutes"s, string(durationText));
+		}
+	};
+
+	TEST_CLASS(NowUTC) {
+	public:
+		TEST_METHOD(NowUTC_ReplacementsFromSeveralThreads_EachReportedOnce) {
+			Logger::WriteMessage(__FUNCTION__);
+
+			const ptime start(from_simple_string("2017-Oct-17"s));
+			const size_t threadsCount = 4ULL, callsPerThread = 250ULL;
+			nowReplacements.clear();
+			for(size_t i = 0ULL; i < threadsCount * callsPerThread; ++i)
+				nowReplacements.push_back(start + minutes(long(i)));
+
+			vector<vector<ptime>> reported(threadsCount);
+			vector<thread> threads;
+			for(size_t t = 0ULL; t < threadsCount; ++t)
+				threads.emplace_back([&reported, t, callsPerThread] {
+					for(size_t i = 0ULL; i < callsPerThread; ++i)
+						reported[t].push_back(nowUTC());
+				});
+			for(thread &th : threads)
+				th.join();
+
+			Assert::IsTrue(nowReplacements.empty());
+			set<ptime> distinct;
+			for(const vector<ptime> &moments : reported)
+				distinct.insert(cbegin(moments), cend(moments));
+			Assert::AreEqual((unsigned long long)(threadsCount * callsPerThread),
+							 (unsigned long long)distinct.size());
+			Assert::IsTrue(start == *distinct.begin());
+
+			// Without replacements, the cached clock reports the actual moment
+			nowReplacements.resize(1ULL, start);
+			Assert::AreEqual(25'136'640LL, nowUTCMinutes());
+			const ptime before = second_clock::universal_time();
+			const ptime now = nowUTC();
+			Assert::IsTrue(now + seconds(1) >= before);
+			Assert::IsTrue(now <= second_clock::universal_time());
+		}
 	};
 }
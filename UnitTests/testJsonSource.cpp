@@ -212,6 +212,20 @@ namespace UnitTests {
 					r1.nthDistance(5U, false); // max index is 4
 				});
 
+				// Legs covering several stops
+				Assert::AreEqual(0.f, r1.legDistance(2U, 2U, false), 1e-3f);
+				Assert::AreEqual(70.2f + 93.4f + 115.9f,
+								 r1.legDistance(1U, 4U, false), 1e-3f);
+				Assert::AreEqual(208.6f + 115.9f,
+								 r1.legDistance(0U, 2U, true), 1e-3f);
+				Assert::AreEqual(578.6f, r1.legDistance(0U, 5U, true), 1e-3f);
+				Assert::ExpectException<out_of_range>([&r1] {
+					r1.legDistance(0U, 6U, false); // max index is 5
+				});
+				Assert::ExpectException<out_of_range>([&r1] {
+					r1.legDistance(3U, 2U, true); // fromIdx > toIdx
+				});
+
 				vector<unsigned> expectedStops { 1U, 2U, 3U, 4U, 5U, 6U };
 				const vector<unsigned> &returnedStops = r1.traversedStops();
 				Assert::IsTrue(equal(CBOUNDS(expectedStops),
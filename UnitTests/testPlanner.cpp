@@ -25,11 +25,21 @@
 #include "CppUnitTest.h"
 #include "planner.h"
 #include "jsonSource.h"
+#include "constraints.h"
+#include "resultsSerializer.h"
+#include "requestServer.h"
 #include "customDateTimeProcessor.h"
 
 #include <stdexcept>
+#include <functional>
+#include <algorithm>
+#include <cmath>
+#include <future>
+#include <sstream>
+#include <fstream>
 
 #include <boost/date_time/gregorian/parsers.hpp>
+#include <boost/filesystem/operations.hpp>
 
 using namespace Microsoft::VisualStudio::CppUnitTestFramework;
 using namespace std;
@@ -39,6 +49,7 @@ using namespace boost::filesystem;
 using namespace tp;
 using namespace tp::var;
 using namespace tp::specs;
+using namespace tp::queries;
 
 namespace UnitTests {
 	TEST_CLASS(Planner) {
@@ -52,6 +63,7 @@ namespace UnitTests {
 
       using TripPlanner::infoSrc;
       using TripPlanner::pickPlace;
+      using TripPlanner::resultsCache;
     };
 
   public:
@@ -128,6 +140,1023 @@ namespace UnitTests {
       nowReplacements.clear(); // don't influence other tests
     }
 
+    TEST_METHOD(Planner_SearchRoadTrip_SortedVariants) {
+      Logger::WriteMessage(__FUNCTION__);
+
+      // Make sure the next 100 configurations of UDYA consider that 'today' is 2017-Sep-16
+      nowReplacements.resize(100ULL, refMoment);
+
+      try {
+        TripPlanner tp(make_unique<JsonSource>(
+          path("../../UnitTests/TestFiles/specsOk.json")));
+
+        // Leave p2 on Monday 2017-Sep-18 and arrive at p4 within 2 days
+        const ptime monday(from_simple_string("2017-Sep-18"s));
+        const TimeConstraints tc(time_period(monday, hours(24)),
+                                 time_period(monday, hours(48)));
+        const unique_ptr<IResults> results =
+          tp.search("p2"s, "p4"s, 4ULL, &tc);
+        Assert::IsNotNull(results.get());
+
+        const size_t categories = variantCategories().size();
+        for(size_t categ = 0ULL; categ < categories; ++categ) {
+          const auto &variants = (*results)[categ].get();
+          Assert::AreEqual(4ULL, (unsigned long long)variants.size());
+          for(const auto &variant : variants) {
+            Assert::AreEqual(2ULL, (unsigned long long)variant->from());
+            Assert::AreEqual(4ULL, (unsigned long long)variant->to());
+            Assert::IsTrue(tc.leavePeriod().contains(variant->begin()));
+            Assert::IsTrue(tc.arrivePeriod().contains(variant->end()));
+          }
+          for(size_t i = 1ULL; i < variants.size(); ++i) {
+            const IVariant &prev = *variants[i - 1ULL], &crt = *variants[i];
+            switch(categ) {
+              case 0ULL:
+                Assert::IsTrue(prev.duration() <= crt.duration()); break;
+              case 1ULL:
+                Assert::IsTrue(prev.price() <= crt.price()); break;
+              case 2ULL:
+                Assert::IsTrue(prev.distance() <= crt.distance()); break;
+              case 3ULL:
+                Assert::IsTrue(prev.end() <= crt.end()); break;
+              default:;
+            }
+          }
+        }
+
+        // The road alternative leaving p2 at 19:40 reaches p4 at 22:00
+        const IVariant &mostRapid = *(*results)[0ULL].get().front();
+        Assert::AreEqual(1ULL, (unsigned long long)mostRapid.connections().size());
+        Assert::IsTrue(mostRapid.begin() == monday + hours(19) + minutes(40));
+        Assert::IsTrue(mostRapid.end() == monday + hours(22));
+
+        // The road alternative leaving p2 at 9:10 reaches p4 at 12:00
+        const IVariant &soonest = *(*results)[3ULL].get().front();
+        Assert::IsTrue(soonest.end() == monday + hours(12));
+
+        // Both the distance and the price are the same for the direct variants
+        Assert::AreEqual(93.4f + 70.2f, (*results)[2ULL].get().front()->distance());
+        Assert::AreEqual((*results)[1ULL].get()[0ULL]->price(),
+                         (*results)[1ULL].get()[1ULL]->price());
+
+      } catch(exception &e) {
+        Logger::WriteMessage(e.what());
+        Assert::Fail();
+      }
+
+      nowReplacements.clear(); // don't influence other tests
+    }
+
+    TEST_METHOD(Planner_SearchWithSeatsConstraints_SkipsFullConnections) {
+      Logger::WriteMessage(__FUNCTION__);
+
+      // Make sure the next 100 configurations of UDYA consider that 'today' is 2017-Sep-16
+      nowReplacements.resize(100ULL, refMoment);
+
+      try {
+        TripPlanner tp(make_unique<JsonSource>(
+          path("../../UnitTests/TestFiles/specsOk.json")));
+
+        const ptime monday(from_simple_string("2017-Sep-18"s));
+        const TimeConstraints tc(time_period(monday, hours(24)),
+                                 time_period(monday, hours(48)));
+
+        Assert::ExpectException<invalid_argument>([] { SeatsConstraints sc(0U); });
+
+        // The road has no business class
+        const SeatsConstraints businessSeat(1U, false);
+        Assert::IsNull(tp.search("p2"s, "p4"s, 4ULL, &tc, &businessSeat).get());
+
+        // Leave only 2 free seats on the road alternative (id 3) leaving p2 at 19:40
+        unsigned bookingId = 0U, maxPersons = 0U;
+        Assert::IsTrue(tp.book({ bookings::Leg { 3U, monday.date(), true } },
+                               48U, bookingId, maxPersons));
+
+        const SeatsConstraints twoPersons(2U), threePersons(3U);
+        const ptime fastestDeparture = monday + hours(19) + minutes(40);
+        Assert::IsTrue(fastestDeparture ==
+          (*tp.search("p2"s, "p4"s, 1ULL, &tc))[0ULL].get().front()->begin());
+        Assert::IsTrue(fastestDeparture ==
+          (*tp.search("p2"s, "p4"s, 1ULL, &tc, &twoPersons))[0ULL].
+            get().front()->begin());
+        Assert::IsTrue(fastestDeparture !=
+          (*tp.search("p2"s, "p4"s, 1ULL, &tc, &threePersons))[0ULL].
+            get().front()->begin());
+
+        // The cancellation makes the seats available again
+        tp.cancel(bookingId, 1U);
+        Assert::IsTrue(fastestDeparture ==
+          (*tp.search("p2"s, "p4"s, 1ULL, &tc, &threePersons))[0ULL].
+            get().front()->begin());
+
+        // When the earliest departure is full, every category tries the next
+        // ones: only the road alternative 3 leaving on Tuesday has seats left
+        const date tuesday = monday.date() + days(1);
+        Assert::IsTrue(tp.book({ bookings::Leg { 0U, tuesday, true } },
+                               18U, bookingId, maxPersons));
+        Assert::IsTrue(tp.book({ bookings::Leg { 1U, tuesday, true } },
+                               48U, bookingId, maxPersons));
+        Assert::IsTrue(tp.book({ bookings::Leg { 2U, tuesday, true } },
+                               48U, bookingId, maxPersons));
+        Assert::IsTrue(tp.book({ bookings::Leg { 3U, monday.date(), true } },
+                               1U, bookingId, maxPersons));
+        const TimeConstraints tcNextDay(
+          time_period(fastestDeparture - minutes(30), hours(25)),
+          time_period(fastestDeparture - minutes(30), hours(28)));
+        const unique_ptr<IResults> nextDay =
+          tp.search("p2"s, "p4"s, 1ULL, &tcNextDay, &threePersons);
+        Assert::IsNotNull(nextDay.get());
+        for(size_t categ = 0ULL; categ < variantCategories().size(); ++categ) {
+          Assert::AreEqual(1ULL, (unsigned long long)(*nextDay)[categ].get().size());
+          Assert::IsTrue(fastestDeparture + hours(24) ==
+            (*nextDay)[categ].get().front()->begin());
+        }
+
+      } catch(exception &e) {
+        Logger::WriteMessage(e.what());
+        Assert::Fail();
+      }
+
+      nowReplacements.clear(); // don't influence other tests
+    }
+
+    TEST_METHOD(Planner_SearchFlightsWhileBooking_PricesFollowOccupancy) {
+      Logger::WriteMessage(__FUNCTION__);
+
+      // Make sure the next 100 configurations of UDYA consider that 'today' is 2017-Sep-16
+      nowReplacements.resize(100ULL, refMoment);
+
+      try {
+        TripPlanner tp(make_unique<JsonSource>(
+          path("../../UnitTests/TestFiles/specsOk.json")));
+
+        // The flight from p14 to p13 (route alternative 12) leaves at 8:00.
+        // Half a year ahead, the urgency is low enough to let the occupancy
+        // decide the price
+        const ptime day(from_simple_string("2018-Mar-19"s));
+        const TimeConstraints tc(time_period(day, hours(24)),
+                                 time_period(day, hours(24)));
+        const auto flightPrice = [&] {
+          return (*tp.search("p14"s, "p13"s, 1ULL, &tc))[1ULL].
+            get().front()->price(); };
+
+        const float emptyFlightPrice = flightPrice();
+        Assert::AreEqual(emptyFlightPrice, flightPrice()); // cached factor
+
+        // Leave only 10 of the 180 economy seats
+        unsigned bookingId = 0U, maxPersons = 0U;
+        Assert::IsTrue(tp.book({ bookings::Leg { 12U, day.date(), true } },
+                               170U, bookingId, maxPersons));
+        const float almostFullFlightPrice = flightPrice();
+        Assert::IsTrue(almostFullFlightPrice > emptyFlightPrice);
+
+        // Business class seats don't share the occupancy with the economy ones
+        const SeatsConstraints businessSeat(1U, false);
+        const float businessPrice = (*tp.search("p14"s, "p13"s, 1ULL, &tc,
+                                                &businessSeat))[1ULL].
+          get().front()->price();
+        Assert::IsTrue(businessPrice < almostFullFlightPrice);
+
+        // The cancellation lowers the price back
+        tp.cancel(bookingId, 170U);
+        Assert::AreEqual(emptyFlightPrice, flightPrice());
+
+      } catch(exception &e) {
+        Logger::WriteMessage(e.what());
+        Assert::Fail();
+      }
+
+      nowReplacements.clear(); // don't influence other tests
+    }
+
+    TEST_METHOD(Planner_RepeatedSearches_ReuseResultsUntilInvalidated) {
+      Logger::WriteMessage(__FUNCTION__);
+
+      // Make sure the next 100 configurations of UDYA consider that 'today' is 2017-Sep-16
+      nowReplacements.resize(100ULL, refMoment);
+
+      try {
+        DerivedTripPlanner tp(make_unique<JsonSource>(
+          path("../../UnitTests/TestFiles/specsOk.json")));
+
+        const ptime monday(from_simple_string("2017-Sep-18"s));
+        const TimeConstraints tc(time_period(monday, hours(24)),
+                                 time_period(monday, hours(48)));
+        const ptime fastestDeparture = monday + hours(19) + minutes(40);
+        const auto fastestBegin = [&] {
+          return (*tp.search("p2"s, "p4"s, 1ULL, &tc))[0ULL].at(0ULL).begin();
+        };
+
+        Assert::IsTrue(fastestDeparture == fastestBegin());
+        Assert::AreEqual(1ULL, (unsigned long long)tp.resultsCache.size());
+        Assert::IsTrue(fastestDeparture == fastestBegin()); // reused
+        Assert::AreEqual(1ULL, (unsigned long long)tp.resultsCache.size());
+
+        // Searches leaving within the same 15 minutes share an entry
+        const auto fromMinute = [&] (long m) {
+          return TimeConstraints(time_period(monday + minutes(m), hours(24)),
+                                 time_period(monday + minutes(m), hours(48)));
+        };
+        const TimeConstraints tc3 = fromMinute(3L), tc11 = fromMinute(11L);
+        tp.search("p2"s, "p4"s, 1ULL, &tc3);
+        tp.search("p2"s, "p4"s, 1ULL, &tc11);
+        Assert::AreEqual(2ULL, (unsigned long long)tp.resultsCache.size());
+
+        // Other constraints mean another entry
+        const SeatsConstraints twoPersons(2U);
+        tp.search("p2"s, "p4"s, 1ULL, &tc, &twoPersons);
+        Assert::AreEqual(3ULL, (unsigned long long)tp.resultsCache.size());
+
+        // Booking the flight p14 - p13 (route alternative 12) keeps the entries
+        unsigned bookingId = 0U, maxPersons = 0U;
+        Assert::IsTrue(tp.book({ bookings::Leg { 12U, monday.date(), true } },
+                               1U, bookingId, maxPersons));
+        Assert::AreEqual(3ULL, (unsigned long long)tp.resultsCache.size());
+
+        // ...and doesn't prevent remembering the searches started before it
+        const uint64_t observed = tp.resultsCache.version();
+        Assert::IsTrue(tp.book({ bookings::Leg { 12U, monday.date(), true } },
+                               1U, bookingId, maxPersons));
+        tp.resultsCache.insert(ResultsCache::keyOf(1U, 2U, 1ULL, tc, nullptr,
+                                                   TranspModes::all, nullptr,
+                                                   0L),
+                               nullptr, observed);
+        Assert::AreEqual(4ULL, (unsigned long long)tp.resultsCache.size());
+
+        // Booking the road alternative (id 3) leaving p2 at 19:40 forgets them,
+        // except the entry from above, which uses no route alternatives
+        Assert::IsTrue(tp.book({ bookings::Leg { 3U, monday.date(), true } },
+                               49U, bookingId, maxPersons));
+        Assert::AreEqual(1ULL, (unsigned long long)tp.resultsCache.size());
+        Assert::IsTrue(fastestDeparture == fastestBegin());
+        Assert::IsTrue(fastestDeparture !=
+          (*tp.search("p2"s, "p4"s, 1ULL, &tc, &twoPersons))[0ULL].
+            at(0ULL).begin());
+
+        // Cancellations and updates of the specifications forget everything
+        tp.cancel(bookingId, 1U);
+        Assert::AreEqual(0ULL, (unsigned long long)tp.resultsCache.size());
+        fastestBegin();
+        tp.allowDataAccess(false);
+        tp.allowDataAccess(true);
+        Assert::AreEqual(0ULL, (unsigned long long)tp.resultsCache.size());
+
+        // The variants leaving right at the end of the leave period are found
+        const TimeConstraints tcUntilFastest(
+          time_period(monday, fastestDeparture),
+          time_period(monday, hours(48)));
+        Assert::IsTrue(fastestDeparture ==
+          (*tp.search("p2"s, "p4"s, 1ULL, &tcUntilFastest))[0ULL].at(0ULL).begin());
+        Assert::AreEqual(1ULL, (unsigned long long)tp.resultsCache.size());
+
+        // Searches within the same buckets share the results over the whole
+        // buckets, but keep only their own variants
+        const auto fromMoment = [&] (const ptime &t) {
+          return TimeConstraints(time_period(t, monday + hours(36)),
+                                 time_period(t, monday + hours(48)));
+        };
+        const TimeConstraints tcBefore = fromMoment(fastestDeparture - minutes(9)),
+          tcAfter = fromMoment(fastestDeparture + minutes(1));
+        Assert::IsTrue(fastestDeparture ==
+          (*tp.search("p2"s, "p4"s, 1ULL, &tcBefore))[0ULL].at(0ULL).begin());
+        Assert::AreEqual(2ULL, (unsigned long long)tp.resultsCache.size());
+        const unique_ptr<IResults> after =
+          tp.search("p2"s, "p4"s, 1ULL, &tcAfter);
+        Assert::IsNotNull(after.get());
+        for(size_t categ = 0ULL; categ < variantCategories().size(); ++categ)
+          Assert::IsTrue((*after)[categ].at(0ULL).begin() > fastestDeparture);
+
+        // ...after a search of their own, since the shared results
+        // had no room for the later variants
+        Assert::AreEqual(3ULL, (unsigned long long)tp.resultsCache.size());
+
+      } catch(exception &e) {
+        Logger::WriteMessage(e.what());
+        Assert::Fail();
+      }
+
+      nowReplacements.clear(); // don't influence other tests
+    }
+
+    TEST_METHOD(Planner_SearchWithModeFilter_OnlyAllowedModes) {
+      Logger::WriteMessage(__FUNCTION__);
+
+      // Make sure the next 100 configurations of UDYA consider that 'today' is 2017-Sep-16
+      nowReplacements.resize(100ULL, refMoment);
+
+      try {
+        TripPlanner tp(make_unique<JsonSource>(
+          path("../../UnitTests/TestFiles/specsOk.json")));
+
+        const ptime day(from_simple_string("2018-Mar-19"s));
+        const TimeConstraints tc(time_period(day, hours(24)),
+                                 time_period(day, hours(48)));
+
+        Assert::ExpectException<invalid_argument>([&tp, &tc] {
+          tp.search("p14"s, "p13"s, 1ULL, &tc, nullptr, 0ULL);
+        });
+        Assert::ExpectException<invalid_argument>([&tp, &tc] {
+          tp.search("p14"s, "p13"s, 1ULL, &tc, nullptr,
+                    size_t(TranspModes::last << 1));
+        });
+
+        // Some of the variants between p14 and p13 fly
+        const unique_ptr<IResults> allModes =
+          tp.search("p14"s, "p13"s, 10ULL, &tc);
+        Assert::IsNotNull(allModes.get());
+        size_t allModesUsed = 0ULL;
+        for(size_t categ = 0ULL; categ < variantCategories().size(); ++categ)
+          for(const auto &v : (*allModes)[categ].get())
+            allModesUsed |= v->transpModes();
+        Assert::IsTrue((allModesUsed & size_t(TranspModes::AIR)) != 0ULL);
+
+        // No flights
+        const size_t noFlights = size_t(TranspModes::all & ~TranspModes::AIR);
+        const unique_ptr<IResults> withoutFlights =
+          tp.search("p14"s, "p13"s, 10ULL, &tc, nullptr, noFlights);
+        if(nullptr != withoutFlights)
+          for(size_t categ = 0ULL; categ < variantCategories().size(); ++categ)
+            for(const auto &v : (*withoutFlights)[categ].get())
+              Assert::AreEqual(0ULL, (unsigned long long)
+                               (v->transpModes() & size_t(TranspModes::AIR)));
+
+        // Only flights
+        const unique_ptr<IResults> onlyFlights =
+          tp.search("p14"s, "p13"s, 10ULL, &tc, nullptr, TranspModes::AIR);
+        Assert::IsNotNull(onlyFlights.get());
+        for(size_t categ = 0ULL; categ < variantCategories().size(); ++categ)
+          for(const auto &v : (*onlyFlights)[categ].get())
+            Assert::AreEqual((unsigned long long)TranspModes::AIR,
+                             (unsigned long long)v->transpModes());
+
+      } catch(exception &e) {
+        Logger::WriteMessage(e.what());
+        Assert::Fail();
+      }
+
+      nowReplacements.clear(); // don't influence other tests
+    }
+
+    TEST_METHOD(Planner_SearchWithTransfers_WalksAndTransferTimesRespected) {
+      Logger::WriteMessage(__FUNCTION__);
+
+      // Make sure the next 100 configurations of UDYA consider that 'today' is 2017-Sep-16
+      nowReplacements.resize(100ULL, refMoment);
+
+      try {
+        TripPlanner tp(make_unique<JsonSource>(
+          path("../../UnitTests/TestFiles/specsFootpaths.json")));
+
+        const ptime monday(from_simple_string("2017-Sep-18"s));
+        const TimeConstraints tc(time_period(monday, hours(24)),
+                                 time_period(monday, hours(24)));
+
+        // The rail arrives in s2 at 9:00. Walking to s3 takes 6 minutes,
+        // after the 5 minutes needed to leave s2. The roads need 5 minutes, too
+        const unique_ptr<IResults> results = tp.search("s1"s, "s4"s, 5ULL, &tc);
+        Assert::IsNotNull(results.get());
+        for(size_t categ = 0ULL; categ < variantCategories().size(); ++categ) {
+          const IVariants &variants = (*results)[categ];
+          for(size_t i = 0ULL; i < variants.count(); ++i) {
+            const IVariant &v = variants.at(i);
+            for(size_t j = 1ULL; j < v.connectionsCount(); ++j)
+              Assert::IsTrue(v.connection(j).begin() >=
+                             v.connection(j - 1ULL).end() + minutes(5));
+          }
+        }
+
+        const IVariant &fastest = (*results)[0ULL].at(0ULL);
+        Assert::AreEqual(3ULL, (unsigned long long)fastest.connectionsCount());
+        const IConnection &walk = fastest.connection(1ULL);
+        Assert::AreEqual(2ULL, (unsigned long long)walk.from());
+        Assert::AreEqual(3ULL, (unsigned long long)walk.to());
+        Assert::AreEqual((unsigned long long)TranspModes::FOOT,
+                         (unsigned long long)walk.transpModes());
+        Assert::IsTrue(monday + hours(9) + minutes(5) == walk.begin());
+        Assert::IsTrue(monday + hours(9) + minutes(11) == walk.end());
+        Assert::IsTrue(monday + hours(9) + minutes(20) ==
+                       fastest.connection(2ULL).begin());
+
+        // Without walking, the road from s2 leaving at 9:30 is the fastest
+        const IVariant &fastestNoWalk = (*tp.search("s1"s, "s4"s, 5ULL, &tc,
+          nullptr, size_t(TranspModes::all & ~TranspModes::FOOT)))[0ULL].at(0ULL);
+        Assert::AreEqual(2ULL, (unsigned long long)fastestNoWalk.connectionsCount());
+        Assert::IsTrue(monday + hours(9) + minutes(30) ==
+                       fastestNoWalk.connection(1ULL).begin());
+
+        // A walk can end the trip
+        const IVariant &toS3 = (*tp.search("s1"s, "s3"s, 1ULL, &tc))[0ULL].at(0ULL);
+        Assert::AreEqual(2ULL, (unsigned long long)toS3.connectionsCount());
+        Assert::AreEqual((unsigned long long)TranspModes::FOOT,
+                         (unsigned long long)toS3.transpModes() &
+                           (unsigned long long)TranspModes::FOOT);
+        Assert::AreEqual(3ULL, (unsigned long long)toS3.to());
+
+      } catch(exception &e) {
+        Logger::WriteMessage(e.what());
+        Assert::Fail();
+      }
+
+      nowReplacements.clear(); // don't influence other tests
+    }
+
+    TEST_METHOD(Planner_SearchWithPlaceConstraints_OnlyConformingVariants) {
+      Logger::WriteMessage(__FUNCTION__);
+
+      // Make sure the next 100 configurations of UDYA consider that 'today' is 2017-Sep-16
+      nowReplacements.resize(100ULL, refMoment);
+
+      try {
+        TripPlanner tp(make_unique<JsonSource>(
+          path("../../UnitTests/TestFiles/specsOk.json")));
+
+        // The road from p2 to p4 stops in p3
+        const ptime monday(from_simple_string("2017-Sep-18"s));
+        const TimeConstraints roadTc(time_period(monday, hours(24)),
+                                     time_period(monday, hours(48)));
+        const PlaceConstraints viaP3({ 3U }), avoidP3({}, { 3U }),
+          avoidRoad({}, {}, { 1U });
+        Assert::IsNotNull(tp.search("p2"s, "p4"s, 4ULL, &roadTc, nullptr,
+                                    TranspModes::all, &viaP3).get());
+        Assert::IsNull(tp.search("p2"s, "p4"s, 4ULL, &roadTc, nullptr,
+                                 TranspModes::all, &avoidP3).get());
+        Assert::IsNull(tp.search("p2"s, "p4"s, 4ULL, &roadTc, nullptr,
+                                 TranspModes::all, &avoidRoad).get());
+
+        // From p14 to p13 either fly or sail to p1 and take the train from there
+        const ptime day(from_simple_string("2018-Mar-19"s));
+        const TimeConstraints tc(time_period(day, hours(24)),
+                                 time_period(day, hours(72)));
+        const auto check = [&] (const PlaceConstraints &pc,
+                                const function<bool(const IVariant&)> &ok) {
+          const unique_ptr<IResults> results =
+            tp.search("p14"s, "p13"s, 5ULL, &tc, nullptr, TranspModes::all, &pc);
+          Assert::IsNotNull(results.get());
+          for(size_t categ = 0ULL; categ < variantCategories().size(); ++categ) {
+            const IVariants &variants = (*results)[categ];
+            Assert::IsTrue(variants.count() > 0ULL);
+            for(size_t i = 0ULL; i < variants.count(); ++i)
+              Assert::IsTrue(ok(variants.at(i)));
+          }
+        };
+
+        check(PlaceConstraints({ 1U }), [] (const IVariant &v) {
+          for(size_t i = 0ULL; i < v.connectionsCount(); ++i)
+            if(v.connection(i).to() == 1ULL)
+              return true;
+          return false;
+        });
+        check(PlaceConstraints({}, { 1U }), [] (const IVariant &v) {
+          return v.transpModes() == size_t(TranspModes::AIR);
+        });
+        check(PlaceConstraints({}, {}, { 4U }), [] (const IVariant &v) {
+          return (v.transpModes() & size_t(TranspModes::AIR)) == 0ULL;
+        });
+
+        // Other implementations of IPlaceConstraints may repeat the via places
+        struct RawPlaceConstraints : IPlaceConstraints {
+          vector<unsigned> via, none;
+          RawPlaceConstraints(const vector<unsigned> &via_) : via(via_) {}
+          const vector<unsigned>& viaPlaces() const override { return via; }
+          const vector<unsigned>& avoidedPlaces() const override { return none; }
+          const vector<unsigned>& avoidedRoutes() const override { return none; }
+        };
+        const RawPlaceConstraints viaP3Twice({ 3U, 3U }),
+          tooManyVia({ 5U, 3U, 4U, 6U, 2U, 3U });
+        Assert::IsNotNull(tp.search("p2"s, "p4"s, 4ULL, &roadTc, nullptr,
+                                    TranspModes::all, &viaP3Twice).get());
+        Assert::ExpectException<invalid_argument>([&] {
+          tp.search("p2"s, "p4"s, 4ULL, &roadTc, nullptr,
+                    TranspModes::all, &tooManyVia);
+        });
+
+      } catch(exception &e) {
+        Logger::WriteMessage(e.what());
+        Assert::Fail();
+      }
+
+      nowReplacements.clear(); // don't influence other tests
+    }
+
+    TEST_METHOD(Planner_ParallelSearch_SameVariantsAsSequential) {
+      Logger::WriteMessage(__FUNCTION__);
+
+      // Make sure the next 100 configurations of UDYA consider that 'today' is 2017-Sep-16
+      nowReplacements.resize(100ULL, refMoment);
+
+      try {
+        TripPlanner sequential(make_unique<JsonSource>(
+          path("../../UnitTests/TestFiles/specsOk.json")));
+        TripPlanner parallel(make_unique<JsonSource>(
+          path("../../UnitTests/TestFiles/specsOk.json")), nullptr, 4U);
+
+        const ptime day(from_simple_string("2018-Mar-19"s));
+        const TimeConstraints tc(time_period(day, hours(24)),
+                                 time_period(day, hours(48)));
+        for(const auto &ends : { make_pair("p2"s, "p4"s),
+                                 make_pair("p14"s, "p13"s) }) {
+          const unique_ptr<IResults>
+            expected = sequential.search(ends.first, ends.second, 5ULL, &tc),
+            actual = parallel.search(ends.first, ends.second, 5ULL, &tc);
+          Assert::IsNotNull(expected.get());
+          Assert::IsNotNull(actual.get());
+
+          for(size_t categ = 0ULL; categ < variantCategories().size(); ++categ) {
+            const IVariants &e = (*expected)[categ], &a = (*actual)[categ];
+            Assert::AreEqual(e.count(), a.count());
+            for(size_t i = 0ULL; i < e.count(); ++i) {
+              Assert::IsTrue(e.at(i).begin() == a.at(i).begin());
+              Assert::IsTrue(e.at(i).end() == a.at(i).end());
+              Assert::AreEqual(e.at(i).price(), a.at(i).price());
+              Assert::AreEqual(e.at(i).distance(), a.at(i).distance());
+              Assert::AreEqual(e.at(i).connectionsCount(),
+                               a.at(i).connectionsCount());
+            }
+          }
+        }
+
+      } catch(exception &e) {
+        Logger::WriteMessage(e.what());
+        Assert::Fail();
+      }
+
+      nowReplacements.clear(); // don't influence other tests
+    }
+
+    TEST_METHOD(Planner_SearchWithLimits_PartialResultsNotRemembered) {
+      Logger::WriteMessage(__FUNCTION__);
+
+      // Make sure the next 100 configurations of UDYA consider that 'today' is 2017-Sep-16
+      nowReplacements.resize(100ULL, refMoment);
+
+      try {
+        for(unsigned searchThreads : { 1U, 3U }) {
+          TripPlanner tp(make_unique<JsonSource>(
+            path("../../UnitTests/TestFiles/specsOk.json")), nullptr,
+            searchThreads);
+
+          const ptime monday(from_simple_string("2017-Sep-18"s));
+          const TimeConstraints tc(time_period(monday, hours(24)),
+                                   time_period(monday, hours(48)));
+
+          // A cancelled search returns at once, flagged as partial
+          CancellationToken token;
+          token.cancel();
+          const SearchLimits cancelled(chrono::hours(1), &token);
+          const unique_ptr<IResults> interrupted =
+            tp.search("p2"s, "p4"s, 4ULL, &tc, nullptr, TranspModes::all,
+                      nullptr, &cancelled);
+          Assert::IsNotNull(interrupted.get());
+          Assert::IsTrue(interrupted->partial());
+
+          // The partial results weren't remembered
+          const SearchLimits generous(chrono::minutes(10));
+          const unique_ptr<IResults> complete =
+            tp.search("p2"s, "p4"s, 4ULL, &tc, nullptr, TranspModes::all,
+                      nullptr, &generous);
+          Assert::IsNotNull(complete.get());
+          Assert::IsFalse(complete->partial());
+          for(size_t categ = 0ULL; categ < variantCategories().size(); ++categ) {
+            Assert::AreEqual(4ULL, (unsigned long long)(*complete)[categ].count());
+            Assert::IsTrue((*interrupted)[categ].count() <=
+                           (*complete)[categ].count());
+          }
+
+          // An expired deadline stops the search, too
+          const SearchLimits expired(chrono::milliseconds(0));
+          const unique_ptr<IResults> late =
+            tp.search("p14"s, "p13"s, 4ULL, &tc, nullptr, TranspModes::all,
+                      nullptr, &expired);
+          Assert::IsNotNull(late.get());
+          Assert::IsTrue(late->partial());
+        }
+
+      } catch(exception &e) {
+        Logger::WriteMessage(e.what());
+        Assert::Fail();
+      }
+
+      nowReplacements.clear(); // don't influence other tests
+    }
+
+    TEST_METHOD(Planner_SearchAsync_ResultsThroughFuturesAndCallbacks) {
+      Logger::WriteMessage(__FUNCTION__);
+
+      // Make sure the next 100 configurations of UDYA consider that 'today' is 2017-Sep-16
+      nowReplacements.resize(100ULL, refMoment);
+
+      try {
+        // A single thread for asynchronous searches, with a backlog of 1
+        TripPlanner tp(make_unique<JsonSource>(
+          path("../../UnitTests/TestFiles/specsOk.json")), nullptr, 1U, 1U, 1ULL);
+
+        const ptime monday(from_simple_string("2017-Sep-18"s));
+        const TimeConstraints tc(time_period(monday, hours(24)),
+                                 time_period(monday, hours(48)));
+        const unique_ptr<IResults> expected = tp.search("p2"s, "p4"s, 4ULL, &tc);
+        Assert::IsNotNull(expected.get());
+
+        future<unique_ptr<IResults>> pending = tp.searchAsync("p2"s, "p4"s, 4ULL, &tc);
+        const unique_ptr<IResults> results = pending.get();
+        Assert::IsNotNull(results.get());
+        for(size_t categ = 0ULL; categ < variantCategories().size(); ++categ)
+          Assert::AreEqual((*expected)[categ].count(), (*results)[categ].count());
+
+        // The failures of the search reach the future
+        pending = tp.searchAsync("p2"s, "p2"s, 4ULL, &tc);
+        Assert::ExpectException<invalid_argument>([&pending] { pending.get(); });
+
+        // The only thread gets blocked within a callback
+        promise<bool> started;
+        promise<void> release;
+        shared_future<void> released(release.get_future());
+        tp.searchAsync([&started, released](unique_ptr<IResults> r, exception_ptr f) {
+                         started.set_value(nullptr != r && !f);
+                         released.wait();
+                       }, "p2"s, "p4"s, 4ULL, &tc);
+        Assert::IsTrue(started.get_future().get());
+
+        // The backlog accepts a single search and then rejects the others
+        pending = tp.searchAsync("p14"s, "p13"s, 4ULL, &tc);
+        Assert::AreEqual(1ULL, (unsigned long long)tp.queuedSearches());
+        Assert::ExpectException<overflow_error>([&tp, &tc] {
+          tp.searchAsync("p14"s, "p13"s, 4ULL, &tc);
+        });
+
+        release.set_value();
+        Assert::IsNotNull(pending.get().get());
+        Assert::AreEqual(0ULL, (unsigned long long)tp.queuedSearches());
+
+      } catch(exception &e) {
+        Logger::WriteMessage(e.what());
+        Assert::Fail();
+      }
+
+      nowReplacements.clear(); // don't influence other tests
+    }
+
+    TEST_METHOD(Planner_ServeRequests_ResponsesTaggedById) {
+      Logger::WriteMessage(__FUNCTION__);
+
+      // Make sure the next 100 configurations of UDYA consider that 'today' is 2017-Sep-16
+      nowReplacements.resize(100ULL, refMoment);
+
+      try {
+        unique_ptr<JsonSource> infoSrc = make_unique<JsonSource>(
+          path("../../UnitTests/TestFiles/specsOk.json"));
+        const ResultsSerializer serializer(*infoSrc);
+        const TripPlanner tp(move(infoSrc), nullptr, 1U, 2U);
+        const RequestServer server(tp, serializer);
+
+        istringstream requests(
+          R"({"id":"ok","from":"p2","to":"p4","count":1,"leave":"2017-09-18 00:00:00"})" "\n"
+          "\n"
+          R"({"id":"same","from":"p2","to":"p2"})" "\n"
+          "not json\n" +
+          string(100ULL * 1'024ULL, ' ') + "\n" + // too long, although blank
+          R"({"id":"late","from":"p14","to":"p13","leave":"2018-03-19 00:00:00","timeoutMs":0})");
+        ostringstream responses;
+        server.serve(requests, responses);
+
+        // A response for every request, in any order
+        vector<string> lines;
+        istringstream iss(responses.str());
+        for(string line; getline(iss, line); )
+          lines.push_back(line);
+        Assert::AreEqual(5ULL, (unsigned long long)lines.size());
+        Assert::AreEqual(1LL, (long long)count(cbegin(lines), cend(lines),
+          R"({"id":"","error":"the request is too long!"})"s));
+
+        const auto responseTo = [&lines](const string &id) {
+          const string prefix = "{\"id\":\"" + id + "\",";
+          for(const string &line : lines)
+            if(line.compare(0ULL, prefix.size(), prefix) == 0)
+              return line;
+          return string();
+        };
+        Assert::IsTrue(responseTo("ok").find(
+          "\"results\":{\"categories\":[{\"name\":\"most rapid variants\"") !=
+          string::npos);
+        Assert::IsTrue(responseTo("same").find("\"error\":") != string::npos);
+        Assert::IsTrue(responseTo("").find("\"error\":") != string::npos);
+        Assert::IsTrue(responseTo("late").find("\"partial\":true") != string::npos);
+
+#ifndef _WIN32
+        // A file which isn't a socket is never replaced
+        const path notSocket = temp_directory_path() / unique_path();
+        ofstream(notSocket.string())<<"keep me";
+        Assert::ExpectException<runtime_error>([&server, &notSocket] {
+          server.serveUnixSocket(notSocket.string());
+        });
+        Assert::IsTrue(is_regular_file(notSocket));
+        remove(notSocket);
+#endif // _WIN32
+
+      } catch(exception &e) {
+        Logger::WriteMessage(e.what());
+        Assert::Fail();
+      }
+
+      nowReplacements.clear(); // don't influence other tests
+    }
+
+    TEST_METHOD(Planner_TravelMatrix_AgreesWithSearches) {
+      Logger::WriteMessage(__FUNCTION__);
+
+      // Make sure the next 100 configurations of UDYA consider that 'today' is 2017-Sep-16
+      nowReplacements.resize(100ULL, refMoment);
+
+      try {
+        TripPlanner tp(make_unique<JsonSource>(
+          path("../../UnitTests/TestFiles/specsOk.json")));
+
+        const ptime monday(from_simple_string("2017-Sep-18"s));
+        const TimeConstraints tc(time_period(monday, hours(24)),
+                                 time_period(monday, hours(48)));
+        const vector<string> places { "p2"s, "p4"s, "p14"s };
+        const size_t n = places.size();
+        vector<TravelMatrixCell> cells(n * n);
+
+        Assert::ExpectException<length_error>([&tp, &places, &cells, &tc] {
+          tp.travelMatrix(places, cells.data(), cells.size() - 1ULL, &tc);
+        });
+        Assert::ExpectException<invalid_argument>([&tp, &places, &cells, &tc] {
+          tp.travelMatrix(places, cells.data(), cells.size(), &tc, 0ULL);
+        });
+
+        tp.travelMatrix(places, cells.data(), cells.size(), &tc);
+
+        // Minutes since 1970 of a moment
+        const auto epochMinutes = [](const ptime &t) {
+          return int64_t((t - ptime(date(1970, Jan, 1))).total_seconds() / 60LL);
+        };
+
+        for(size_t i = 0ULL; i < n; ++i) {
+          const TravelMatrixCell &diagonal = cells[i * n + i];
+          Assert::IsTrue(epochMinutes(monday) == diagonal.earliestArrival);
+          Assert::AreEqual(0.f, diagonal.minDistance);
+          Assert::AreEqual(0.f, diagonal.minPrice);
+        }
+
+        // The same values as the best variants of the searches
+        const unique_ptr<IResults> results = tp.search("p2"s, "p4"s, 4ULL, &tc);
+        Assert::IsNotNull(results.get());
+        const TravelMatrixCell &p2p4 = cells[0ULL * n + 1ULL];
+        Assert::IsTrue(epochMinutes((*results)[3ULL].get().front()->end()) ==
+                       p2p4.earliestArrival);
+        Assert::AreEqual((*results)[2ULL].get().front()->distance(),
+                         p2p4.minDistance);
+        Assert::IsTrue(p2p4.minPrice > 0.f && isfinite(p2p4.minPrice));
+
+        // The result doesn't depend on the count of threads
+        TripPlanner parallelTp(make_unique<JsonSource>(
+          path("../../UnitTests/TestFiles/specsOk.json")), nullptr, 3U);
+        vector<TravelMatrixCell> parallel(n * n);
+        parallelTp.travelMatrix(places, parallel.data(), parallel.size(), &tc);
+        for(size_t i = 0ULL; i < n * n; ++i) {
+          Assert::IsTrue(cells[i].earliestArrival == parallel[i].earliestArrival);
+          Assert::AreEqual(cells[i].minDistance, parallel[i].minDistance);
+          Assert::AreEqual(cells[i].minPrice, parallel[i].minPrice);
+        }
+
+        // Only flights can't connect p2 and p4
+        parallelTp.travelMatrix(places, cells.data(), cells.size(), &tc,
+                                TranspModes::AIR);
+        Assert::IsTrue(TravelMatrixCell::Unreachable ==
+                       cells[0ULL * n + 1ULL].earliestArrival);
+        Assert::IsTrue(isinf(cells[0ULL * n + 1ULL].minDistance));
+        Assert::IsTrue(isinf(cells[0ULL * n + 1ULL].minPrice));
+
+      } catch(exception &e) {
+        Logger::WriteMessage(e.what());
+        Assert::Fail();
+      }
+
+      nowReplacements.clear(); // don't influence other tests
+    }
+
+    TEST_METHOD(Planner_Isochrone_EarliestArrivalsWithinBudget) {
+      Logger::WriteMessage(__FUNCTION__);
+
+      // Make sure the next 100 configurations of UDYA consider that 'today' is 2017-Sep-16
+      nowReplacements.resize(100ULL, refMoment);
+
+      try {
+        TripPlanner tp(make_unique<JsonSource>(
+          path("../../UnitTests/TestFiles/specsOk.json")));
+
+        const ptime monday(from_simple_string("2017-Sep-18"s));
+        vector<IsochroneCell> cells;
+
+        Assert::ExpectException<invalid_argument>([&tp, &monday, &cells] {
+          tp.isochrone("p2"s, monday, cells, hours(-1));
+        });
+        Assert::ExpectException<invalid_argument>([&tp, &monday, &cells] {
+          tp.isochrone("p2"s, monday, cells, seconds(0));
+        });
+
+        // Minutes since 1970 of a moment
+        const auto epochMinutes = [](const ptime &t) {
+          return int64_t((t - ptime(date(1970, Jan, 1))).total_seconds() / 60LL);
+        };
+        const auto cellOf = [&cells](unsigned placeId) {
+          return *find_if(cbegin(cells), cend(cells),
+                          [placeId](const IsochroneCell &cell) {
+                            return cell.placeId == placeId; });
+        };
+
+        tp.isochrone("p2"s, monday, cells, hours(48));
+        Assert::IsTrue(epochMinutes(monday) == cellOf(2U).earliestArrival);
+        Assert::AreEqual(0.f, cellOf(2U).distance);
+
+        // The road alternative leaving p2 at 9:10 reaches p4 at 12:00,
+        // like the soonest variant of the search
+        const IsochroneCell p4 = cellOf(4U);
+        Assert::IsTrue(epochMinutes(monday + hours(12)) == p4.earliestArrival);
+        Assert::AreEqual(93.4f + 70.2f, p4.distance);
+        Assert::IsTrue(p4.price > 0.f);
+
+        // The same arrival as from the travel matrices
+        const vector<string> places { "p2"s, "p4"s };
+        vector<TravelMatrixCell> matrix(4ULL);
+        const TimeConstraints tc(time_period(monday, hours(48)),
+                                 time_period(monday, hours(48)));
+        tp.travelMatrix(places, matrix.data(), matrix.size(), &tc);
+        Assert::IsTrue(matrix[1ULL].earliestArrival == p4.earliestArrival);
+
+        // Within a few minutes, p4 is out of reach
+        tp.isochrone("p2"s, monday, cells, minutes(10));
+        Assert::IsTrue(IsochroneCell::Unreachable == cellOf(4U).earliestArrival);
+        Assert::IsTrue(isinf(cellOf(4U).distance));
+
+      } catch(exception &e) {
+        Logger::WriteMessage(e.what());
+        Assert::Fail();
+      }
+
+      nowReplacements.clear(); // don't influence other tests
+    }
+
+    TEST_METHOD(Planner_SearchSessionPages_SameVariantsAsSearch) {
+      Logger::WriteMessage(__FUNCTION__);
+
+      // Make sure the next 100 configurations of UDYA consider that 'today' is 2017-Sep-16
+      nowReplacements.resize(100ULL, refMoment);
+
+      try {
+        TripPlanner tp(make_unique<JsonSource>(
+          path("../../UnitTests/TestFiles/specsOk.json")));
+
+        const ptime monday(from_simple_string("2017-Sep-18"s));
+        const TimeConstraints tc(time_period(monday, hours(24)),
+                                 time_period(monday, hours(48)));
+        const unique_ptr<IResults> results =
+          tp.search("p2"s, "p4"s, 4ULL, &tc);
+        Assert::IsNotNull(results.get());
+        unique_ptr<ISearchSession> session =
+          tp.searchSession("p2"s, "p4"s, 4ULL, &tc);
+        Assert::IsNotNull(session.get());
+
+        const size_t categories = variantCategories().size();
+        for(size_t categ = 0ULL; categ < categories; ++categ) {
+          const IVariants &all = (*results)[categ];
+          size_t found = 0ULL;
+          while(!session->exhausted(categ)) {
+            const IVariants &page = session->nextPage(categ, 3ULL);
+            Assert::IsTrue(page.count() <= 3ULL);
+            for(size_t i = 0ULL; i < page.count(); ++i, ++found) {
+              Assert::IsTrue(found < all.count());
+              const IVariant &v = page.at(i), &expected = all.at(found);
+              Assert::IsTrue(expected.begin() == v.begin());
+              Assert::IsTrue(expected.end() == v.end());
+              Assert::AreEqual(expected.price(), v.price());
+              Assert::AreEqual((unsigned long long)expected.connectionsCount(),
+                               (unsigned long long)v.connectionsCount());
+            }
+          }
+          Assert::AreEqual((unsigned long long)all.count(),
+                           (unsigned long long)found);
+          Assert::AreEqual(0ULL,
+                           (unsigned long long)session->nextPage(categ, 3ULL).count());
+        }
+
+        Assert::ExpectException<out_of_range>([&session, categories] {
+          session->nextPage(categories, 3ULL);
+        });
+        Assert::ExpectException<invalid_argument>([&session] {
+          session->nextPage(0ULL, 0ULL);
+        });
+
+        // The session expires after updating the specifications
+        session = tp.searchSession("p2"s, "p4"s, 4ULL, &tc);
+        tp.allowDataAccess(false);
+        tp.allowDataAccess(true);
+        Assert::ExpectException<logic_error>([&session] {
+          session->nextPage(0ULL, 3ULL);
+        });
+
+      } catch(exception &e) {
+        Logger::WriteMessage(e.what());
+        Assert::Fail();
+      }
+
+      nowReplacements.clear(); // don't influence other tests
+    }
+
+    TEST_METHOD(Planner_SerializeResults_JsonAndBinaryMatchResults) {
+      Logger::WriteMessage(__FUNCTION__);
+
+      // Make sure the next 100 configurations of UDYA consider that 'today' is 2017-Sep-16
+      nowReplacements.resize(100ULL, refMoment);
+
+      try {
+        DerivedTripPlanner tp(make_unique<JsonSource>(
+          path("../../UnitTests/TestFiles/specsOk.json")));
+        const ResultsSerializer serializer(*tp.infoSrc);
+
+        const ptime monday(from_simple_string("2017-Sep-18"s));
+        const TimeConstraints tc(time_period(monday, hours(24)),
+                                 time_period(monday, hours(48)));
+        const unique_ptr<IResults> results =
+          tp.search("p2"s, "p4"s, 2ULL, &tc);
+        Assert::IsNotNull(results.get());
+
+        vector<char> buffer(100'000ULL);
+        const string json(buffer.data(),
+                          serializer.toJson(*results, buffer.data(), buffer.size()));
+        Assert::IsTrue(json.find("{\"categories\":[{\"name\":\"most rapid variants\""s) == 0ULL);
+        Assert::IsTrue(json.back() == '}');
+
+        // The most rapid variant leaves p2 at 19:40 and reaches p4 at 22:00.
+        // The places appear by their most popular name
+        Assert::IsTrue(json.find("\"from\":\""s +
+                                 tp.infoSrc->getPlace(2U).names().front() +
+                                 "\",\"to\":\""s +
+                                 tp.infoSrc->getPlace(4U).names().front() +
+                                 "\",\"departure\":\"2017-09-18T19:40\","
+                                 "\"arrival\":\"2017-09-18T22:00\","
+                                 "\"minutes\":140,\"modes\":\"Road\""s) != string::npos);
+
+        // Too small buffers
+        Assert::ExpectException<length_error>([&] {
+          serializer.toJson(*results, buffer.data(), json.size() - 1ULL);
+        });
+
+        size_t expectedSize = 9ULL; // magic + flags + count of categories
+        const size_t categories = variantCategories().size();
+        for(size_t categ = 0ULL; categ < categories; ++categ) {
+          const IVariants &variants = (*results)[categ];
+          expectedSize += 4ULL;
+          for(size_t i = 0ULL; i < variants.count(); ++i)
+            expectedSize += 4ULL + ResultsSerializer::BinaryConnectionSize *
+              variants.at(i).connectionsCount();
+        }
+        const size_t binarySize =
+          serializer.toBinary(*results, buffer.data(), buffer.size());
+        Assert::AreEqual((unsigned long long)expectedSize,
+                         (unsigned long long)binarySize);
+        Assert::IsTrue(string(buffer.data(), 4ULL) == "TPR2"s);
+        Assert::AreEqual(0U, (unsigned)(uint8_t)buffer[4ULL]);
+
+        // The first connection of the most rapid variant
+        uint32_t fromId = 0U;
+        int64_t departure = 0LL;
+        memcpy(&fromId, buffer.data() + 17, sizeof fromId);
+        memcpy(&departure, buffer.data() + 25, sizeof departure);
+        Assert::AreEqual(2U, (unsigned)fromId);
+        Assert::IsTrue(ptime(date(1970, Jan, 1)) + minutes(departure) ==
+                       (*results)[0ULL].at(0ULL).begin());
+
+        Assert::ExpectException<length_error>([&] {
+          serializer.toBinary(*results, buffer.data(), binarySize - 1ULL);
+        });
+
+        // Both formats mark the results of an interrupted search
+        Assert::IsTrue(json.find("\"partial\""s) == string::npos);
+        const SearchLimits expired(chrono::milliseconds(0));
+        const unique_ptr<IResults> late =
+          tp.search("p14"s, "p13"s, 4ULL, &tc, nullptr, TranspModes::all,
+                    nullptr, &expired);
+        Assert::IsNotNull(late.get());
+        Assert::IsTrue(late->partial());
+        const string lateJson(buffer.data(),
+                              serializer.toJson(*late, buffer.data(), buffer.size()));
+        Assert::IsTrue(lateJson.size() > 16ULL &&
+                       lateJson.compare(lateJson.size() - 16ULL, 16ULL,
+                                        ",\"partial\":true}"s) == 0);
+        serializer.toBinary(*late, buffer.data(), buffer.size());
+        Assert::IsTrue(string(buffer.data(), 4ULL) == "TPR2"s);
+        Assert::AreEqual((unsigned)ResultsSerializer::BinaryPartialFlag,
+                         (unsigned)(uint8_t)buffer[4ULL]);
+
+      } catch(exception &e) {
+        Logger::WriteMessage(e.what());
+        Assert::Fail();
+      }
+
+      nowReplacements.clear(); // don't influence other tests
+    }
+
     TEST_METHOD(Planner_PickPlaceIssues_Throws) {
       Logger::WriteMessage(__FUNCTION__);
 
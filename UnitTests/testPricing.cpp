@@ -24,8 +24,11 @@
 
 #include "CppUnitTest.h"
 #include "pricing.h"
+#include "airfareCache.h"
 
 #include <stdexcept>
+#include <vector>
+#include <cmath>
 
 using namespace Microsoft::VisualStudio::CppUnitTestFramework;
 using namespace std;
@@ -97,6 +100,10 @@ namespace UnitTests {
 					[&tpc] {tpc.airplaneFare(300.4f, 0.5f, -0.001f); });
 				Assert::ExpectException<invalid_argument>(
 					[&tpc] {tpc.airplaneFare(300.4f, 0.5f, 1.001f, false); });
+				Assert::ExpectException<invalid_argument>(
+					[&tpc] {tpc.airplaneFareFactor(1.001f, 0.5f); });
+				Assert::ExpectException<invalid_argument>(
+					[&tpc] {tpc.airplaneFareFactor(0.5f, -0.001f); });
 			} catch(exception &e) {
 				Logger::WriteMessage(e.what());
 				Assert::Fail();
@@ -129,6 +136,88 @@ namespace UnitTests {
 				Assert::AreEqual(highFareFactor, tpc.airplaneFare(expm1f(1.f), 0.f, 1.f), 1e-3f);
 				Assert::AreEqual(highFareFactor, tpc.airplaneFare(expm1f(1.f), 1.f, 0.f), 1e-3f);
 
+				// airplaneFare is normalFare * airplaneFareFactor
+				Assert::AreEqual(lowFareFactor, tpc.airplaneFareFactor(0.f, 0.f), 1e-3f);
+				Assert::AreEqual(highFareFactor, tpc.airplaneFareFactor(0.3f, 1.f), 1e-3f);
+				Assert::AreEqual(tpc.normalFare(500.f) * tpc.airplaneFareFactor(0.4f, 0.2f),
+                         tpc.airplaneFare(500.f, 0.4f, 0.2f), 1e-3f);
+
+			} catch(exception &e) {
+				Logger::WriteMessage(e.what());
+				Assert::Fail();
+			}
+		}
+	
+		TEST_METHOD(TicketPriceCalculator_batchFareQueries_MatchSingleQueries) {
+			Logger::WriteMessage(__FUNCTION__);
+			try {
+        tp::specs::TicketPriceCalculator tpc(3.5f, 6.f, 0.75f, 2.f);
+
+        vector<float> distances;
+        for(float d = 0.001f; d < 20000.f; d *= 1.37f)
+          distances.push_back(d);
+
+        const size_t count = distances.size();
+        vector<float> fares(count);
+        for(bool economyClass : { true, false }) {
+          tpc.normalFares(distances.data(), count, fares.data(), economyClass);
+          for(size_t i = 0ULL; i < count; ++i) {
+            const float expected = tpc.normalFare(distances[i], economyClass);
+            Assert::AreEqual(expected, fares[i], expected * 1e-5f);
+          }
+        }
+
+        // The documented bound of the fast ln(1+x), from tiny to large x
+        tp::specs::TicketPriceCalculator unitK(1.f);
+        vector<float> xs;
+        for(float x = 1e-9f; x < 1e7f; x *= 1.0007f)
+          xs.push_back(x);
+        vector<float> logs(xs.size());
+        unitK.normalFares(xs.data(), xs.size(), logs.data());
+        for(size_t i = 0ULL; i < xs.size(); ++i) {
+          const double expected = log1p(double(xs[i]));
+          Assert::IsTrue(fabs(double(logs[i]) - expected) <= expected * 5e-7);
+        }
+
+        // An invalid value anywhere within the batch throws before computing anything
+        fares.assign(count, -1.f);
+        distances[count / 2ULL] = 0.f;
+        Assert::ExpectException<invalid_argument>([&] {
+          tpc.normalFares(distances.data(), count, fares.data()); });
+        Assert::AreEqual(-1.f, fares.front());
+
+        // Empty batches are allowed
+        tpc.normalFares(nullptr, 0ULL, nullptr);
+			} catch(exception &e) {
+				Logger::WriteMessage(e.what());
+				Assert::Fail();
+			}
+		}
+
+		TEST_METHOD(TicketPriceCalculator_airfareCache_FactorsOfTheBuckets) {
+			Logger::WriteMessage(__FUNCTION__);
+			try {
+        tp::specs::TicketPriceCalculator cheap(3.5f, 6.f, 0.75f, 2.f),
+          pricey(3.5f, 6.f, 0.5f, 4.f);
+        tp::AirfareCache cache;
+        Assert::AreEqual(0ULL, (unsigned long long)cache.size());
+
+        // 3 of 40 seats fall within the bucket of 3/40 = 15/200
+        const float expected = cheap.airplaneFareFactor(1.f - 30.f / 365.f,
+                                                        15.f / 200.f);
+        Assert::AreEqual(expected, cache.factor(cheap, 1U, 3U, 40U, 30L));
+        Assert::AreEqual(expected, cache.factor(cheap, 1U, 3U, 40U, 30L));
+        Assert::AreEqual(1ULL, (unsigned long long)cache.size());
+
+        // Other routes and other buckets get their own factors
+        Assert::AreEqual(pricey.airplaneFareFactor(1.f - 30.f / 365.f,
+                                                   15.f / 200.f),
+                         cache.factor(pricey, 2U, 3U, 40U, 30L));
+        Assert::AreEqual(cheap.airplaneFareFactor(1.f, 1.f),
+                         cache.factor(cheap, 1U, 41U, 40U, -2L));
+        Assert::AreEqual(cheap.airplaneFareFactor(0.f, 0.f),
+                         cache.factor(cheap, 1U, 0U, 40U, 1000L));
+        Assert::AreEqual(4ULL, (unsigned long long)cache.size());
 			} catch(exception &e) {
 				Logger::WriteMessage(e.what());
 				Assert::Fail();
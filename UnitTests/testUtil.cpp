@@ -24,9 +24,18 @@
 
 #include "CppUnitTest.h"
 #include "util.h"
+#include "taskPool.h"
+
+#pragma warning ( push, 0 )
+
+#include <atomic>
+#include <stdexcept>
+
+#pragma warning ( pop )
 
 using namespace Microsoft::VisualStudio::CppUnitTestFramework;
 using namespace std;
+using namespace tp;
 
 namespace UnitTests {
 	TEST_CLASS(TrimAndTokenizerTests) {
@@ -143,4 +152,50 @@ namespace UnitTests {
       Assert::AreEqual((double)Pi, 180.0_deg, 1e-3);
     }
   };
+
+  TEST_CLASS(TaskPoolTests) {
+  public:
+    TEST_METHOD(TaskPool_ParallelLoops_AllIterationsRunOnce) {
+      Logger::WriteMessage(__FUNCTION__);
+
+      TaskPool pool(3U);
+      Assert::AreEqual(3ULL, (unsigned long long)pool.size());
+
+      vector<atomic<unsigned>> runs(1000ULL);
+      for(atomic<unsigned> &r : runs)
+        r = 0U;
+      pool.parallelFor(runs.size(), [&runs](size_t i) { ++runs[i]; });
+      for(const atomic<unsigned> &r : runs)
+        Assert::AreEqual(1U, unsigned(r));
+
+      pool.parallelFor(0ULL, [](size_t) { Assert::Fail(); });
+
+      // Nested loops are helped by the threads waiting for them
+      atomic<size_t> total(0ULL);
+      pool.parallelFor(8ULL, [&pool, &total](size_t) {
+        pool.parallelFor(8ULL, [&total](size_t) { ++total; });
+      });
+      Assert::AreEqual(64ULL, (unsigned long long)total);
+    }
+
+    TEST_METHOD(TaskPool_ThrowingIterations_RethrownAfterTheLoop) {
+      Logger::WriteMessage(__FUNCTION__);
+
+      TaskPool pool(2U);
+      atomic<size_t> finished(0ULL);
+      Assert::ExpectException<domain_error>([&pool, &finished] {
+        pool.parallelFor(100ULL, [&finished](size_t i) {
+          if(i % 10ULL == 3ULL)
+            throw domain_error("failed iteration");
+          ++finished;
+        });
+      });
+      Assert::AreEqual(90ULL, (unsigned long long)finished);
+
+      // The pool remains usable
+      finished = 0ULL;
+      pool.parallelFor(10ULL, [&finished](size_t) { ++finished; });
+      Assert::AreEqual(10ULL, (unsigned long long)finished);
+    }
+  };
 }
@@ -25,6 +25,7 @@
 #include "CppUnitTest.h"
 #include "variant.h"
 #include "connection.h"
+#include "flatResults.h"
 #include "customDateTimeProcessor.h"
 #include "transpModes.h"
 
@@ -129,5 +130,74 @@ namespace UnitTests {
 				size_t(TranspModes::AIR | TranspModes::RAIL | TranspModes::WATER),
 				v.transpModes());
 		}
+
+		TEST_METHOD(FlatResults_RecordsOfSeveralVariants_ViewedAsVariants) {
+			Logger::WriteMessage(__FUNCTION__);
+
+			FlatResults results;
+			const ConnectionRecord conns[] {
+				{ 0ULL, 1ULL, now, after2Hours, size_t(TranspModes::AIR), 123.f, 321.f },
+				{ 1ULL, 2ULL, after3Hours, after4Hours, size_t(TranspModes::RAIL), 12.f, 32.f },
+				{ 2ULL, 3ULL, after7Hours, after9Hours, size_t(TranspModes::WATER), 1.f, 3.f }
+			};
+
+			// The last connection binds to the first one only when skipping the middle one
+			const ConnectionRecord unchained[] { conns[0], conns[2] };
+			Assert::ExpectException<invalid_argument>([&] {
+				results.addVariant(1ULL, unchained, 2ULL);
+			});
+			Assert::ExpectException<out_of_range>([&] {
+				results.addVariant(variantCategories().size(), conns, 3ULL);
+			});
+
+			try {
+				results.addVariant(1ULL, conns, 3ULL);
+				results.addVariant(1ULL, conns + 1, 2ULL);
+				results.addVariant(2ULL, conns + 2, 1ULL);
+				results.addVariant(3ULL, conns, 3ULL); // same as the first journey
+				results.addVariant(0ULL, conns, 2ULL); // prefix of the first journey
+			} catch(exception &e) {
+				Logger::WriteMessage(e.what());
+				Assert::Fail();
+			}
+			Assert::AreEqual(1ULL, (unsigned long long)results.variantsCount(0ULL));
+			Assert::AreEqual(2ULL, (unsigned long long)results.variantsCount(1ULL));
+			Assert::AreEqual(1ULL, (unsigned long long)results.variantsCount(3ULL));
+
+			// The repeated journey and the common prefix are stored once
+			Assert::AreEqual(4ULL, (unsigned long long)results.journeysCount());
+			Assert::AreEqual(6ULL, (unsigned long long)results.legsCount());
+
+			const IVariants &variants = results[1ULL];
+			Assert::AreEqual(2ULL, (unsigned long long)variants.count());
+			const IVariant &v = variants.at(0ULL);
+			Assert::AreEqual(0ULL, v.from());
+			Assert::AreEqual(3ULL, v.to());
+			Assert::IsTrue(now == v.begin());
+			Assert::IsTrue(after9Hours == v.end());
+			Assert::AreEqual(136.f, v.price(), 1e-3f);
+			Assert::AreEqual(356.f, v.distance(), 1e-3f);
+			Assert::AreEqual(
+				size_t(TranspModes::AIR | TranspModes::RAIL | TranspModes::WATER),
+				v.transpModes());
+			Assert::AreEqual(3ULL, (unsigned long long)v.connectionsCount());
+			Assert::IsTrue(after3Hours == v.connection(1ULL).begin());
+
+			// The vectors built on demand provide the same information
+			Assert::AreEqual(2ULL, (unsigned long long)variants.get().size());
+			const IVariant &second = *variants.get()[1ULL];
+			Assert::AreEqual(2ULL, (unsigned long long)second.connections().size());
+			Assert::AreEqual(1ULL, second.connections().front()->from());
+			Assert::AreEqual(13.f, second.price(), 1e-3f);
+			Assert::AreEqual(1ULL, (unsigned long long)results[2ULL].count());
+			Assert::IsTrue(after9Hours == results[3ULL].at(0ULL).end());
+			Assert::IsTrue(after4Hours == results[0ULL].at(0ULL).end());
+			Assert::AreEqual(135.f, results[0ULL].at(0ULL).price(), 1e-3f);
+
+			// The records cannot change after viewing them
+			Assert::ExpectException<logic_error>([&] {
+				results.addVariant(4ULL, conns, 1ULL);
+			});
+		}
 	};
 }
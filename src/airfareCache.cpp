@@ -0,0 +1,106 @@
+/*****************************************************************************
+ TripPlanner explores various issues common to navigation and booking systems.
+
+ Copyrights from the libraries used by the program:
+ - (c) 2017 Boost (www.boost.org)
+		License: <http://www.boost.org/LICENSE_1_0.txt>
+ 
+ (c) 2017 Florin Tulba <florintulba@yahoo.com>
+
+ This program is free software: you can use its results,
+ redistribute it and/or modify it under the terms of the GNU
+ Affero General Public License version 3 as published by the
+ Free Software Foundation.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU Affero General Public License for more details.
+
+ You should have received a copy of the GNU Affero General Public License
+ along with this program ('agpl-3.0.txt').
+ If not, see <http://www.gnu.org/licenses/agpl-3.0.txt>.
+ *****************************************************************************/
+
+#include "airfareCache.h"
+
+#pragma warning ( push, 0 )
+
+#include <algorithm>
+#include <cstring>
+
+#pragma warning ( pop )
+
+using namespace std;
+
+namespace tp { // trip planner
+  using namespace specs;
+
+  constexpr unsigned AirfareCache::OccupancyBuckets;
+  constexpr long AirfareCache::DaysPerYear;
+  constexpr unsigned AirfareCache::SlotBits;
+  constexpr size_t AirfareCache::Slots;
+
+  AirfareCache::AirfareCache() :
+      slots(make_unique<atomic<uint64_t>[]>(Slots)) {
+    for(size_t i = 0ULL; i < Slots; ++i)
+      slots[i].store(0ULL, memory_order_relaxed);
+  }
+
+  uint64_t AirfareCache::keyOf(unsigned routeId, unsigned occupancyBucket,
+                               long daysAhead) {
+    // 32 bits for routeId, 8 bits for occupancyBucket and 9 bits for daysAhead
+    static_assert(OccupancyBuckets < 256U && DaysPerYear < 512L,
+                  "The buckets need more than 17 bits!");
+    static_assert(SlotBits + 32U == 49U, "Slot index + tag must cover 49 bits!");
+    const uint64_t mask = (1ULL << 49) - 1ULL;
+    uint64_t key = (uint64_t(routeId) << 17) | (uint64_t(occupancyBucket) << 9) |
+      uint64_t(daysAhead);
+
+    // Each step is invertible, so distinct keys never get the same result
+    key ^= key >> 25;
+    key = (key * 0x9E3779B97F4A7C15ULL) & mask;
+    return key ^ (key >> 25);
+  }
+
+  float AirfareCache::factor(ITicketPriceCalculator &pricing, unsigned routeId,
+                             unsigned occupied, unsigned capacity,
+                             long daysAhead) {
+    // Rounding up never underestimates the occupancy
+    const unsigned occupancyBucket = (occupied >= capacity) ? OccupancyBuckets :
+      unsigned((uint64_t(occupied) * OccupancyBuckets + capacity - 1ULL) /
+               capacity);
+    daysAhead = min(max(daysAhead, 0L), DaysPerYear);
+
+    const uint64_t key = keyOf(routeId, occupancyBucket, daysAhead),
+      tag = (key >> SlotBits) << 32;
+    atomic<uint64_t> &slot = slots[size_t(key) & (Slots - 1ULL)];
+    const uint64_t cached = slot.load(memory_order_relaxed);
+    float result;
+    if((cached & ~0xFFFFFFFFULL) == tag && (cached & 0xFFFFFFFFULL) != 0ULL) {
+      const uint32_t bits = uint32_t(cached);
+      memcpy(&result, &bits, sizeof result);
+      return result;
+    }
+
+    // 1 for today; 0 for one year from now
+    const float urgency = 1.f - float(daysAhead) / float(DaysPerYear);
+    result = pricing.airplaneFareFactor(
+      urgency, float(occupancyBucket) / float(OccupancyBuckets));
+
+    // Concurrent lookups store the same value or values for other keys
+    uint32_t bits;
+    memcpy(&bits, &result, sizeof bits);
+    slot.store(tag | bits, memory_order_relaxed);
+    return result;
+  }
+
+  size_t AirfareCache::size() const {
+    size_t result = 0ULL;
+    for(size_t i = 0ULL; i < Slots; ++i)
+      if(slots[i].load(memory_order_relaxed) != 0ULL)
+        ++result;
+    return result;
+  }
+
+} // namespace tp
@@ -0,0 +1,117 @@
+/*****************************************************************************
+ TripPlanner explores various issues common to navigation and booking systems.
+
+ Copyrights from the libraries used by the program:
+ - (c) 2017 Boost (www.boost.org)
+		License: <http://www.boost.org/LICENSE_1_0.txt>
+ 
+ (c) 2017 Florin Tulba <florintulba@yahoo.com>
+
+ This program is free software: you can use its results,
+ redistribute it and/or modify it under the terms of the GNU
+ Affero General Public License version 3 as published by the
+ Free Software Foundation.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU Affero General Public License for more details.
+
+ You should have received a copy of the GNU Affero General Public License
+ along with this program ('agpl-3.0.txt').
+ If not, see <http://www.gnu.org/licenses/agpl-3.0.txt>.
+ *****************************************************************************/
+
+#ifndef H_AIRFARE_CACHE
+#define H_AIRFARE_CACHE
+
+#include "pricingBase.h"
+
+#pragma warning ( push, 0 )
+
+#include <atomic>
+#include <memory>
+#include <cstdint>
+
+#pragma warning ( pop )
+
+namespace tp { // trip planner
+
+  /**
+  Remembers the factors applied to the normal fare of the flights
+  (see ITicketPriceCalculator::airplaneFareFactor), so the searches
+  don't evaluate exp for every candidate ride.
+
+  A factor depends only on the pricing engine of the route and on 2 buckets:
+  - the occupancy is split in OccupancyBuckets equal buckets and the factor
+    uses the upper limit of the bucket
+  - the urgency changes once a day, so there is a bucket for each day
+  So the entries are keyed by (routeId, occupancy bucket, urgency bucket)
+  and never become stale: a booking moving a flight into another occupancy
+  bucket makes the next lookup use another key. A data reload rebuilds
+  the map together with its empty cache.
+
+  The entries occupy a fixed table of Slots atomic slots, so the cache
+  never grows and readers never lock. Each slot keeps a part of its key
+  and the factor in a single 64-bit value; the index of the slot provides
+  the rest of the key, so a slot never answers for another key.
+  Colliding keys simply replace each other.
+  */
+  class AirfareCache {
+  public:
+    /// The occupancy is rounded up to a multiple of 1 / OccupancyBuckets
+    static constexpr unsigned OccupancyBuckets = 200U;
+
+    /// The urgency is 0 for flights at least that many days ahead
+    static constexpr long DaysPerYear = 365L;
+
+    /// Count of the bits of the index of a slot
+    static constexpr unsigned SlotBits = 17U;
+
+    /// Count of the slots of the table (1 MB)
+    static constexpr size_t Slots = size_t(1ULL << SlotBits);
+
+  protected:
+    /**
+    Key part (upper 32 bits) and factor bits (lower 32 bits) of every slot.
+    0 for free slots, since the factors are positive
+    */
+    std::unique_ptr<std::atomic<uint64_t>[]> slots;
+
+    /**
+    @return the bijective mix of routeId and of the 2 buckets (49 bits),
+    whose lower SlotBits bits select the slot
+    */
+    static uint64_t keyOf(unsigned routeId, unsigned occupancyBucket,
+                          long daysAhead);
+
+  public:
+    AirfareCache();
+    AirfareCache(const AirfareCache&) = delete;
+    AirfareCache(AirfareCache&&) = delete;
+    void operator=(const AirfareCache&) = delete;
+    void operator=(AirfareCache&&) = delete;
+
+    /**
+    Provides the factor applied to the normal fare of a flight.
+    It never blocks.
+
+    @param pricing the pricing engine of the route of the flight
+    @param routeId the id of the route of the flight (owning pricing)
+    @param occupied the occupied seats within the chosen class
+      after the current booking
+    @param capacity the seats within the chosen class
+    @param daysAhead how many days until the flight
+
+    @return the cached factor for the buckets; a new factor otherwise
+    */
+    float factor(specs::ITicketPriceCalculator &pricing, unsigned routeId,
+                 unsigned occupied, unsigned capacity, long daysAhead);
+
+    /// @return the count of the used slots
+    size_t size() const;
+  };
+
+} // namespace tp
+
+#endif // H_AIRFARE_CACHE
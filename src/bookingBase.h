@@ -0,0 +1,149 @@
+/*****************************************************************************
+ TripPlanner explores various issues common to navigation and booking systems.
+
+ Copyrights from the libraries used by the program:
+ - (c) 2017 Boost (www.boost.org)
+		License: <http://www.boost.org/LICENSE_1_0.txt>
+ 
+ (c) 2017 Florin Tulba <florintulba@yahoo.com>
+
+ This program is free software: you can use its results,
+ redistribute it and/or modify it under the terms of the GNU
+ Affero General Public License version 3 as published by the
+ Free Software Foundation.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU Affero General Public License for more details.
+
+ You should have received a copy of the GNU Affero General Public License
+ along with this program ('agpl-3.0.txt').
+ If not, see <http://www.gnu.org/licenses/agpl-3.0.txt>.
+ *****************************************************************************/
+
+#ifndef H_BOOKING_BASE
+#define H_BOOKING_BASE
+
+#pragma warning ( push, 0 )
+
+#include <cstdint>
+#include <set>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wignored-attributes"
+
+#include <boost/date_time/gregorian/greg_date.hpp>
+
+#pragma clang diagnostic pop
+#pragma warning ( pop )
+
+// namespace trip planner - bookings
+namespace tp { namespace bookings {
+
+  /// The seats of a certain class from a route alternative traveling on a given date
+  struct Leg {
+    unsigned raId;  ///< id of the route alternative
+
+    /// The date when the route alternative leaves its first stop
+    boost::gregorian::date date;
+
+    bool economyClass;  ///< true for economy class; false for business class
+  };
+
+  /// Read-only access to the occupied seats. Reading it requires no locking
+  struct IOccupancyView /*abstract*/ {
+    virtual ~IOccupancyView() /*= 0*/ {}
+
+    /// @return the occupied seats of the class chosen by leg
+    virtual unsigned occupied(const Leg &leg) const = 0;
+  };
+
+  /// Fingerprints of the travel conditions of a route alternative
+  struct TravelConditions {
+    uint64_t timetable; ///< hash of the timetable
+    uint64_t calendar;    ///< hash of the operational days of a week and of the unavailable days
+  };
+
+  /// The travel conditions of several route alternatives, by their id
+  typedef std::unordered_map<unsigned, TravelConditions> TravelConditionsById;
+
+  /**
+  Reserves and releases seats for trips containing one or more legs.
+
+  A booking covers the same number of persons on every leg and
+  either succeeds for all the legs, or for none of them.
+  Later cancellations for any number of the booked persons are allowed.
+  */
+  struct IBookingSystem /*abstract*/ {
+    virtual ~IBookingSystem() /*= 0*/ {}
+
+    /**
+    Attempts to reserve seats for `persons` on every leg from `legs`.
+
+    @param legs the legs of the trip
+    @param persons how many persons travel together
+    @param bookingId receives the id of the new booking when successful
+    @param maxPersons receives the largest number of persons
+      that could have booked these legs during the attempt
+      (relevant when the booking fails)
+
+    @return true if all legs were reserved; false if there were not enough seats
+
+    @throw invalid_argument for empty legs, 0 persons or
+      legs whose route alternative doesn't operate on the given date
+    @throw domain_error for unknown route alternatives
+    */
+    virtual bool book(const std::vector<Leg> &legs, unsigned persons,
+                      unsigned &bookingId, unsigned &maxPersons) = 0;
+
+    /**
+    Cancels the tickets of `persons` from the booking with bookingId.
+    When all the persons get cancelled, the booking is forgotten.
+
+    @throw invalid_argument for unknown bookingId,
+      or when persons is 0 or larger than the still booked persons
+    */
+    virtual void cancel(unsigned bookingId, unsigned persons) = 0;
+
+    /// @return the number of persons still covered by the booking with bookingId
+    /// or 0 for unknown / entirely cancelled bookings
+    virtual unsigned bookedPersons(unsigned bookingId) const = 0;
+
+    /// @return the free seats of the class chosen by leg
+    /// @throw domain_error for unknown route alternatives
+    virtual unsigned availableSeats(const Leg &leg) const = 0;
+
+    /**
+    @return the live occupancy for every (raId, date), covering at least
+    the bookings / cancellations completed before each of its reads.
+    It must not outlive the booking system.
+    */
+    virtual std::shared_ptr<const IOccupancyView> occupancyView() const = 0;
+
+    /// @return the travel conditions of the route alternatives with active bookings.
+    /// Meant to be called before reloading the specifications
+    virtual TravelConditionsById bookedTravelConditions() const = 0;
+
+    /**
+    Finds the bookings affected by the changes from the specifications.
+    Only the route alternatives from `before` whose fingerprints differ now
+    are inspected:
+    - a removed route alternative or a changed timetable affect
+      all the bookings of that route alternative
+    - a changed calendar affects the bookings for the dates
+      when the route alternative doesn't operate anymore
+
+    @param before the result of bookedTravelConditions() prior to the reload
+    @return the ids of the affected active bookings
+    */
+    virtual std::set<unsigned>
+      affectedBookings(const TravelConditionsById &before) const = 0;
+  };
+
+}} // namespace tp::bookings
+
+#endif // H_BOOKING_BASE
@@ -0,0 +1,464 @@
+/*****************************************************************************
+ TripPlanner explores various issues common to navigation and booking systems.
+
+ Copyrights from the libraries used by the program:
+ - (c) 2017 Boost (www.boost.org)
+		License: <http://www.boost.org/LICENSE_1_0.txt>
+ 
+ (c) 2017 Florin Tulba <florintulba@yahoo.com>
+
+ This program is free software: you can use its results,
+ redistribute it and/or modify it under the terms of the GNU
+ Affero General Public License version 3 as published by the
+ Free Software Foundation.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU Affero General Public License for more details.
+
+ You should have received a copy of the GNU Affero General Public License
+ along with this program ('agpl-3.0.txt').
+ If not, see <http://www.gnu.org/licenses/agpl-3.0.txt>.
+ *****************************************************************************/
+
+#include "bookingJournal.h"
+
+#pragma warning ( push, 0 )
+
+#include <iostream>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <stdexcept>
+
+#ifdef _MSC_VER
+# include <io.h>
+#else // _MSC_VER not defined
+# include <fcntl.h>
+# include <unistd.h>
+#endif // _MSC_VER
+
+#include <boost/filesystem/operations.hpp>
+#include <boost/date_time/gregorian/formatters.hpp>
+#include <boost/date_time/gregorian/parsers.hpp>
+
+#pragma warning ( pop )
+
+using namespace std;
+using namespace boost::gregorian;
+using namespace boost::filesystem;
+
+namespace {
+  /// Writes data to f and makes sure it reaches the disk
+  bool writeAndSync(FILE *f, const string &data) {
+    if(nullptr == f)
+      return false;
+
+    if(!data.empty() &&
+       fwrite(data.data(), 1ULL, data.size(), f) != data.size())
+      return false;
+
+    if(fflush(f) != 0)
+      return false;
+
+#ifdef _MSC_VER
+    return _commit(_fileno(f)) == 0;
+#else // _MSC_VER not defined
+    return fsync(fileno(f)) == 0;
+#endif // _MSC_VER
+  }
+
+  /// Makes the latest renames / creations of files within folder durable
+  bool syncFolder(const path &folder) {
+#ifdef _MSC_VER
+    // Windows doesn't sync folders; NTFS journals their changes
+    return true;
+#else // _MSC_VER not defined
+    const int fd = open(folder.string().c_str(), O_RDONLY);
+    if(fd < 0)
+      return false;
+    const bool ok = (fsync(fd) == 0);
+    close(fd);
+    return ok;
+#endif // _MSC_VER
+  }
+
+  /// @return the records (one per line) with sequence numbers after seq
+  string recordsAfter(const string &records, uint64_t seq) {
+    size_t lineStart = 0ULL;
+    while(lineStart < records.size()) {
+      istringstream iss(records.substr(lineStart, 32ULL));
+      char kind = '\0';
+      uint64_t recordSeq = 0ULL;
+      if((iss>>kind>>recordSeq) && recordSeq > seq)
+        break; // the sequence numbers are increasing
+      const size_t lineEnd = records.find('\n', lineStart);
+      if(lineEnd == string::npos)
+        return "";
+      lineStart = lineEnd + 1ULL;
+    }
+    return records.substr(lineStart);
+  }
+
+  /// Appends the count of the legs followed by the legs
+  void writeLegs(ostream &os, const vector<tp::bookings::Leg> &legs) {
+    os<<' '<<legs.size();
+    for(const tp::bookings::Leg &leg : legs)
+      os<<' '<<leg.raId<<' '<<to_iso_string(leg.date)<<' '
+        <<(leg.economyClass ? 'e' : 'b');
+  }
+
+  /// Reads the legs written by writeLegs
+  bool readLegs(istream &is, vector<tp::bookings::Leg> &legs) {
+    size_t legsCount = 0ULL;
+    if(!(is>>legsCount) || legsCount == 0ULL)
+      return false;
+
+    legs.clear();
+    legs.reserve(legsCount);
+    for(size_t i = 0ULL; i < legsCount; ++i) {
+      unsigned raId = 0U;
+      string day;
+      char seatsClass = '\0';
+      if(!(is>>raId>>day>>seatsClass) ||
+         (seatsClass != 'e' && seatsClass != 'b'))
+        return false;
+
+      try {
+        legs.push_back(
+          tp::bookings::Leg { raId, from_undelimited_string(day),
+                              seatsClass == 'e' });
+      } catch(exception&) {
+        return false;
+      }
+    }
+    return true;
+  }
+} // anonymous namespace
+
+// namespace trip planner - bookings
+namespace tp { namespace bookings {
+
+  bool BookingJournal::apply(const string &record,
+                             bool undoable/* = false*/) {
+    istringstream iss(record);
+    char kind = '\0';
+    uint64_t seq = 0ULL;
+    unsigned bookingId = 0U, persons = 0U;
+    if(!(iss>>kind>>seq>>bookingId>>persons) || persons == 0U)
+      return false;
+
+    if(seq <= lastSeq)
+      return true; // already covered by the snapshot
+
+    if(kind == 'B') {
+      BookingImage booking { {}, persons };
+      if(!readLegs(iss, booking.legs))
+        return false;
+
+      if(undoable) {
+        const auto it = bookings.find(bookingId);
+        if(cend(bookings) == it)
+          undoLog.push_back(Undo { seq, bookingId, false, BookingImage() });
+        else
+          undoLog.push_back(Undo { seq, bookingId, true, it->second });
+      }
+      bookings[bookingId] = move(booking);
+      if(bookingId >= _nextBookingId)
+        _nextBookingId = bookingId + 1U;
+
+    } else if(kind == 'C') {
+      const auto it = bookings.find(bookingId);
+      if(cend(bookings) == it || it->second.persons < persons)
+        return false;
+
+      if(undoable)
+        undoLog.push_back(Undo { seq, bookingId, true, it->second });
+      if((it->second.persons -= persons) == 0U)
+        bookings.erase(it);
+
+    } else return false;
+
+    lastSeq = seq;
+    return true;
+  }
+
+  void BookingJournal::undoPending() {
+    for(auto it = undoLog.crbegin(); it != undoLog.crend(); ++it) {
+      if(it->existed)
+        bookings[it->bookingId] = it->previous;
+      else
+        bookings.erase(it->bookingId);
+    }
+    undoLog.clear();
+    pending.clear();
+    lastSeq = durableSeq;
+  }
+
+  void BookingJournal::append(const string &kindAndData) {
+    unique_lock<mutex> lock(mtx);
+    if(failed)
+      throw runtime_error(string(__func__) +
+                          " - the booking journal couldn't be written!");
+
+    ostringstream oss;
+    oss<<kindAndData[0]<<' '<<lastSeq + 1ULL<<kindAndData.substr(1ULL)<<'\n';
+    const string record = oss.str();
+    if(!apply(record, true))
+      throw invalid_argument(string(__func__) + " received an invalid record: "
+                             + record);
+
+    const uint64_t seq = lastSeq;
+    pending += record;
+    ++recordsSinceSnapshot;
+
+    while(durableSeq < seq) {
+      if(failed)
+        throw runtime_error(string(__func__) +
+                            " - the booking journal couldn't be written!");
+
+      if(flushing) { // some other caller is writing; its flush might cover seq
+        flushed.wait(lock);
+        continue;
+      }
+
+      // Become the leader of a group commit for all the pending records
+      flushing = true;
+      string batch;
+      batch.swap(pending);
+      const uint64_t batchLastSeq = lastSeq;
+
+      lock.unlock();
+      const bool ok = writeAndSync(journal, batch);
+      lock.lock();
+
+      flushing = false;
+      ++flushesCount;
+      if(ok) {
+        durableSeq = batchLastSeq;
+        while(!undoLog.empty() && undoLog.front().seq <= durableSeq)
+          undoLog.pop_front();
+        if(snapshotting)
+          writtenDuringSnapshot += batch;
+        else if(recordsSinceSnapshot >= snapshotEvery) {
+          try {
+            writeSnapshot(lock);
+          } catch(exception &e) { // the records are durable within the journal
+            cerr<<"Warning - Couldn't compact the booking journal: "
+              <<e.what()<<endl;
+          }
+        }
+      } else {
+        // bookings must reflect only the durable records from now on
+        failed = true;
+        undoPending();
+      }
+      flushed.notify_all();
+    }
+  }
+
+  void BookingJournal::writeSnapshot(unique_lock<mutex> &lock) {
+    if(failed)
+      throw runtime_error(string(__func__) + " - the booking journal couldn't "
+                          "be written, so no snapshot is taken!");
+
+    ostringstream oss;
+    oss<<"S "<<lastSeq<<' '<<_nextBookingId<<' '<<bookings.size()<<'\n';
+    for(const auto &idAndBooking : bookings) {
+      oss<<idAndBooking.first<<' '<<idAndBooking.second.persons;
+      writeLegs(oss, idAndBooking.second.legs);
+      oss<<'\n';
+    }
+
+    const uint64_t snapshotSeq = lastSeq;
+    const size_t coveredRecords = recordsSinceSnapshot;
+    recordsSinceSnapshot = 0ULL;
+    writtenDuringSnapshot.clear();
+    snapshotting = true;
+
+    path tempPath(snapshotPath);
+    tempPath += ".tmp";
+
+    lock.unlock();
+    FILE *f = fopen(tempPath.string().c_str(), "wb");
+    const bool ok = writeAndSync(f, oss.str());
+    if(nullptr != f)
+      fclose(f);
+    lock.lock();
+
+    // The previous snapshot and the journal are replaced only between flushes
+    flushed.wait(lock, [this] { return !flushing; });
+    try {
+      if(!ok)
+        throw runtime_error(string(__func__) + " couldn't write "
+                            + tempPath.string());
+      if(failed)
+        throw runtime_error(string(__func__) + " - the booking journal "
+                            "couldn't be written while taking a snapshot!");
+
+      // Replacing the previous snapshot is atomic,
+      // but it is durable only after syncing the folder
+      boost::filesystem::rename(tempPath, snapshotPath);
+      if(!syncFolder(snapshotPath.parent_path()))
+        throw runtime_error(string(__func__) + " couldn't sync the folder of "
+                            + snapshotPath.string());
+
+    } catch(exception&) {
+      boost::system::error_code ec;
+      boost::filesystem::remove(tempPath, ec);
+      recordsSinceSnapshot += coveredRecords;
+      writtenDuringSnapshot.clear();
+      snapshotting = false;
+      flushed.notify_all();
+      throw;
+    }
+
+    // The records up to snapshotSeq are now durable within the snapshot
+    if(durableSeq < snapshotSeq)
+      durableSeq = snapshotSeq;
+    pending = recordsAfter(pending, snapshotSeq);
+    while(!undoLog.empty() && undoLog.front().seq <= durableSeq)
+      undoLog.pop_front();
+    const string newerRecords = recordsAfter(writtenDuringSnapshot, snapshotSeq);
+    writtenDuringSnapshot.clear();
+    snapshotting = false;
+    flushed.notify_all();
+
+    // Replacing the journal is optional: its records up to snapshotSeq are
+    // older than the snapshot and the newer ones are copied first
+    path tempJournalPath(journalPath);
+    tempJournalPath += ".tmp";
+    f = fopen(tempJournalPath.string().c_str(), "wb");
+    const bool copied = writeAndSync(f, newerRecords);
+    if(nullptr != f)
+      fclose(f);
+    if(!copied)
+      throw runtime_error(string(__func__) + " couldn't write "
+                          + tempJournalPath.string());
+
+    if(nullptr != journal)
+      fclose(journal);
+    boost::system::error_code ec;
+    boost::filesystem::rename(tempJournalPath, journalPath, ec);
+    journal = fopen(journalPath.string().c_str(), "ab");
+    if(ec || nullptr == journal || !syncFolder(journalPath.parent_path())) {
+      failed = true;
+      throw runtime_error(string(__func__) + " couldn't replace "
+                          + journalPath.string());
+    }
+  }
+
+  BookingJournal::BookingJournal(const path &dir,
+                                 size_t snapshotEvery_/* = 10000ULL*/) :
+      journalPath(dir / "bookings.journal"),
+      snapshotPath(dir / "bookings.snapshot"),
+      snapshotEvery(snapshotEvery_) {
+    if(snapshotEvery == 0ULL)
+      throw invalid_argument(string(__func__) +
+                             " expects snapshotEvery_ larger than 0!");
+
+    create_directories(dir);
+
+    if(exists(snapshotPath)) {
+      ifstream ifs(snapshotPath.string(), ios::binary);
+      char kind = '\0';
+      size_t bookingsCount = 0ULL;
+      if(!(ifs>>kind>>lastSeq>>_nextBookingId>>bookingsCount) || kind != 'S')
+        throw runtime_error(string(__func__) + " found a corrupt snapshot in "
+                            + snapshotPath.string());
+
+      for(size_t i = 0ULL; i < bookingsCount; ++i) {
+        unsigned bookingId = 0U;
+        BookingImage booking { {}, 0U };
+        if(!(ifs>>bookingId>>booking.persons) || booking.persons == 0U ||
+           !readLegs(ifs, booking.legs))
+          throw runtime_error(string(__func__) + " found a corrupt snapshot in "
+                              + snapshotPath.string());
+        bookings[bookingId] = move(booking);
+      }
+    }
+
+    if(exists(journalPath)) {
+      string records;
+      {
+        ifstream ifs(journalPath.string(), ios::binary);
+        records.assign(istreambuf_iterator<char>(ifs),
+                       istreambuf_iterator<char>());
+      }
+
+      // Only the records ending in a newline were written completely
+      size_t validLength = 0ULL;
+      for(size_t lineEnd = records.find('\n'); lineEnd != string::npos;
+          lineEnd = records.find('\n', validLength)) {
+        const string record = records.substr(validLength,
+                                             lineEnd - validLength);
+        if(!apply(record)) {
+          cerr<<"Warning - Ignoring the booking journal from the record: `"
+            <<record<<'`'<<endl;
+          break;
+        }
+        validLength = lineEnd + 1ULL;
+      }
+
+      // Drops the record torn by a crash during its writing
+      if(validLength < records.size())
+        resize_file(journalPath, validLength);
+    }
+
+    // Recovery should replay the records above only once
+    unique_lock<mutex> lock(mtx);
+    writeSnapshot(lock);
+  }
+
+  BookingJournal::~BookingJournal() {
+    unique_lock<mutex> lock(mtx);
+    flushed.wait(lock, [this] { return !flushing && !snapshotting; });
+    if(!failed && !pending.empty())
+      writeAndSync(journal, pending);
+    if(nullptr != journal) {
+      fclose(journal);
+      journal = nullptr;
+    }
+  }
+
+  const BookingJournal::Bookings& BookingJournal::activeBookings() const {
+    return bookings;
+  }
+
+  unsigned BookingJournal::nextBookingId() const {
+    lock_guard<mutex> lock(mtx);
+    return _nextBookingId;
+  }
+
+  void BookingJournal::bookingDone(unsigned bookingId, const vector<Leg> &legs,
+                                   unsigned persons) {
+    ostringstream oss;
+    oss<<"B "<<bookingId<<' '<<persons;
+    writeLegs(oss, legs);
+    append(oss.str());
+  }
+
+  void BookingJournal::cancellationDone(unsigned bookingId, unsigned persons) {
+    ostringstream oss;
+    oss<<"C "<<bookingId<<' '<<persons;
+    append(oss.str());
+  }
+
+  void BookingJournal::compact() {
+    unique_lock<mutex> lock(mtx);
+    flushed.wait(lock, [this] { return !flushing && !snapshotting; });
+    writeSnapshot(lock);
+  }
+
+  uint64_t BookingJournal::durableSequence() const {
+    lock_guard<mutex> lock(mtx);
+    return durableSeq;
+  }
+
+  size_t BookingJournal::groupCommits() const {
+    lock_guard<mutex> lock(mtx);
+    return flushesCount;
+  }
+
+}} // namespace tp::bookings
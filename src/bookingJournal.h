@@ -0,0 +1,191 @@
+/*****************************************************************************
+ TripPlanner explores various issues common to navigation and booking systems.
+
+ Copyrights from the libraries used by the program:
+ - (c) 2017 Boost (www.boost.org)
+		License: <http://www.boost.org/LICENSE_1_0.txt>
+ 
+ (c) 2017 Florin Tulba <florintulba@yahoo.com>
+
+ This program is free software: you can use its results,
+ redistribute it and/or modify it under the terms of the GNU
+ Affero General Public License version 3 as published by the
+ Free Software Foundation.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU Affero General Public License for more details.
+
+ You should have received a copy of the GNU Affero General Public License
+ along with this program ('agpl-3.0.txt').
+ If not, see <http://www.gnu.org/licenses/agpl-3.0.txt>.
+ *****************************************************************************/
+
+#ifndef H_BOOKING_JOURNAL
+#define H_BOOKING_JOURNAL
+
+#include "bookingBase.h"
+
+#pragma warning ( push, 0 )
+
+#include <cstdio>
+#include <cstdint>
+#include <string>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <unordered_map>
+
+#include <boost/filesystem/path.hpp>
+
+#pragma warning ( pop )
+
+// namespace trip planner - bookings
+namespace tp { namespace bookings {
+
+  /**
+  Append-only journal of the bookings and cancellations, plus a snapshot
+  of the bookings still active when the journal was last compacted.
+
+  Every record gets a sequence number. A record is durable only after
+  the journal file was flushed to disk. Concurrent callers share the same
+  flush (group commit): the first waiting caller writes and syncs all
+  the records appended meanwhile by the others, which then just wait for it.
+
+  After every `snapshotEvery` records, the active bookings are saved to the
+  snapshot file together with the last sequence number and the journal
+  gets truncated. Recovery loads the snapshot and replays only the journal
+  records with larger sequence numbers. A last record missing its newline
+  was torn by a crash, so it is dropped from the journal.
+  */
+  class BookingJournal {
+  public:
+    /// An active booking, as recovered from the journal
+    struct BookingImage {
+      std::vector<Leg> legs;  ///< the legs of the trip
+      unsigned persons;       ///< persons still covered by the booking
+    };
+
+    /// Active bookings by their id
+    typedef std::unordered_map<unsigned, BookingImage> Bookings;
+
+  protected:
+    boost::filesystem::path journalPath;  ///< the file with the records
+    boost::filesystem::path snapshotPath; ///< the file with the snapshot
+
+    size_t snapshotEvery; ///< how many records trigger a compaction
+
+    mutable std::mutex mtx; ///< protects the fields below
+    std::condition_variable flushed; ///< signals the end of a flush
+
+    FILE *journal = nullptr;  ///< the journal file, opened for appending
+    std::string pending;      ///< the records not written yet
+
+    uint64_t lastSeq = 0ULL;      ///< sequence number of the last record
+    uint64_t durableSeq = 0ULL;   ///< last record known to be on the disk
+    size_t recordsSinceSnapshot = 0ULL; ///< records after the last compaction
+    size_t flushesCount = 0ULL;   ///< the performed group commits
+
+    bool flushing = false;  ///< is there a caller writing the journal?
+    bool snapshotting = false;  ///< is there a caller writing a snapshot?
+    bool failed = false;    ///< was there any error while writing?
+
+    /// The records written to the journal while snapshotting
+    std::string writtenDuringSnapshot;
+
+    Bookings bookings;  ///< the active bookings, including the pending records
+    unsigned _nextBookingId = 1U; ///< larger than any id from the journal
+
+    /// How to revert a record which isn't durable yet
+    struct Undo {
+      uint64_t seq;           ///< sequence number of the record
+      unsigned bookingId;     ///< the booking changed by the record
+      bool existed;           ///< was the booking active before the record?
+      BookingImage previous;  ///< the booking before the record, if existed
+    };
+
+    /// Reverts of the records after durableSeq, in the order of the records
+    std::deque<Undo> undoLog;
+
+    /**
+    Applies a record to bookings, unless its sequence number isn't
+    larger than lastSeq (record already covered by the snapshot).
+    When undoable, it also saves the way to revert it within undoLog.
+    @return false for malformed / inconsistent records
+    */
+    bool apply(const std::string &record, bool undoable = false);
+
+    /// Reverts the records which didn't become durable after a failed write
+    void undoPending();
+
+    /// Assigns a sequence number to the record `kindAndData`,
+    /// applies it and waits until it becomes durable
+    void append(const std::string &kindAndData);
+
+    /**
+    Saves bookings and truncates the journal. Expects lock to own mtx and
+    no other snapshot in progress. The snapshot is written and synced with
+    mtx unlocked, so the group commits continue meanwhile. It replaces
+    the previous snapshot with mtx locked and no flushing, and the journal
+    keeps only the records newer than the new snapshot.
+
+    @throw runtime_error after a failed write of the journal, since bookings
+      might differ from the durable records
+    */
+    void writeSnapshot(std::unique_lock<std::mutex> &lock);
+
+  public:
+    /**
+    Recovers the active bookings from the journal and snapshot files
+    within folder dir, which gets created if missing.
+    The recovered bookings are compacted right away.
+
+    @param dir the folder of the journal and snapshot files
+    @param snapshotEvery_ how many records trigger a compaction
+
+    @throw invalid_argument for snapshotEvery_ == 0
+    @throw runtime_error when the files cannot be opened / written
+    */
+    BookingJournal(const boost::filesystem::path &dir,
+                   size_t snapshotEvery_ = 10000ULL);
+    ~BookingJournal(); ///< flushes the pending records and closes the journal
+
+    BookingJournal(const BookingJournal&) = delete;
+    BookingJournal(BookingJournal&&) = delete;
+    void operator=(const BookingJournal&) = delete;
+    void operator=(BookingJournal&&) = delete;
+
+    /// The active bookings. Meant for the recovery, before any concurrent use
+    const Bookings& activeBookings() const;
+
+    /// @return an id larger than any id from the journal
+    unsigned nextBookingId() const;
+
+    /**
+    Records the new booking bookingId and returns after the record is durable.
+    @throw runtime_error if the journal cannot be written
+    */
+    void bookingDone(unsigned bookingId, const std::vector<Leg> &legs,
+                     unsigned persons);
+
+    /**
+    Records the cancellation and returns after the record is durable.
+    @throw runtime_error if the journal cannot be written
+    */
+    void cancellationDone(unsigned bookingId, unsigned persons);
+
+    /**
+    Saves the active bookings and truncates the journal.
+    @throw runtime_error if the snapshot cannot be written
+      or after a failed write of the journal
+    */
+    void compact();
+
+    uint64_t durableSequence() const; ///< @return last record known to be on the disk
+    size_t groupCommits() const; ///< @return the number of performed flushes
+  };
+
+}} // namespace tp::bookings
+
+#endif // H_BOOKING_JOURNAL
@@ -0,0 +1,346 @@
+/*****************************************************************************
+ TripPlanner explores various issues common to navigation and booking systems.
+
+ Copyrights from the libraries used by the program:
+ - (c) 2017 Boost (www.boost.org)
+		License: <http://www.boost.org/LICENSE_1_0.txt>
+ 
+ (c) 2017 Florin Tulba <florintulba@yahoo.com>
+
+ This program is free software: you can use its results,
+ redistribute it and/or modify it under the terms of the GNU
+ Affero General Public License version 3 as published by the
+ Free Software Foundation.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU Affero General Public License for more details.
+
+ You should have received a copy of the GNU Affero General Public License
+ along with this program ('agpl-3.0.txt').
+ If not, see <http://www.gnu.org/licenses/agpl-3.0.txt>.
+ *****************************************************************************/
+
+#include "bookingSystem.h"
+#include "util.h"
+
+#pragma warning ( push, 0 )
+
+#include <algorithm>
+#include <climits>
+#include <exception>
+#include <sstream>
+#include <stdexcept>
+#include <cassert>
+
+#include <boost/date_time/gregorian/formatters.hpp>
+
+#pragma warning ( pop )
+
+using namespace std;
+using namespace boost::gregorian;
+using namespace boost::posix_time;
+
+namespace {
+  /// Accumulates v into the hash h
+  uint64_t mix(uint64_t h, uint64_t v) {
+    h = (h ^ v) * 0x9E3779B97F4A7C15ULL;
+    return h ^ (h >> 29);
+  }
+
+  /// Accumulates moment t into the hash h
+  uint64_t mix(uint64_t h, const ptime &t) {
+    return mix(mix(h, (uint64_t)t.date().day_number()),
+               (uint64_t)t.time_of_day().ticks());
+  }
+
+  /// @return the fingerprints of the timetable and of the calendar of ra
+  tp::bookings::TravelConditions
+      travelConditions(const tp::specs::IRouteAlternative &ra) {
+    tp::bookings::TravelConditions result { 0ULL, 0ULL };
+    for(const time_period &tp : ra.timetable())
+      result.timetable = mix(mix(result.timetable, tp.begin()), tp.last());
+
+    result.calendar = mix(0ULL, ra.operationalDaysOfWeek()->to_ullong());
+    for(const date &d : *ra.unavailDaysForTheYearAhead())
+      result.calendar = mix(result.calendar, (uint64_t)d.day_number());
+    return result;
+  }
+} // anonymous namespace
+
+// namespace trip planner - bookings
+namespace tp { namespace bookings {
+  using namespace specs;
+
+  unsigned BookingSystem::capacity(const Leg &leg) const {
+    const IRouteAlternative &ra = infoSrc.routeAlternative(leg.raId);
+    if(!operatesOn(ra, leg.date))
+      return 0U;
+
+    return leg.economyClass ?
+      ra.economySeatsCapacity() : ra.businessSeatsCapacity();
+  }
+
+  BookingSystem::BookingsStripe& BookingSystem::stripeFor(unsigned bookingId) {
+    return bookingsStripes[bookingId % StripesCount];
+  }
+
+  const BookingSystem::BookingsStripe&
+      BookingSystem::stripeFor(unsigned bookingId) const {
+    return bookingsStripes[bookingId % StripesCount];
+  }
+
+  BookingSystem::BookedLegsStripe& BookingSystem::legsStripeFor(unsigned raId) {
+    return bookedLegsStripes[raId % StripesCount];
+  }
+
+  const BookingSystem::BookedLegsStripe&
+      BookingSystem::legsStripeFor(unsigned raId) const {
+    return bookedLegsStripes[raId % StripesCount];
+  }
+
+  void BookingSystem::indexBooking(unsigned bookingId, const vector<Leg> &legs) {
+    for(const Leg &leg : legs) {
+      BookedLegsStripe &stripe = legsStripeFor(leg.raId);
+      lock_guard<mutex> lock(stripe.guard);
+      stripe.bookingsByLeg[leg.raId][leg.date].insert(bookingId);
+    }
+  }
+
+  void BookingSystem::unindexBooking(unsigned bookingId, const vector<Leg> &legs) {
+    for(const Leg &leg : legs) {
+      BookedLegsStripe &stripe = legsStripeFor(leg.raId);
+      lock_guard<mutex> lock(stripe.guard);
+      const auto itRa = stripe.bookingsByLeg.find(leg.raId);
+      if(cend(stripe.bookingsByLeg) == itRa)
+        continue; // a previous leg had the same raId and date
+
+      const auto itDate = itRa->second.find(leg.date);
+      if(cend(itRa->second) == itDate)
+        continue; // a previous leg had the same raId and date
+
+      itDate->second.erase(bookingId);
+      if(itDate->second.empty()) {
+        itRa->second.erase(itDate);
+        if(itRa->second.empty())
+          stripe.bookingsByLeg.erase(itRa);
+      }
+    }
+  }
+
+  BookingSystem::BookingSystem(const InfoSource &infoSrc_,
+                               unique_ptr<BookingJournal> journal_/* = nullptr*/) :
+      infoSrc(infoSrc_), journal(move(journal_)), nextBookingId(1U) {
+    if(nullptr == journal)
+      return;
+
+    // The recovered bookings keep their seats even if the capacities were reduced
+    for(const auto &idAndBooking : journal->activeBookings()) {
+      const BookingJournal::BookingImage &booking = idAndBooking.second;
+      for(const Leg &leg : booking.legs)
+        inventory.occupancy(leg.raId, leg.date).seats(leg.economyClass) +=
+          booking.persons;
+
+      stripeFor(idAndBooking.first).bookings.emplace(
+        idAndBooking.first, Booking { booking.legs, booking.persons });
+      indexBooking(idAndBooking.first, booking.legs);
+    }
+    nextBookingId = journal->nextBookingId();
+  }
+
+  bool BookingSystem::book(const vector<Leg> &legs, unsigned persons,
+                           unsigned &bookingId, unsigned &maxPersons) {
+    if(legs.empty() || persons == 0U)
+      throw invalid_argument(string(__func__) +
+                             " expects at least 1 leg and 1 person!");
+
+    const size_t legsCount = legs.size();
+    vector<unsigned> capacities(legsCount);
+    vector<atomic<unsigned>*> counters(legsCount);
+    for(size_t i = 0ULL; i < legsCount; ++i) {
+      const Leg &leg = legs[i];
+      const IRouteAlternative &ra = infoSrc.routeAlternative(leg.raId);
+      if(!operatesOn(ra, leg.date)) {
+        ostringstream oss;
+        oss<<__func__<<" received a leg for route alternative "<<leg.raId
+          <<" on "<<to_simple_string(leg.date)
+          <<", when that route alternative doesn't operate!";
+        throw invalid_argument(oss.str());
+      }
+      capacities[i] = leg.economyClass ?
+        ra.economySeatsCapacity() : ra.businessSeatsCapacity();
+      counters[i] = &inventory.occupancy(leg.raId, leg.date).
+        seats(leg.economyClass);
+    }
+
+    // Try to reserve all legs. The first failure undoes the previous reservations
+    maxPersons = UINT_MAX;
+    size_t reserved = 0ULL;
+    for(; reserved < legsCount; ++reserved) {
+      unsigned freeSeats;
+      if(!inventory.tryOccupy(*counters[reserved], persons,
+                              capacities[reserved], freeSeats))
+        break;
+      maxPersons = min(maxPersons, freeSeats);
+    }
+
+    if(reserved < legsCount) {
+      while(reserved-- > 0ULL)
+        inventory.release(*counters[reserved], persons);
+
+      maxPersons = UINT_MAX;
+      for(size_t i = 0ULL; i < legsCount; ++i) {
+        const unsigned taken = counters[i]->load();
+        maxPersons = min(maxPersons,
+                         (taken < capacities[i]) ? (capacities[i] - taken) : 0U);
+      }
+      return false;
+    }
+
+    bookingId = nextBookingId++;
+    if(nullptr != journal) {
+      try {
+        journal->bookingDone(bookingId, legs, persons);
+      } catch(...) {
+        for(size_t i = 0ULL; i < legsCount; ++i)
+          inventory.release(*counters[i], persons);
+        throw;
+      }
+    }
+
+    // Indexed before becoming visible to cancel
+    indexBooking(bookingId, legs);
+
+    BookingsStripe &stripe = stripeFor(bookingId);
+    lock_guard<mutex> lock(stripe.guard);
+    stripe.bookings.emplace(bookingId, Booking { legs, persons });
+    return true;
+  }
+
+  void BookingSystem::cancel(unsigned bookingId, unsigned persons) {
+    BookingsStripe &stripe = stripeFor(bookingId);
+    vector<Leg> legs;
+    {
+      lock_guard<mutex> lock(stripe.guard);
+      const auto it = stripe.bookings.find(bookingId);
+      if(cend(stripe.bookings) == it ||
+         persons == 0U || persons > it->second.persons) {
+        ostringstream oss;
+        oss<<__func__<<" cannot cancel "<<persons<<" person(s) from booking "
+          <<bookingId<<'!';
+        throw invalid_argument(oss.str());
+      }
+
+      // Reserves the cancellation, so concurrent cancellations see it.
+      // The booking stays known while any cancellation waits for the journal
+      Booking &booking = it->second;
+      booking.persons -= persons;
+      ++booking.cancelling;
+      legs = booking.legs;
+    }
+
+    // The journal gets written without holding the lock of the stripe
+    exception_ptr failure;
+    if(nullptr != journal) {
+      try {
+        journal->cancellationDone(bookingId, persons);
+      } catch(...) {
+        failure = current_exception();
+      }
+    }
+
+    bool forgotten = false;
+    {
+      lock_guard<mutex> lock(stripe.guard);
+      const auto it = stripe.bookings.find(bookingId);
+      assert(cend(stripe.bookings) != it);
+      Booking &booking = it->second;
+      --booking.cancelling;
+      if(nullptr != failure)
+        booking.persons += persons;
+      else if(booking.persons == 0U && booking.cancelling == 0U) {
+        stripe.bookings.erase(it);
+        forgotten = true;
+      }
+    }
+    if(nullptr != failure)
+      rethrow_exception(failure);
+
+    if(forgotten)
+      unindexBooking(bookingId, legs);
+
+    for(const Leg &leg : legs)
+      inventory.release(inventory.occupancy(leg.raId, leg.date).
+                          seats(leg.economyClass),
+                        persons);
+  }
+
+  unsigned BookingSystem::bookedPersons(unsigned bookingId) const {
+    const BookingsStripe &stripe = stripeFor(bookingId);
+    lock_guard<mutex> lock(stripe.guard);
+    const auto it = stripe.bookings.find(bookingId);
+    if(cend(stripe.bookings) == it)
+      return 0U;
+    return it->second.persons;
+  }
+
+  unsigned BookingSystem::availableSeats(const Leg &leg) const {
+    const unsigned total = capacity(leg), taken = inventory.occupied(leg);
+    return (taken < total) ? (total - taken) : 0U;
+  }
+
+  shared_ptr<const IOccupancyView> BookingSystem::occupancyView() const {
+    return inventory.view();
+  }
+
+  TravelConditionsById BookingSystem::bookedTravelConditions() const {
+    TravelConditionsById result;
+    for(const BookedLegsStripe &stripe : bookedLegsStripes) {
+      lock_guard<mutex> lock(stripe.guard);
+      for(const auto &raIdAndDates : stripe.bookingsByLeg)
+        result.emplace(raIdAndDates.first,
+                       travelConditions(
+                         infoSrc.routeAlternative(raIdAndDates.first)));
+    }
+    return result;
+  }
+
+  set<unsigned>
+      BookingSystem::affectedBookings(const TravelConditionsById &before) const {
+    set<unsigned> result;
+    for(const auto &raIdAndConditions : before) {
+      const unsigned raId = raIdAndConditions.first;
+      const TravelConditions &prev = raIdAndConditions.second;
+
+      const IRouteAlternative *ra = nullptr;
+      try {
+        ra = &infoSrc.routeAlternative(raId);
+      } catch(domain_error&) {} // removed route alternative
+
+      bool allDates = (nullptr == ra);
+      if(!allDates) {
+        const TravelConditions now = travelConditions(*ra);
+        if(now.timetable == prev.timetable && now.calendar == prev.calendar)
+          continue;
+        allDates = (now.timetable != prev.timetable);
+      }
+
+      const BookedLegsStripe &stripe = legsStripeFor(raId);
+      lock_guard<mutex> lock(stripe.guard);
+      const auto it = stripe.bookingsByLeg.find(raId);
+      if(cend(stripe.bookingsByLeg) == it)
+        continue;
+
+      for(const auto &dateAndIds : it->second)
+        if(allDates || !operatesOn(*ra, dateAndIds.first))
+          result.insert(CBOUNDS(dateAndIds.second));
+    }
+    return result;
+  }
+
+  const SeatInventory& BookingSystem::seatInventory() const {
+    return inventory;
+  }
+
+}} // namespace tp::bookings
@@ -0,0 +1,206 @@
+/*****************************************************************************
+ TripPlanner explores various issues common to navigation and booking systems.
+
+ Copyrights from the libraries used by the program:
+ - (c) 2017 Boost (www.boost.org)
+		License: <http://www.boost.org/LICENSE_1_0.txt>
+ 
+ (c) 2017 Florin Tulba <florintulba@yahoo.com>
+
+ This program is free software: you can use its results,
+ redistribute it and/or modify it under the terms of the GNU
+ Affero General Public License version 3 as published by the
+ Free Software Foundation.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU Affero General Public License for more details.
+
+ You should have received a copy of the GNU Affero General Public License
+ along with this program ('agpl-3.0.txt').
+ If not, see <http://www.gnu.org/licenses/agpl-3.0.txt>.
+ *****************************************************************************/
+
+#ifndef H_BOOKING_SYSTEM
+#define H_BOOKING_SYSTEM
+
+#include "bookingBase.h"
+#include "seatInventory.h"
+#include "bookingJournal.h"
+#include "infoSource.h"
+
+#pragma warning ( push, 0 )
+
+#include <map>
+#include <mutex>
+#include <memory>
+
+#pragma warning ( pop )
+
+// namespace trip planner - bookings
+namespace tp { namespace bookings {
+
+  /**
+  Realization of IBookingSystem.
+
+  There is no global lock. A multi-leg booking tries to occupy the seats
+  of each leg in turn (see SeatInventory::tryOccupy) and when one of them
+  lacks enough free seats, it releases the seats occupied for the previous legs.
+  The bookings themselves are kept in several independently locked stripes.
+  Other stripes index the active bookings by the route alternatives and
+  the dates of their legs, so the bookings affected by changed specifications
+  are found without scanning all of them.
+
+  When provided with a journal, the bookings recovered from it occupy
+  their seats again and every booking / cancellation returns only after
+  being recorded durably by the journal.
+  */
+  class BookingSystem : public IBookingSystem {
+  protected:
+    /// Details about a successful booking
+    struct Booking {
+      std::vector<Leg> legs;  ///< the legs of the trip
+      unsigned persons;       ///< persons still covered by the booking
+      unsigned cancelling = 0U; ///< cancellations waiting for the journal
+    };
+
+    /// Count of the independently locked parts of the bookings
+    static constexpr size_t StripesCount = 64ULL;
+
+    /// Part of the bookings guarded by its own lock
+    struct BookingsStripe {
+      mutable std::mutex guard;  ///< protects bookings
+      std::unordered_map<unsigned, Booking> bookings; ///< bookings by their id
+    };
+
+    /// Active bookings by the route alternatives and the dates of their legs
+    typedef std::unordered_map<unsigned,
+                               std::map<boost::gregorian::date, std::set<unsigned>>>
+      BookingsByLeg;
+
+    /// Part of the bookings index guarded by its own lock
+    struct BookedLegsStripe {
+      mutable std::mutex guard;  ///< protects bookingsByLeg
+      BookingsByLeg bookingsByLeg; ///< ids of the bookings for each (raId, date)
+    };
+
+    /// Provides the capacities and the calendars of the route alternatives
+    const specs::InfoSource &infoSrc;
+
+    SeatInventory inventory; ///< occupied seats for every (raId, date)
+
+    /// Optional durable log of the bookings and cancellations
+    const std::unique_ptr<BookingJournal> journal;
+
+    /// The parts of the bookings
+    std::array<BookingsStripe, StripesCount> bookingsStripes;
+
+    /// The parts of the index of the bookings by their legs
+    std::array<BookedLegsStripe, StripesCount> bookedLegsStripes;
+
+    std::atomic<unsigned> nextBookingId; ///< the id for the next booking
+
+    /**
+    @return the capacity of the class chosen by leg or 0 when
+      the route alternative doesn't operate on leg.date
+    @throw domain_error for unknown route alternatives
+    */
+    unsigned capacity(const Leg &leg) const;
+
+    /// @return the stripe responsible for bookingId
+    BookingsStripe& stripeFor(unsigned bookingId);
+
+    /// @return the stripe responsible for bookingId
+    const BookingsStripe& stripeFor(unsigned bookingId) const;
+
+    /// @return the index stripe responsible for the route alternative raId
+    BookedLegsStripe& legsStripeFor(unsigned raId);
+
+    /// @return the index stripe responsible for the route alternative raId
+    const BookedLegsStripe& legsStripeFor(unsigned raId) const;
+
+    /// Adds bookingId to the index entries of its legs
+    void indexBooking(unsigned bookingId, const std::vector<Leg> &legs);
+
+    /// Removes bookingId from the index entries of its legs
+    void unindexBooking(unsigned bookingId, const std::vector<Leg> &legs);
+
+  public:
+    /**
+    Uses infoSrc_ to find the capacities and the calendars of the route alternatives.
+    When journal_ isn't nullptr, the bookings recovered by it get restored
+    and any later changes get recorded there.
+    */
+    BookingSystem(const specs::InfoSource &infoSrc_,
+                  std::unique_ptr<BookingJournal> journal_ = nullptr);
+
+    BookingSystem(const BookingSystem&) = delete;
+    BookingSystem(BookingSystem&&) = delete;
+    void operator=(const BookingSystem&) = delete;
+    void operator=(BookingSystem&&) = delete;
+
+    /**
+    Attempts to reserve seats for `persons` on every leg from `legs`.
+
+    @param legs the legs of the trip
+    @param persons how many persons travel together
+    @param bookingId receives the id of the new booking when successful
+    @param maxPersons receives the largest number of persons
+      that could have booked these legs during the attempt
+      (relevant when the booking fails)
+
+    @return true if all legs were reserved; false if there were not enough seats
+
+    @throw invalid_argument for empty legs, 0 persons or
+      legs whose route alternative doesn't operate on the given date
+    @throw domain_error for unknown route alternatives
+    @throw runtime_error when the journal couldn't record the booking
+    */
+    bool book(const std::vector<Leg> &legs, unsigned persons,
+              unsigned &bookingId, unsigned &maxPersons) override;
+
+    /**
+    Cancels the tickets of `persons` from the booking with bookingId.
+    When all the persons get cancelled, the booking is forgotten.
+
+    @throw invalid_argument for unknown bookingId,
+      or when persons is 0 or larger than the still booked persons
+    @throw runtime_error when the journal couldn't record the cancellation
+    */
+    void cancel(unsigned bookingId, unsigned persons) override;
+
+    /// @return the number of persons still covered by the booking with bookingId
+    /// or 0 for unknown / entirely cancelled bookings
+    unsigned bookedPersons(unsigned bookingId) const override;
+
+    /// @return the free seats of the class chosen by leg
+    /// @throw domain_error for unknown route alternatives
+    unsigned availableSeats(const Leg &leg) const override;
+
+    /// @return the occupancy for every (raId, date) covering at least
+    /// the bookings / cancellations completed before this call
+    std::shared_ptr<const IOccupancyView> occupancyView() const override;
+
+    /// @return the travel conditions of the route alternatives with active bookings.
+    /// Meant to be called before reloading the specifications
+    TravelConditionsById bookedTravelConditions() const override;
+
+    /**
+    Finds the bookings affected by the changes from the specifications.
+    Only the route alternatives from `before` whose fingerprints differ now
+    are inspected, using the index of the bookings by their legs.
+
+    @param before the result of bookedTravelConditions() prior to the reload
+    @return the ids of the affected active bookings
+    */
+    std::set<unsigned>
+      affectedBookings(const TravelConditionsById &before) const override;
+
+    /// @return the occupied seats for every (raId, date)
+    const SeatInventory& seatInventory() const;
+  };
+
+}} // namespace tp::bookings
+
+#endif // H_BOOKING_SYSTEM
@@ -0,0 +1,95 @@
+/*****************************************************************************
+ TripPlanner explores various issues common to navigation and booking systems.
+
+ Copyrights from the libraries used by the program:
+ - (c) 2017 Boost (www.boost.org)
+		License: <http://www.boost.org/LICENSE_1_0.txt>
+ 
+ (c) 2017 Florin Tulba <florintulba@yahoo.com>
+
+ This program is free software: you can use its results,
+ redistribute it and/or modify it under the terms of the GNU
+ Affero General Public License version 3 as published by the
+ Free Software Foundation.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU Affero General Public License for more details.
+
+ You should have received a copy of the GNU Affero General Public License
+ along with this program ('agpl-3.0.txt').
+ If not, see <http://www.gnu.org/licenses/agpl-3.0.txt>.
+ *****************************************************************************/
+
+#include "boundedExecutor.h"
+
+#pragma warning ( push, 0 )
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+#pragma warning ( pop )
+
+using namespace std;
+
+namespace tp { // trip planner
+
+  BoundedExecutor::BoundedExecutor(unsigned threads, size_t maxQueued_) :
+      maxQueued(maxQueued_) {
+    if(maxQueued == 0ULL)
+      throw invalid_argument(string(__func__) + " expects maxQueued_ > 0!");
+
+    if(threads == 0U)
+      threads = max(thread::hardware_concurrency(), 1U);
+    for(unsigned i = 0U; i < threads; ++i)
+      workers.emplace_back(&BoundedExecutor::work, this);
+  }
+
+  BoundedExecutor::~BoundedExecutor() {
+    {
+      lock_guard<mutex> lock(guard);
+      stopping = true;
+    }
+    available.notify_all();
+    for(thread &worker : workers)
+      worker.join();
+  }
+
+  bool BoundedExecutor::trySubmit(function<void()> job) {
+    {
+      lock_guard<mutex> lock(guard);
+      if(stopping || jobs.size() >= maxQueued)
+        return false;
+      jobs.push_back(move(job));
+    }
+    available.notify_one();
+    return true;
+  }
+
+  size_t BoundedExecutor::queued() const {
+    lock_guard<mutex> lock(guard);
+    return jobs.size();
+  }
+
+  void BoundedExecutor::work() {
+    for(;;) {
+      function<void()> job;
+      {
+        unique_lock<mutex> lock(guard);
+        available.wait(lock, [this] { return stopping || !jobs.empty(); });
+        if(jobs.empty())
+          return; // stopping and nothing left to run
+
+        job = move(jobs.front());
+        jobs.pop_front();
+      }
+
+      try {
+        job();
+      } catch(...) {} // the jobs report their own failures
+    }
+  }
+
+} // namespace tp
@@ -0,0 +1,95 @@
+/*****************************************************************************
+ TripPlanner explores various issues common to navigation and booking systems.
+
+ Copyrights from the libraries used by the program:
+ - (c) 2017 Boost (www.boost.org)
+		License: <http://www.boost.org/LICENSE_1_0.txt>
+ 
+ (c) 2017 Florin Tulba <florintulba@yahoo.com>
+
+ This program is free software: you can use its results,
+ redistribute it and/or modify it under the terms of the GNU
+ Affero General Public License version 3 as published by the
+ Free Software Foundation.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU Affero General Public License for more details.
+
+ You should have received a copy of the GNU Affero General Public License
+ along with this program ('agpl-3.0.txt').
+ If not, see <http://www.gnu.org/licenses/agpl-3.0.txt>.
+ *****************************************************************************/
+
+#ifndef H_BOUNDED_EXECUTOR
+#define H_BOUNDED_EXECUTOR
+
+#pragma warning ( push, 0 )
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#pragma warning ( pop )
+
+namespace tp { // trip planner
+
+  /**
+  Runs jobs on a fixed set of threads, in the order they were submitted.
+
+  At most maxQueued jobs wait for a free thread. Further submissions
+  are rejected at once, instead of letting the backlog and the latency grow,
+  so the callers can report the overload early.
+  */
+  class BoundedExecutor {
+  protected:
+    const size_t maxQueued; ///< largest count of waiting jobs
+
+    mutable std::mutex guard;           ///< protects jobs and stopping
+    std::condition_variable available;  ///< notifies the workers about new jobs
+    std::deque<std::function<void()>> jobs; ///< the waiting jobs
+    bool stopping = false;              ///< set by the destructor
+
+    std::vector<std::thread> workers;   ///< the threads running the jobs
+
+    /// The loop of each worker
+    void work();
+
+  public:
+    /**
+    Starts the workers.
+
+    @param threads count of workers; 0 for a worker for every core
+    @param maxQueued_ largest count of jobs waiting for a free worker
+
+    @throw invalid_argument for maxQueued_ equal to 0
+    */
+    BoundedExecutor(unsigned threads, size_t maxQueued_);
+
+    BoundedExecutor(const BoundedExecutor&) = delete;
+    BoundedExecutor(BoundedExecutor&&) = delete;
+    void operator=(const BoundedExecutor&) = delete;
+    void operator=(BoundedExecutor&&) = delete;
+
+    /// Runs the waiting jobs and then stops the workers
+    ~BoundedExecutor();
+
+    /**
+    Enqueues job unless maxQueued jobs are already waiting.
+    The job should handle its exceptions; the escaping ones are ignored.
+
+    @return false if the job was rejected
+    */
+    bool trySubmit(std::function<void()> job);
+
+    /// @return the count of jobs waiting for a free worker
+    size_t queued() const;
+  };
+
+} // namespace tp
+
+#endif // H_BOUNDED_EXECUTOR
@@ -50,7 +50,8 @@ namespace tp { namespace queries {
     if(_from == _to || _interval.is_null() ||
        price_ <= 0.f || dist <= 0.f ||
        (transpModes_ != TranspModes::AIR && transpModes_ != TranspModes::RAIL &&
-        transpModes_ != TranspModes::ROAD && transpModes_ != TranspModes::WATER))
+        transpModes_ != TranspModes::ROAD && transpModes_ != TranspModes::WATER &&
+        transpModes_ != TranspModes::FOOT))
 		  throw invalid_argument(string(__func__) +
                              " expects strictly positive price_ and dist,"
                              " transpModes_ among the enum from TranspModes,"
@@ -23,9 +23,12 @@
  *****************************************************************************/
 
 #include "constraints.h"
+#include "util.h"
 
 #pragma warning ( push, 0 )
 
+#include <algorithm>
+#include <iterator>
 #include <cassert>
 #include <stdexcept>
 
@@ -34,6 +37,14 @@
 using namespace std;
 using namespace boost::posix_time;
 
+namespace {
+  /// Sorts ids and removes their duplicates
+  void normalize(vector<unsigned> &ids) {
+    sort(BOUNDS(ids));
+    ids.erase(unique(BOUNDS(ids)), end(ids));
+  }
+} // anonymous namespace
+
 // namespace trip planner - queries
 namespace tp { namespace queries {
 
@@ -64,4 +75,77 @@ namespace tp { namespace queries {
 	  return _arrivePeriod;
   }
 
+  SeatsConstraints::SeatsConstraints(unsigned persons_/* = 1U*/,
+                                     bool economyClass_/* = true*/) :
+      _persons(persons_), _economyClass(economyClass_) {
+    if(_persons == 0U)
+      throw invalid_argument(string(__func__) + " expects persons_ > 0!");
+  }
+
+  unsigned SeatsConstraints::persons() const {
+    return _persons;
+  }
+
+  bool SeatsConstraints::economyClass() const {
+    return _economyClass;
+  }
+
+  constexpr size_t IPlaceConstraints::MaxViaPlaces;
+
+  PlaceConstraints::PlaceConstraints(vector<unsigned> viaPlaces_/* = {}*/,
+                                     vector<unsigned> avoidedPlaces_/* = {}*/,
+                                     vector<unsigned> avoidedRoutes_/* = {}*/) :
+      _viaPlaces(move(viaPlaces_)), _avoidedPlaces(move(avoidedPlaces_)),
+      _avoidedRoutes(move(avoidedRoutes_)) {
+    normalize(_viaPlaces);
+    normalize(_avoidedPlaces);
+    normalize(_avoidedRoutes);
+
+    if(_viaPlaces.size() > MaxViaPlaces)
+      throw invalid_argument(string(__func__) + " accepts at most " +
+                             to_string(MaxViaPlaces) + " via places!");
+
+    vector<unsigned> common;
+    set_intersection(BOUNDS(_viaPlaces), BOUNDS(_avoidedPlaces),
+                     back_inserter(common));
+    if(!common.empty())
+      throw invalid_argument(string(__func__) + " cannot both pass through "
+                             "and avoid the same place!");
+  }
+
+  const vector<unsigned>& PlaceConstraints::viaPlaces() const {
+    return _viaPlaces;
+  }
+
+  const vector<unsigned>& PlaceConstraints::avoidedPlaces() const {
+    return _avoidedPlaces;
+  }
+
+  const vector<unsigned>& PlaceConstraints::avoidedRoutes() const {
+    return _avoidedRoutes;
+  }
+
+  void CancellationToken::cancel() {
+    _cancelled = true;
+  }
+
+  bool CancellationToken::cancelled() const {
+    return _cancelled;
+  }
+
+  SearchLimits::SearchLimits(chrono::steady_clock::duration timeout
+                               /* = chrono::steady_clock::duration::max()*/,
+                             const CancellationToken *token_/* = nullptr*/) :
+      _token(token_) {
+    // Avoids overflowing the time point for large timeouts
+    const chrono::steady_clock::time_point now = chrono::steady_clock::now();
+    _deadline = (timeout >= chrono::steady_clock::time_point::max() - now) ?
+      chrono::steady_clock::time_point::max() : now + timeout;
+  }
+
+  bool SearchLimits::exceeded() const {
+    return (nullptr != _token && _token->cancelled()) ||
+      chrono::steady_clock::now() >= _deadline;
+  }
+
 }} // namespace tp::queries
@@ -30,6 +30,9 @@
 
 #pragma warning ( push, 0 )
 
+#include <atomic>
+#include <chrono>
+
 #include <boost/date_time/posix_time/posix_time_types.hpp>
 
 #pragma warning ( pop )
@@ -67,6 +70,90 @@ namespace tp { namespace queries {
 	  const boost::posix_time::time_period& arrivePeriod() const override;
   };
 
+  /// Realization of ISeatsConstraints
+  class SeatsConstraints : public ISeatsConstraints {
+  protected:
+    unsigned _persons;    ///< how many persons travel together
+    bool _economyClass;   ///< true for economy class; false for business class
+
+  public:
+    /// Throws invalid_argument for 0 persons_
+    SeatsConstraints(unsigned persons_ = 1U, bool economyClass_ = true);
+
+    /// How many persons travel together
+    unsigned persons() const override;
+
+    /// true for economy class; false for business class
+    bool economyClass() const override;
+  };
+
+  /// Realization of IPlaceConstraints
+  class PlaceConstraints : public IPlaceConstraints {
+  protected:
+    std::vector<unsigned> _viaPlaces;     ///< sorted ids of the places to pass through
+    std::vector<unsigned> _avoidedPlaces; ///< sorted ids of the places to avoid
+    std::vector<unsigned> _avoidedRoutes; ///< sorted ids of the routes to avoid
+
+  public:
+    /**
+    Sorts the provided ids and removes their duplicates.
+
+    @throw invalid_argument when there are more than MaxViaPlaces via places
+      or some place should be both passed through and avoided
+    */
+    PlaceConstraints(std::vector<unsigned> viaPlaces_ = {},
+                     std::vector<unsigned> avoidedPlaces_ = {},
+                     std::vector<unsigned> avoidedRoutes_ = {});
+
+    /// Sorted ids of the places to pass through, in any order
+    const std::vector<unsigned>& viaPlaces() const override;
+
+    /// Sorted ids of the places to avoid
+    const std::vector<unsigned>& avoidedPlaces() const override;
+
+    /// Sorted ids of the routes to avoid
+    const std::vector<unsigned>& avoidedRoutes() const override;
+  };
+
+  /// Lets a client abort its searches, for instance after disconnecting
+  class CancellationToken {
+  protected:
+    std::atomic<bool> _cancelled { false }; ///< set by cancel
+
+  public:
+    CancellationToken() = default;
+    CancellationToken(const CancellationToken&) = delete;
+    CancellationToken(CancellationToken&&) = delete;
+    void operator=(const CancellationToken&) = delete;
+    void operator=(CancellationToken&&) = delete;
+
+    /// Asks the searches using this token to stop. Thread-safe
+    void cancel();
+
+    /// @return true after cancel was called. Thread-safe
+    bool cancelled() const;
+  };
+
+  /// Realization of ISearchLimits with an optional deadline and an optional cancellation token
+  class SearchLimits : public ISearchLimits {
+  protected:
+    std::chrono::steady_clock::time_point _deadline; ///< when the searches should stop
+    const CancellationToken *_token; ///< optional token for stopping the searches
+
+  public:
+    /**
+    @param timeout how long a search may run
+    @param token_ when not nullptr, it might stop the searches before the deadline.
+      It must outlive the searches
+    */
+    SearchLimits(std::chrono::steady_clock::duration timeout =
+                   std::chrono::steady_clock::duration::max(),
+                 const CancellationToken *token_ = nullptr);
+
+    /// @return true after the deadline or after cancelling the token
+    bool exceeded() const override;
+  };
+
 }} // namespace tp::queries
 
 #endif // H_CONSTRAINTS
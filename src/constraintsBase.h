@@ -29,6 +29,8 @@
 #pragma clang diagnostic push
 #pragma clang diagnostic ignored "-Wignored-attributes"
 
+#include <vector>
+
 #include <boost/date_time/posix_time/time_period.hpp>
 
 #pragma clang diagnostic pop
@@ -48,6 +50,47 @@ namespace tp { namespace queries {
 	  virtual const boost::posix_time::time_period& arrivePeriod() const = 0;
   };
 
+  /// Provides the party size and the seat class for availability-aware searches
+  struct ISeatsConstraints /*abstract*/ {
+    virtual ~ISeatsConstraints() /*= 0*/ {}
+
+    /// How many persons travel together
+    virtual unsigned persons() const = 0;
+
+    /// true for economy class; false for business class
+    virtual bool economyClass() const = 0;
+  };
+
+  /// Provides the places a trip must pass through and the places and routes it must avoid
+  struct IPlaceConstraints /*abstract*/ {
+    /// Largest count of distinct via places accepted by the searches
+    static constexpr size_t MaxViaPlaces = 4ULL;
+
+    virtual ~IPlaceConstraints() /*= 0*/ {}
+
+    /// Sorted ids of the places to pass through, in any order.
+    /// Passing through a place includes the intermediary stops of a ride.
+    /// The searches ignore duplicates and throw invalid_argument
+    /// for more than MaxViaPlaces distinct ids
+    virtual const std::vector<unsigned>& viaPlaces() const = 0;
+
+    /// Sorted ids of the places where the trip must not stop, not even
+    /// as intermediary stops of a ride
+    virtual const std::vector<unsigned>& avoidedPlaces() const = 0;
+
+    /// Sorted ids of the routes (see IRouteSharedInfo) not to be used
+    virtual const std::vector<unsigned>& avoidedRoutes() const = 0;
+  };
+
+  /// Tells when a running search should stop, returning the variants found so far
+  struct ISearchLimits /*abstract*/ {
+    virtual ~ISearchLimits() /*= 0*/ {}
+
+    /// @return true after the deadline or after a cancellation.
+    /// Called from the threads performing the search
+    virtual bool exceeded() const = 0;
+  };
+
 }} // namespace tp::queries
 
 #endif // H_CONSTRAINTS_BASE
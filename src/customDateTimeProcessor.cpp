@@ -28,8 +28,11 @@
 #pragma warning ( push, 0 )
 
 #include <sstream>
-#include <iomanip>
+#include <cstring>
+#include <cstdint>
 #include <cassert>
+#include <climits>
+#include <chrono>
 
 #include <boost/date_time/posix_time/posix_time_types.hpp>
 #include <boost/date_time/gregorian/parsers.hpp>
@@ -40,64 +43,184 @@ using namespace std;
 using namespace boost::posix_time;
 using namespace boost::gregorian;
 
+namespace {
+  /// Writes the decimal digits of v at pos and returns the position after them
+  char* writeDigits(char *pos, uint64_t v) {
+    char digits[20];
+    size_t count = 0ULL;
+    do {
+      digits[count++] = char('0' + v % 10ULL);
+      v /= 10ULL;
+    } while(v > 0ULL);
+
+    while(count > 0ULL)
+      *pos++ = digits[--count];
+    return pos;
+  }
+
+  /// Writes v < 100 as 2 digits at pos and returns the position after them
+  char* write2Digits(char *pos, unsigned v) {
+    assert(v < 100U);
+    pos[0] = char('0' + v / 10U);
+    pos[1] = char('0' + v % 10U);
+    return pos + 2;
+  }
+
+  /// Writes the null-terminated text at pos and returns the position after it
+  char* writeText(char *pos, const char *text) {
+    const size_t len = strlen(text);
+    memcpy(pos, text, len);
+    return pos + len;
+  }
+
+  /// The reference moment for the cached clock
+  const ptime Epoch(date(1970, Jan, 1));
+
+  /// Seconds since Epoch from the last read of the system clock
+  atomic<long long> cachedSeconds(0LL);
+
+  /// Nanoseconds of the monotonic clock at the last read of the system clock
+  atomic<long long> cachedAt(LLONG_MIN);
+
+  /// @return the seconds since Epoch, reading the system clock
+  /// only when the cached value is at least a second old
+  long long cachedSecondsSinceEpoch() {
+    static const long long NanosPerSecond = 1'000'000'000LL;
+    const long long steadyNow = (long long)chrono::duration_cast<chrono::nanoseconds>(
+      chrono::steady_clock::now().time_since_epoch()).count();
+    const long long lastRead = cachedAt.load(memory_order_acquire);
+    if(lastRead != LLONG_MIN && steadyNow - lastRead < NanosPerSecond)
+      return cachedSeconds.load(memory_order_relaxed);
+
+    const long long result =
+      (long long)(second_clock::universal_time() - Epoch).total_seconds();
+    cachedSeconds.store(result, memory_order_relaxed);
+    cachedAt.store(steadyNow, memory_order_release);
+    return result;
+  }
+} // anonymous namespace
+
 // namespace trip planner - various
 namespace tp { inline namespace var {
 
 #if (defined(_MSC_VER) || defined(__clang__)) && !defined(__GNUC__)
   template vector<ptime>; // forced template instantiation
 #endif // (_MSC_VER || __clang__) && !__GNUC__
-  vector<ptime> nowReplacements;
+  NowReplacements nowReplacements;
+
+  void NowReplacements::resize(size_t newSize, const ptime &value) {
+    lock_guard<mutex> lock(guard);
+    values.resize(newSize, value);
+    count = values.size();
+  }
+
+  void NowReplacements::push_back(const ptime &value) {
+    lock_guard<mutex> lock(guard);
+    values.push_back(value);
+    count = values.size();
+  }
+
+  void NowReplacements::clear() {
+    lock_guard<mutex> lock(guard);
+    values.clear();
+    count = 0ULL;
+  }
+
+  size_t NowReplacements::size() const {
+    return count;
+  }
+
+  bool NowReplacements::empty() const {
+    return count == 0ULL;
+  }
+
+  bool NowReplacements::takeBack(ptime &value) {
+    lock_guard<mutex> lock(guard);
+    if(values.empty())
+      return false;
+
+    value = values.back();
+    values.pop_back();
+    count = values.size();
+    return true;
+  }
 
   ptime nowUTC() {
-    while(!nowReplacements.empty()) {
-      ptime result = nowReplacements.back();
-      nowReplacements.pop_back();
+    ptime result;
+    if(!nowReplacements.empty() && nowReplacements.takeBack(result))
       return result; // leaves the rest for next calls to nowUTC()
-    }
 
     // If nowReplacements was/gets empty, return the actual current moment
-    return second_clock::universal_time();
+    return Epoch + seconds(long(cachedSecondsSinceEpoch()));
   }
 
-  string formatTimePoint(const ptime &mom) {
-    const auto timePart = mom.time_of_day();
-    const auto datePart = mom.date();
-    const auto ymd = datePart.year_month_day();
-    ostringstream oss;
-    oss<<datePart.day_of_week().as_short_string()<<' '
-      <<ymd.month.as_short_string()<<'-'
-      <<ymd.day<<'-'
-      <<ymd.year<<' '
-      <<setw(2)<<setfill('0')<<timePart.hours()<<':'
-      <<setw(2)<<setfill('0')<<timePart.minutes();
-    return oss.str();
+  long long nowUTCMinutes() {
+    return (long long)(nowUTC() - Epoch).total_seconds() / 60LL;
   }
 
-  string formatDuration(const time_duration& dur) {
-    const auto asHours = dur.hours();
-    const div_t days_hours = div(asHours, 24);
-    const auto mins = dur.minutes();
+  size_t formatTimePoint(const ptime &mom,
+                         char (&buffer)[TimePointBufferSize]) {
+    static const char dayNames[7][4] {
+      "Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat"
+    };
+    static const char monthNames[12][4] {
+      "Jan", "Feb", "Mar", "Apr", "May", "Jun",
+      "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"
+    };
 
-    ostringstream oss;
-    bool daysPartPresent = false;
-    if(days_hours.quot > 0) {
-      daysPartPresent = true;
-      oss<<days_hours.quot<<" day";
-      if(days_hours.quot > 1)
-        oss<<'s';
-      oss<<", ";
+    assert(!mom.is_special());
+    const time_duration timePart = mom.time_of_day();
+    const date datePart = mom.date();
+    const greg_year_month_day ymd = datePart.year_month_day();
+
+    char *pos = buffer;
+    memcpy(pos, dayNames[datePart.day_of_week().as_number()], 3ULL);
+    pos[3] = ' ';
+    memcpy(pos + 4, monthNames[ymd.month.as_number() - 1], 3ULL);
+    pos[7] = '-';
+    pos = writeDigits(pos + 8, ymd.day);
+    *pos++ = '-';
+    pos = writeDigits(pos, ymd.year);
+    *pos++ = ' ';
+    pos = write2Digits(pos, unsigned(timePart.hours()));
+    *pos++ = ':';
+    pos = write2Digits(pos, unsigned(timePart.minutes()));
+    *pos = '\0';
+    return size_t(pos - buffer);
+  }
+
+  size_t formatDuration(const time_duration &dur,
+                        char (&buffer)[DurationBufferSize]) {
+    const time_duration absDur = dur.is_negative() ? dur.invert_sign() : dur;
+    const uint64_t asHours = uint64_t(absDur.hours()),
+      days = asHours / 24ULL, hoursLeft = asHours % 24ULL;
+    const unsigned mins = unsigned(absDur.minutes());
+
+    char *pos = buffer;
+    if(dur.is_negative())
+      *pos++ = '-';
+    if(days > 0ULL) {
+      pos = writeDigits(pos, days);
+      pos = writeText(pos, (days > 1ULL) ? " days, " : " day, ");
     }
-    if(days_hours.rem > 0 || daysPartPresent) {
-      oss<<days_hours.rem<<" hour";
-      if(days_hours.rem != 1)
-        oss<<'s';
-      oss<<" and ";
+    if(hoursLeft > 0ULL || days > 0ULL) {
+      pos = writeDigits(pos, hoursLeft);
+      pos = writeText(pos, (hoursLeft != 1ULL) ? " hours and " : " hour and ");
     }
-    oss<<mins<<" minute";
-    if(mins != 1)
-      oss<<'s';
+    pos = writeDigits(pos, mins);
+    pos = writeText(pos, (mins != 1U) ? " minutes" : " minute");
+    *pos = '\0';
+    return size_t(pos - buffer);
+  }
 
-    return oss.str();
+  string formatTimePoint(const ptime &mom) {
+    char buffer[TimePointBufferSize];
+    return string(buffer, formatTimePoint(mom, buffer));
+  }
+
+  string formatDuration(const time_duration& dur) {
+    char buffer[DurationBufferSize];
+    return string(buffer, formatDuration(dur, buffer));
   }
 
   void updateUnavailDaysForTheYearAhead(const string &udyaStr,
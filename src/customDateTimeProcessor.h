@@ -30,6 +30,8 @@
 #include <string>
 #include <vector>
 #include <set>
+#include <mutex>
+#include <atomic>
 
 #pragma clang diagnostic push
 #pragma clang diagnostic ignored "-Wignored-attributes"
@@ -52,23 +54,69 @@ namespace tp { inline namespace var {
   to investigate or check the behavior of the system.
 
   This mechanism allows going into the past / future, particularly in Unit tests.
+
+  The system clock is read at most once per second (judged by a cheap
+  monotonic clock read); the calls in between reuse the cached moment.
+  This matches the resolution of the reported moments, which is a second.
   */
   boost::posix_time::ptime nowUTC();
 
+  /// @return the minutes since 1970-Jan-1 00:00 UTC of the moment from nowUTC()
+  long long nowUTCMinutes();
+
 #if (defined(_MSC_VER) || defined(__clang__)) && !defined(__GNUC__)
   // Let just 1 unit instantiate this template used below
   extern template std::vector<boost::posix_time::ptime>;
 #endif // (_MSC_VER || __clang__) && !__GNUC__
 
   /**
-  Allows using the values from this container
+  Thread-safe container of the moments nowUTC reports
   instead of actually reading the current moment.
 
-  The values to be reported are always read from the back of the vector.
-  Between consecutive read operations, the vector can be updated
-  dynamically in any way.
+  The values to be reported are always read from the back of the container.
+  Between consecutive read operations, the container can be updated
+  dynamically in any way, even from other threads.
+  nowUTC avoids locking while the container is empty.
   */
-  extern std::vector<boost::posix_time::ptime> nowReplacements;
+  class NowReplacements {
+  protected:
+    mutable std::mutex guard; ///< protects values
+    std::vector<boost::posix_time::ptime> values; ///< the replacements
+    std::atomic<size_t> count; ///< values.size(), readable without locking
+
+  public:
+    NowReplacements() : count(0ULL) {}
+    NowReplacements(const NowReplacements&) = delete;
+    NowReplacements(NowReplacements&&) = delete;
+    void operator=(const NowReplacements&) = delete;
+    void operator=(NowReplacements&&) = delete;
+
+    /// Keeps the first newSize values, appending copies of value if necessary
+    void resize(size_t newSize, const boost::posix_time::ptime &value);
+
+    /// Appends value to be reported before all the others
+    void push_back(const boost::posix_time::ptime &value);
+
+    /// Removes all the replacements
+    void clear();
+
+    /// @return the count of replacements
+    size_t size() const;
+
+    /// @return true when there are no replacements
+    bool empty() const;
+
+    /**
+    Removes the last replacement.
+
+    @param value receives the removed replacement
+    @return false when there were no replacements
+    */
+    bool takeBack(boost::posix_time::ptime &value);
+  };
+
+  /// The moments to be reported by nowUTC instead of the actual current moment
+  extern NowReplacements nowReplacements;
 
   /// Converting a moment object to string: "shortDayName shortMonthName-day-year hours:minutes"
   std::string formatTimePoint(const boost::posix_time::ptime &mom);
@@ -76,6 +124,32 @@ namespace tp { inline namespace var {
   /// Converting a duration object to string: [[DDD day[s], ]H hour[s] and ]M minute[s]
   std::string formatDuration(const boost::posix_time::time_duration &dur);
 
+  /// Room for the longest text from formatTimePoint, like "Wed Sep-30-9999 23:59",
+  /// plus the terminating null
+  constexpr size_t TimePointBufferSize = 24ULL;
+
+  /// Room for the longest text from formatDuration, plus the terminating null
+  constexpr size_t DurationBufferSize = 64ULL;
+
+  /**
+  Writes the same text as formatTimePoint(mom) into buffer, followed by a null,
+  without streams, locale or allocations.
+
+  @return the count of written characters, excluding the terminating null
+  */
+  size_t formatTimePoint(const boost::posix_time::ptime &mom,
+                         char (&buffer)[TimePointBufferSize]);
+
+  /**
+  Writes the same text as formatDuration(dur) into buffer, followed by a null,
+  without streams, locale or allocations.
+  Negative durations get a leading '-'.
+
+  @return the count of written characters, excluding the terminating null
+  */
+  size_t formatDuration(const boost::posix_time::time_duration &dur,
+                        char (&buffer)[DurationBufferSize]);
+
   /**
   Replacing the content of udyaSet with the dates from udyaStr.
   The dates are delimited by '|' among 0 or more space-like symbols.
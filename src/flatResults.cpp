@@ -0,0 +1,383 @@
+/*****************************************************************************
+ TripPlanner explores various issues common to navigation and booking systems.
+
+ Copyrights from the libraries used by the program:
+ - (c) 2017 Boost (www.boost.org)
+		License: <http://www.boost.org/LICENSE_1_0.txt>
+ 
+ (c) 2017 Florin Tulba <florintulba@yahoo.com>
+
+ This program is free software: you can use its results,
+ redistribute it and/or modify it under the terms of the GNU
+ Affero General Public License version 3 as published by the
+ Free Software Foundation.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU Affero General Public License for more details.
+
+ You should have received a copy of the GNU Affero General Public License
+ along with this program ('agpl-3.0.txt').
+ If not, see <http://www.gnu.org/licenses/agpl-3.0.txt>.
+ *****************************************************************************/
+
+#include "flatResults.h"
+#include "util.h"
+
+#pragma warning ( push, 0 )
+
+#include <algorithm>
+#include <stdexcept>
+#include <cstring>
+#include <cassert>
+
+#pragma warning ( pop )
+
+using namespace std;
+using namespace boost::posix_time;
+
+namespace {
+  /// Accumulates v into the hash h
+  uint64_t mix(uint64_t h, uint64_t v) {
+    h = (h ^ v) * 0x9E3779B97F4A7C15ULL;
+    return h ^ (h >> 29);
+  }
+
+  /// Accumulates moment t into the hash h
+  uint64_t mix(uint64_t h, const ptime &t) {
+    return mix(mix(h, (uint64_t)t.date().day_number()),
+               (uint64_t)t.time_of_day().ticks());
+  }
+
+  /// @return the bits of a float value
+  uint64_t bitsOf(float v) {
+    uint32_t result;
+    memcpy(&result, &v, sizeof result);
+    return result;
+  }
+
+  /// @return true when the 2 records are identical
+  bool sameConnection(const tp::queries::ConnectionRecord &a,
+                      const tp::queries::ConnectionRecord &b) {
+    return a.from == b.from && a.to == b.to &&
+      a.begin == b.begin && a.end == b.end &&
+      a.transpModes == b.transpModes && a.raId == b.raId &&
+      bitsOf(a.price) == bitsOf(b.price) &&
+      bitsOf(a.distance) == bitsOf(b.distance);
+  }
+} // anonymous namespace
+
+// namespace trip planner - queries
+namespace tp { namespace queries {
+
+  constexpr size_t LegRecord::NoLeg;
+  constexpr unsigned ConnectionRecord::NoRouteAlternative;
+  constexpr size_t FlatResults::IndexTable::NoIndex;
+
+  FlatResults::IndexTable::IndexTable(size_t expected) {
+    size_t count = 16ULL;
+    while(count < 2ULL * expected)
+      count <<= 1;
+    slots.assign(count, Slot { 0ULL, NoIndex });
+  }
+
+  void FlatResults::IndexTable::grow() {
+    vector<Slot> previous(slots.size() * 2ULL, Slot { 0ULL, NoIndex });
+    previous.swap(slots);
+    used = 0ULL;
+    for(const Slot &slot : previous)
+      if(NoIndex != slot.index)
+        insert(slot.key, slot.index);
+  }
+
+  void FlatResults::IndexTable::insert(uint64_t key, size_t index) {
+    if(2ULL * (used + 1ULL) > slots.size())
+      grow();
+
+    size_t i = slotOf(key);
+    while(NoIndex != slots[i].index)
+      i = (i + 1ULL) & mask();
+    slots[i] = Slot { key, index };
+    ++used;
+  }
+
+  ptime FlatResults::ConnectionView::begin() const { return rec->begin; }
+  ptime FlatResults::ConnectionView::end() const { return rec->end; }
+  time_duration FlatResults::ConnectionView::duration() const {
+    return rec->end - rec->begin;
+  }
+  size_t FlatResults::ConnectionView::from() const { return rec->from; }
+  size_t FlatResults::ConnectionView::to() const { return rec->to; }
+  float FlatResults::ConnectionView::price() const { return rec->price; }
+  float FlatResults::ConnectionView::distance() const { return rec->distance; }
+  size_t FlatResults::ConnectionView::transpModes() const {
+    return rec->transpModes;
+  }
+
+  const vector<unique_ptr<IConnection>>&
+      FlatResults::VariantView::connections() const {
+    call_once(connsVectorBuilt, [this] {
+      connsVector.reserve(rec->connectionsCount);
+      for(size_t i = 0ULL; i < rec->connectionsCount; ++i)
+        connsVector.emplace_back(new ConnectionView(
+          static_cast<const ConnectionView&>(connection(i))));
+    });
+    return connsVector;
+  }
+
+  size_t FlatResults::VariantView::connectionsCount() const {
+    return rec->connectionsCount;
+  }
+
+  const IConnection& FlatResults::VariantView::connection(size_t idx) const {
+    if(idx >= rec->connectionsCount)
+      throw out_of_range(string(__func__) + " invalid idx!");
+
+    // Going back from the last leg
+    size_t leg = rec->lastLeg;
+    for(size_t i = rec->connectionsCount - 1ULL; i > idx; --i) {
+      leg = legs[leg].previous;
+      assert(LegRecord::NoLeg != leg);
+    }
+    return conns[leg];
+  }
+
+  ptime FlatResults::VariantView::begin() const {
+    return connection(0ULL).begin();
+  }
+  ptime FlatResults::VariantView::end() const {
+    return conns[rec->lastLeg].end();
+  }
+  time_duration FlatResults::VariantView::duration() const {
+    return end() - begin();
+  }
+  size_t FlatResults::VariantView::from() const {
+    return connection(0ULL).from();
+  }
+  size_t FlatResults::VariantView::to() const {
+    return conns[rec->lastLeg].to();
+  }
+  float FlatResults::VariantView::price() const { return rec->price; }
+  float FlatResults::VariantView::distance() const { return rec->distance; }
+  size_t FlatResults::VariantView::transpModes() const {
+    return rec->transpModes;
+  }
+
+  const vector<unique_ptr<IVariant>>& FlatResults::VariantsView::get() const {
+    call_once(variantsVectorBuilt, [this] {
+      variantsVector.reserve(indices->size());
+      for(size_t idx : *indices)
+        variantsVector.emplace_back(new VariantView(variants[idx]));
+    });
+    return variantsVector;
+  }
+
+  size_t FlatResults::VariantsView::count() const {
+    return indices->size();
+  }
+
+  const IVariant& FlatResults::VariantsView::at(size_t idx) const {
+    if(idx >= indices->size())
+      throw out_of_range(string(__func__) + " invalid idx!");
+
+    return variants[(*indices)[idx]];
+  }
+
+  FlatResults::FlatResults(size_t expectedConnections/* = 0ULL*/,
+                           size_t expectedVariants/* = 0ULL*/) :
+      legIndices(expectedConnections), journeyIndices(expectedVariants),
+      categories(variantCategories().size()) {
+    legs.reserve(expectedConnections);
+    journeys.reserve(expectedVariants);
+  }
+
+  size_t FlatResults::legFor(const ConnectionRecord &conn, size_t previous) {
+    uint64_t key = mix(mix(mix(0ULL, previous), conn.from), conn.to);
+    key = mix(mix(mix(key, conn.begin), conn.end), conn.transpModes);
+    key = mix(mix(key, bitsOf(conn.price)), bitsOf(conn.distance));
+    key = mix(key, conn.raId);
+
+    // Hash collisions just continue the probing
+    const size_t found = legIndices.find(key, [&](size_t legIdx) {
+      const LegRecord &leg = legs[legIdx];
+      return leg.previous == previous && sameConnection(leg.connection, conn);
+    });
+    if(SIZE_MAX != found)
+      return found;
+
+    legIndices.insert(key, legs.size());
+    legs.push_back(LegRecord { conn, previous });
+    return legs.size() - 1ULL;
+  }
+
+  void FlatResults::addVariant(size_t categ,
+                               const ConnectionRecord *conns, size_t count) {
+    if(categ >= categories.size())
+      throw out_of_range(string(__func__) + " invalid categ!");
+    if(nullptr == conns || 0ULL == count)
+      throw invalid_argument(string(__func__) +
+                             " expects at least a connection!");
+    if(hasViews)
+      throw logic_error(string(__func__) +
+                        " cannot extend the results after their inspection!");
+
+    VariantRecord variant { LegRecord::NoLeg, count, 0ULL, 0.f, 0.f };
+    for(size_t i = 0ULL; i < count; ++i) {
+      const ConnectionRecord &c = conns[i];
+      if(i > 0ULL && (c.from != conns[i - 1ULL].to ||
+                      c.begin <= conns[i - 1ULL].end))
+        throw invalid_argument(string(__func__) +
+                               " needs connections binding to the previous "
+                               "location and only after the arrival there!");
+
+      variant.transpModes |= c.transpModes;
+      variant.price += c.price;
+      variant.distance += c.distance;
+    }
+
+    for(size_t i = 0ULL; i < count; ++i)
+      variant.lastLeg = legFor(conns[i], variant.lastLeg);
+
+    // A journey already found for another category is shared
+    const size_t found = journeyIndices.find(variant.lastLeg,
+                                             [](size_t) { return true; });
+    if(SIZE_MAX != found) {
+      categories[categ].push_back(found);
+      return;
+    }
+
+    journeyIndices.insert(variant.lastLeg, journeys.size());
+    categories[categ].push_back(journeys.size());
+    journeys.push_back(variant);
+  }
+
+  void FlatResults::appendVariants(size_t categ, const FlatResults &other) {
+    if(categ >= categories.size() || categ >= other.categories.size())
+      throw out_of_range(string(__func__) + " invalid categ!");
+
+    vector<ConnectionRecord> conns;
+    for(size_t journeyIdx : other.categories[categ]) {
+      const VariantRecord &variant = other.journeys[journeyIdx];
+      conns.resize(variant.connectionsCount);
+      size_t legIdx = variant.lastLeg;
+      for(size_t i = variant.connectionsCount; i > 0ULL; --i) {
+        const LegRecord &leg = other.legs[legIdx];
+        conns[i - 1ULL] = leg.connection;
+        legIdx = leg.previous;
+      }
+      addVariant(categ, conns.data(), conns.size());
+    }
+  }
+
+  size_t FlatResults::variantsCount(size_t categ) const {
+    if(categ >= categories.size())
+      throw out_of_range(string(__func__) + " invalid categ!");
+
+    return categories[categ].size();
+  }
+
+  size_t FlatResults::legsCount() const {
+    return legs.size();
+  }
+
+  size_t FlatResults::journeysCount() const {
+    return journeys.size();
+  }
+
+  vector<unsigned> FlatResults::routeAlternatives() const {
+    vector<unsigned> result;
+    result.reserve(legs.size());
+    for(const LegRecord &leg : legs)
+      if(ConnectionRecord::NoRouteAlternative != leg.connection.raId)
+        result.push_back(leg.connection.raId);
+    sort(BOUNDS(result));
+    result.erase(unique(BOUNDS(result)), end(result));
+    return result;
+  }
+
+  unique_ptr<FlatResults>
+      FlatResults::within(const ITimeConstraints &timeConstraints,
+                          vector<size_t> &dropped) const {
+    const time_period &leave = timeConstraints.leavePeriod(),
+      &arrive = timeConstraints.arrivePeriod();
+    const auto conforms = [&](const VariantRecord &variant) {
+      size_t firstLeg = variant.lastLeg;
+      while(LegRecord::NoLeg != legs[firstLeg].previous)
+        firstLeg = legs[firstLeg].previous;
+      return leave.contains(legs[firstLeg].connection.begin) &&
+        arrive.contains(legs[variant.lastLeg].connection.end);
+    };
+
+    dropped.assign(categories.size(), 0ULL);
+    vector<char> kept(journeys.size(), 0);
+    size_t droppedCount = 0ULL;
+    for(size_t categ = 0ULL; categ < categories.size(); ++categ)
+      for(size_t journeyIdx : categories[categ]) {
+        kept[journeyIdx] = conforms(journeys[journeyIdx]) ? 1 : 0;
+        if(kept[journeyIdx] == 0) {
+          ++dropped[categ];
+          ++droppedCount;
+        }
+      }
+    if(droppedCount == 0ULL)
+      return nullptr;
+
+    unique_ptr<FlatResults> result =
+      make_unique<FlatResults>(legs.size(), journeys.size());
+    vector<ConnectionRecord> conns;
+    for(size_t categ = 0ULL; categ < categories.size(); ++categ)
+      for(size_t journeyIdx : categories[categ]) {
+        if(kept[journeyIdx] == 0)
+          continue;
+
+        const VariantRecord &variant = journeys[journeyIdx];
+        conns.resize(variant.connectionsCount);
+        size_t legIdx = variant.lastLeg;
+        for(size_t i = variant.connectionsCount; i > 0ULL; --i) {
+          conns[i - 1ULL] = legs[legIdx].connection;
+          legIdx = legs[legIdx].previous;
+        }
+        result->addVariant(categ, conns.data(), conns.size());
+      }
+    result->interrupted = interrupted;
+    return result;
+  }
+
+  void FlatResults::ensureViews() const {
+    call_once(viewsCreated, [this] {
+      // The records don't change from now on, so the views may point to them
+      connectionViews.reserve(legs.size());
+      for(const LegRecord &leg : legs)
+        connectionViews.emplace_back(leg.connection);
+
+      variantViews.reserve(journeys.size());
+      for(const VariantRecord &v : journeys)
+        variantViews.emplace_back(v, legs.data(), connectionViews.data());
+
+      categoryViews.reserve(categories.size());
+      for(const vector<size_t> &indices : categories)
+        categoryViews.emplace_back(indices, variantViews.data());
+
+      hasViews = true;
+    });
+  }
+
+  void FlatResults::markPartial() {
+    interrupted = true;
+  }
+
+  bool FlatResults::partial() const {
+    return interrupted;
+  }
+
+  const IVariants& FlatResults::operator[](size_t categ) const {
+    if(categ >= categories.size())
+      throw out_of_range(string(__func__) + " invalid categ!");
+
+    ensureViews();
+    assert(categ < categoryViews.size());
+    return categoryViews[categ];
+  }
+
+}} // namespace tp::queries
@@ -0,0 +1,320 @@
+/*****************************************************************************
+ TripPlanner explores various issues common to navigation and booking systems.
+
+ Copyrights from the libraries used by the program:
+ - (c) 2017 Boost (www.boost.org)
+		License: <http://www.boost.org/LICENSE_1_0.txt>
+ 
+ (c) 2017 Florin Tulba <florintulba@yahoo.com>
+
+ This program is free software: you can use its results,
+ redistribute it and/or modify it under the terms of the GNU
+ Affero General Public License version 3 as published by the
+ Free Software Foundation.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU Affero General Public License for more details.
+
+ You should have received a copy of the GNU Affero General Public License
+ along with this program ('agpl-3.0.txt').
+ If not, see <http://www.gnu.org/licenses/agpl-3.0.txt>.
+ *****************************************************************************/
+
+#ifndef H_FLAT_RESULTS
+#define H_FLAT_RESULTS
+
+#include "resultsBase.h"
+#include "constraintsBase.h"
+
+#pragma warning ( push, 0 )
+
+#include <mutex>
+#include <climits>
+#include <cstdint>
+#include <vector>
+
+#pragma warning ( pop )
+
+// namespace trip planner - queries
+namespace tp { namespace queries {
+
+  /// Plain description of a connection
+  struct ConnectionRecord {
+    size_t from;  ///< index of the starting point (local / global)
+    size_t to;    ///< index of the destination point (local / global)
+    boost::posix_time::ptime begin; ///< departure time
+    boost::posix_time::ptime end;   ///< arrival time
+    size_t transpModes; ///< a transportation mode
+    float price;    ///< price of the ticket(s) between the connected locations
+    float distance; ///< distance between the connected locations
+    unsigned raId;  ///< id of the route alternative or NoRouteAlternative
+
+    /// Value of raId for walks between nearby places
+    static constexpr unsigned NoRouteAlternative = UINT_MAX;
+  };
+
+  /// A connection following another leg (the previous connections of a journey)
+  struct LegRecord {
+    /// Value of `previous` for the first leg of a journey
+    static constexpr size_t NoLeg = SIZE_MAX;
+
+    ConnectionRecord connection; ///< the connection
+    size_t previous; ///< index of the leg before connection, or NoLeg
+  };
+
+  /// Plain description of a journey: its last leg and the count of legs
+  struct VariantRecord {
+    size_t lastLeg;           ///< index of the last leg
+    size_t connectionsCount;  ///< count of legs
+    size_t transpModes; ///< the transportation modes of all connections
+    float price;    ///< total price of the connections
+    float distance; ///< total distance of the connections
+  };
+
+  /**
+  Realization of IResults which keeps every connection of every variant
+  within a single vector of LegRecord-s and every distinct journey
+  as a VariantRecord pointing to its last leg.
+
+  The legs form a persistent prefix tree: a leg is never modified after
+  being added and journeys starting with the same connections share the legs
+  of that common prefix. The same journey found for several categories
+  is stored once in the journey pool, while the categories hold
+  indices into that pool.
+
+  The records of a query are appended to buffers reserved upfront
+  and released all at once, together with the results (a monotonic arena),
+  instead of allocating separately every variant and connection.
+
+  The IVariants / IVariant / IConnection views over the records are created
+  in one go when the results are first inspected. IVariants::count/at and
+  IVariant::connectionsCount/connection serve them directly, while
+  IVariants::get and IVariant::connections build their vectors of
+  forwarding objects only when called.
+  */
+  class FlatResults : public IResults {
+  protected:
+    /// IConnection over the ConnectionRecord of a leg
+    class ConnectionView : public IConnection {
+    protected:
+      const ConnectionRecord *rec; ///< the viewed record
+
+    public:
+      ConnectionView(const ConnectionRecord &rec_) : rec(&rec_) {}
+
+      boost::posix_time::ptime begin() const override;
+      boost::posix_time::ptime end() const override;
+      boost::posix_time::time_duration duration() const override;
+      size_t from() const override;
+      size_t to() const override;
+      float price() const override;
+      float distance() const override;
+      size_t transpModes() const override;
+    };
+
+    /// IVariant over a VariantRecord
+    class VariantView : public IVariant {
+    protected:
+      const VariantRecord *rec; ///< the viewed record
+      const LegRecord *legs; ///< all the legs
+      const ConnectionView *conns; ///< the views of all the legs
+
+      /// Forwarding copies of the connection views, built by connections()
+      mutable std::vector<std::unique_ptr<IConnection>> connsVector;
+      mutable std::once_flag connsVectorBuilt; ///< ensures connsVector is built once
+
+    public:
+      VariantView(const VariantRecord &rec_, const LegRecord *legs_,
+                  const ConnectionView *conns_) :
+        rec(&rec_), legs(legs_), conns(conns_) {}
+      VariantView(const VariantView &other) :
+        rec(other.rec), legs(other.legs), conns(other.conns) {}
+
+      const std::vector<std::unique_ptr<IConnection>>& connections() const override;
+      size_t connectionsCount() const override;
+      const IConnection& connection(size_t idx) const override;
+      boost::posix_time::ptime begin() const override;
+      boost::posix_time::ptime end() const override;
+      boost::posix_time::time_duration duration() const override;
+      size_t from() const override;
+      size_t to() const override;
+      float price() const override;
+      float distance() const override;
+      size_t transpModes() const override;
+    };
+
+    /// IVariants over the variants of a category
+    class VariantsView : public IVariants {
+    protected:
+      const std::vector<size_t> *indices; ///< the variant records of the category
+      const VariantView *variants; ///< the views of all variant records
+
+      /// Forwarding copies of the variant views, built by get()
+      mutable std::vector<std::unique_ptr<IVariant>> variantsVector;
+      mutable std::once_flag variantsVectorBuilt; ///< ensures variantsVector is built once
+
+    public:
+      VariantsView(const std::vector<size_t> &indices_,
+                   const VariantView *variants_) :
+        indices(&indices_), variants(variants_) {}
+      VariantsView(const VariantsView &other) :
+        indices(other.indices), variants(other.variants) {}
+
+      const std::vector<std::unique_ptr<IVariant>>& get() const override;
+      size_t count() const override;
+      const IVariant& at(size_t idx) const override;
+    };
+
+    /**
+    Open-addressing table (linear probing) from keys to record indices.
+    Its slots are a single vector reserved upfront, so the entries don't get
+    allocated one by one. Several entries may share a key.
+    */
+    class IndexTable {
+    protected:
+      /// Value of index for free slots
+      static constexpr size_t NoIndex = SIZE_MAX;
+
+      /// A key and the record index for that key
+      struct Slot {
+        uint64_t key;
+        size_t index;
+      };
+
+      std::vector<Slot> slots;  ///< power of 2 count, at most half occupied
+      size_t used = 0ULL;       ///< count of occupied slots
+
+      /// @return the mask for wrapping the slot indices
+      size_t mask() const { return slots.size() - 1ULL; }
+
+      /// @return the first slot to inspect for key
+      size_t slotOf(uint64_t key) const {
+        return size_t((key * 0x9E3779B97F4A7C15ULL) >> 32) & mask();
+      }
+
+      /// Doubles the slots, placing the entries again
+      void grow();
+
+    public:
+      /// Reserves the slots for `expected` entries
+      explicit IndexTable(size_t expected);
+
+      /**
+      Inspects the indices stored for key until matches(index) is true.
+      @return the matching index or SIZE_MAX if there is none
+      */
+      template<class Matches>
+      size_t find(uint64_t key, Matches matches) const {
+        for(size_t i = slotOf(key); ; i = (i + 1ULL) & mask()) {
+          const Slot &slot = slots[i];
+          if(NoIndex == slot.index)
+            return NoIndex;
+          if(slot.key == key && matches(slot.index))
+            return slot.index;
+        }
+      }
+
+      /// Adds index for key
+      void insert(uint64_t key, size_t index);
+    };
+
+    std::vector<LegRecord> legs; ///< the prefix tree of the legs of all journeys
+    std::vector<VariantRecord> journeys;  ///< the distinct journeys of all categories
+
+    IndexTable legIndices;      ///< index of each leg by a hash of its content
+    IndexTable journeyIndices;  ///< index of each journey by its last leg
+
+    /// Indices of the journeys for each category
+    std::vector<std::vector<size_t>> categories;
+
+    /// @return the index of the leg with connection conn after leg previous
+    size_t legFor(const ConnectionRecord &conn, size_t previous);
+
+    /// The views over the records, created by ensureViews
+    mutable std::vector<ConnectionView> connectionViews;
+    mutable std::vector<VariantView> variantViews;
+    mutable std::vector<VariantsView> categoryViews;
+    mutable std::once_flag viewsCreated; ///< ensures the views are created once
+    mutable bool hasViews = false; ///< set by ensureViews
+
+    bool interrupted = false; ///< set by markPartial
+
+    /// Creates the views over the records, unless they already exist
+    void ensureViews() const;
+
+  public:
+    /**
+    Initializes empty results
+
+    @param expectedConnections the count of legs to reserve
+    @param expectedVariants the count of journeys to reserve
+    */
+    FlatResults(size_t expectedConnections = 0ULL,
+                size_t expectedVariants = 0ULL);
+
+    FlatResults(const FlatResults&) = delete;
+    FlatResults(FlatResults&&) = delete;
+    void operator=(const FlatResults&) = delete;
+    void operator=(FlatResults&&) = delete;
+
+    /**
+    Appends a less performant variant than the previous one from category categ.
+    Throws out_of_range for an invalid categ, invalid_argument when
+    the connections don't form a chain or are missing and
+    logic_error after the results were inspected.
+
+    @param categ the category of the variant
+    @param conns the connections of the variant
+    @param count the count of connections
+    */
+    void addVariant(size_t categ, const ConnectionRecord *conns, size_t count);
+
+    /**
+    Appends the variants of category categ from other, in their order,
+    after the variants of categ found so far.
+    Throws like addVariant.
+    */
+    void appendVariants(size_t categ, const FlatResults &other);
+
+    /// @return the count of variants from category categ without creating the views
+    size_t variantsCount(size_t categ) const;
+
+    /// @return the count of distinct legs among all journeys
+    size_t legsCount() const;
+
+    /// @return the count of distinct journeys among all categories
+    size_t journeysCount() const;
+
+    /// @return the sorted ids of the route alternatives used by the journeys,
+    /// without the walks
+    std::vector<unsigned> routeAlternatives() const;
+
+    /**
+    Copies the variants leaving and arriving within timeConstraints,
+    keeping their order and the partial flag.
+
+    @param timeConstraints the periods for leaving and for arriving
+    @param dropped receives for each category the count of variants left out
+
+    @return the copy or nullptr when all the variants are within
+      timeConstraints, so these results serve as they are
+    */
+    std::unique_ptr<FlatResults>
+      within(const ITimeConstraints &timeConstraints,
+             std::vector<size_t> &dropped) const;
+
+    /// Flags the results of a search which stopped early
+    void markPartial();
+
+    /// @return the variants for the given category
+    const IVariants& operator[](size_t categ) const override;
+
+    /// @return true after markPartial
+    bool partial() const override;
+  };
+
+}} // namespace tp::queries
+
+#endif // H_FLAT_RESULTS
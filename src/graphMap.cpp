@@ -0,0 +1,1238 @@
+/*****************************************************************************
+ TripPlanner explores various issues common to navigation and booking systems.
+
+ Copyrights from the libraries used by the program:
+ - (c) 2017 Boost (www.boost.org)
+		License: <http://www.boost.org/LICENSE_1_0.txt>
+ 
+ (c) 2017 Florin Tulba <florintulba@yahoo.com>
+
+ This program is free software: you can use its results,
+ redistribute it and/or modify it under the terms of the GNU
+ Affero General Public License version 3 as published by the
+ Free Software Foundation.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU Affero General Public License for more details.
+
+ You should have received a copy of the GNU Affero General Public License
+ along with this program ('agpl-3.0.txt').
+ If not, see <http://www.gnu.org/licenses/agpl-3.0.txt>.
+ *****************************************************************************/
+
+#include "graphMap.h"
+#include "flatResults.h"
+#include "customDateTimeProcessor.h"
+#include "transpModes.h"
+#include "util.h"
+
+#pragma warning ( push, 0 )
+
+#include <array>
+#include <queue>
+#include <algorithm>
+#include <functional>
+#include <climits>
+#include <cmath>
+#include <limits>
+#include <atomic>
+#include <cassert>
+
+#include <boost/date_time/gregorian/parsers.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+
+#pragma warning ( pop )
+
+using namespace std;
+using namespace boost::gregorian;
+using namespace boost::posix_time;
+
+namespace {
+  const long MinutesPerDay = 24L * 60L;
+
+  /// Largest count of connections within a variant
+  const unsigned MaxRides = 6U;
+
+  /// Count of the explored labels between 2 checks of the search limits
+  const unsigned LabelsPerLimitsCheck = 256U;
+
+  /// A place can be reached by this many times maxCountPerCategory distinct
+  /// sequences of rides. The extra sequences replace the ones that cannot be
+  /// continued (loops, missed departures, no seats)
+  const size_t PopsPerVariant = 3ULL;
+
+  /// Minimum minutes between an arrival at a place and a next departure,
+  /// for each transportation mode serving the place, in the order from TranspModes
+  const long MinTransferMinutes[] { 45L, 5L, 5L, 15L, 1L };
+
+  const float MaxFootpathKm = 1.f;      ///< longest direct walk between 2 places
+  const float WalkingKmPerHour = 4.5f;  ///< the walking speed
+  const long MaxWalkMinutes = 30L;      ///< longest walk, even through other places
+  const float EarthMeanRadiusKm = 6'371.f; ///< see GpsCoord::distanceTo
+
+  /// Id of the route alternative of a walk
+  const unsigned NoRide = tp::queries::ConnectionRecord::NoRouteAlternative;
+
+  /// Minutes from toMinutes at 1970-Jan-1 00:00, the origin of the travel matrices
+  const long EpochMinutes =
+    long(date(1970, Jan, 1).day_number()) * MinutesPerDay;
+
+  /// The variants are sorted by the category with this index
+  enum Category {
+    MostRapid, Cheapest, Shortest, SoonestAtDestination, LeastStationary
+  };
+
+  /// @return the minutes since the start of the Julian day numbering
+  long toMinutes(const ptime &t, bool roundUp) {
+    const time_duration tod = t.time_of_day();
+    long result = long(t.date().day_number()) * MinutesPerDay +
+      long(tod.hours()) * 60L + long(tod.minutes());
+    if(roundUp && (tod.seconds() != 0 || tod.fractional_seconds() != 0))
+      ++result;
+    return result;
+  }
+
+  /// @return the date with the given Julian day number
+  date dateOf(long dayNumber) {
+    return date(gregorian_calendar::from_day_number(
+      (gregorian_calendar::date_int_type)dayNumber));
+  }
+
+  /// @return the moment corresponding to minutes from toMinutes
+  ptime toPtime(long minutes) {
+    return ptime(dateOf(minutes / MinutesPerDay),
+                 boost::posix_time::minutes(minutes % MinutesPerDay));
+  }
+
+  /// Combines h with v
+  uint64_t mix(uint64_t h, uint64_t v) {
+    h = (h ^ v) * 0x9E3779B97F4A7C15ULL;
+    return h ^ (h >> 29);
+  }
+} // anonymous namespace
+
+namespace tp { // trip planner
+  using namespace specs;
+  using namespace queries;
+  using namespace bookings;
+
+  /**
+  Resolves a single search, one category at a time.
+
+  Each category uses a best-first exploration of partial trips (labels).
+  The cost of a label never decreases when extending it with more rides,
+  so the labels reaching the destination get ordered by their final cost.
+  */
+  class TripPlanner::GraphMap::Query {
+  protected:
+    /// A partial trip ending with a ride from fromPlace to place
+    struct Label {
+      unsigned parent;    ///< index of the previous label or NoParent
+      unsigned fromPlace; ///< where the last ride started
+      unsigned place;     ///< where the last ride ended
+      unsigned raId;      ///< route alternative of the last ride
+      long serviceDay;    ///< Julian day when that route alternative started
+      long departure;     ///< departure of the last ride (minutes)
+      long arrival;       ///< arrival of the last ride (minutes)
+      long firstDeparture;///< departure of the first ride (minutes)
+      long riding;        ///< total time spent within vehicles (minutes)
+      float ridePrice;    ///< price of the last ride
+      float rideDistance; ///< distance of the last ride
+      float price;        ///< total price
+      float distance;     ///< total distance
+      unsigned rides;     ///< count of rides
+      uint64_t ridesHash; ///< identifies the sequence of rides, ignoring the dates
+      unsigned via;       ///< the bits of the via places passed through
+    };
+
+    /// Label labelIdx, ordered by cost and then by arrival
+    struct Candidate {
+      double cost;
+      long arrival;
+      unsigned labelIdx;
+
+      bool operator>(const Candidate &other) const {
+        if(cost != other.cost)
+          return cost > other.cost;
+        if(arrival != other.arrival)
+          return arrival > other.arrival;
+        return labelIdx > other.labelIdx;
+      }
+    };
+
+    typedef priority_queue<Candidate, vector<Candidate>,
+                           greater<Candidate>> Candidates;
+
+    static const unsigned NoParent = UINT_MAX;
+
+    const GraphMap &g;  ///< the graph
+    const unsigned from, to; ///< indices of the trip ends
+    const size_t maxCount;   ///< maxCountPerCategory
+
+    /// Imposed departure and arrival intervals (minutes)
+    long leaveFirst, leaveLast, arriveFirst, arriveLast;
+
+    const ISeatsConstraints *seatsConstraints; ///< optional seat constraints
+    const IOccupancyView *occupancy;        ///< optional occupancy
+    const unsigned persons; ///< how many persons travel together
+    const bool economyClass; ///< the class of the seats
+    const long today; ///< Julian day of the query
+    const bool walking; ///< walks between nearby places are allowed
+
+    /// Indices of the allowed transportation modes
+    array<size_t, ModesCount> modes;
+    size_t modesCount = 0ULL; ///< count of the allowed transportation modes
+
+    vector<unsigned> viaBits; ///< the bit of each via place; 0 for other places
+    unsigned allVia = 0U;     ///< the bits of all via places
+    vector<bool> avoided;     ///< the places to avoid
+    vector<unsigned> avoidedRoutes; ///< sorted ids of the routes to avoid
+    bool satisfiable = true;  ///< false for via places unknown or unreachable
+
+    const ISearchLimits *limits; ///< optional deadline / cancellation
+    bool interrupted = false;    ///< the limits stopped the exploration
+
+    /// The state of the exploration for a category, which can be resumed
+    struct Exploration {
+      vector<Label> labels;   ///< the partial trips
+      Candidates candidates;  ///< the partial trips still to be explored
+      unordered_map<uint64_t, unsigned> instances; ///< per place and rides
+      vector<size_t> distinctRides; ///< per place and passed via places
+      size_t found = 0ULL;    ///< the count of variants found so far
+      bool started = false;   ///< the starting rides were added
+    };
+
+    vector<bool> reachesDestination; ///< which places have paths towards `to`
+    vector<Exploration> explorations; ///< the exploration of each category
+    vector<Label> labels;   ///< the labels of the current category
+    Category categ;         ///< current category
+
+    double costOf(const Label &l) const {
+      switch(categ) {
+        case MostRapid: return double(l.arrival - l.firstDeparture);
+        case Cheapest: return double(l.price);
+        case Shortest: return double(l.distance);
+        case SoonestAtDestination: return double(l.arrival);
+        default: return double(l.arrival - l.firstDeparture - l.riding);
+      }
+    }
+
+    /// @return true if the route alternative cannot be used
+    bool avoidedRoute(const RouteAlternativeData &rad) const {
+      return !avoidedRoutes.empty() &&
+        binary_search(BOUNDS(avoidedRoutes), rad.rsi->id());
+    }
+
+    /// @return true if the trip ending with label labelIdx visited place
+    bool visited(unsigned labelIdx, unsigned place) const {
+      for(; labelIdx != NoParent; labelIdx = labels[labelIdx].parent)
+        if(labels[labelIdx].place == place)
+          return true;
+      return false;
+    }
+
+    /// @return the seats within the class chosen by seatsConstraints
+    unsigned capacity(const RouteAlternativeData &rad) const {
+      return economyClass ?
+        rad.ra->economySeatsCapacity() : rad.ra->businessSeatsCapacity();
+    }
+
+    /// @return the occupied seats within the class chosen by seatsConstraints
+    unsigned occupied(const RouteAlternativeData &rad, long serviceDay) const {
+      if(nullptr == occupancy)
+        return 0U;
+      return occupancy->occupied(Leg { rad.ra->id(), dateOf(serviceDay),
+                                       economyClass });
+    }
+
+    /// @return true if the route alternative serving on serviceDay
+    /// has enough free seats for seatsConstraints
+    bool enoughSeats(const RouteAlternativeData &rad, long serviceDay) const {
+      if(nullptr == seatsConstraints)
+        return true;
+
+      const unsigned seats = capacity(rad), taken = occupied(rad, serviceDay);
+      return taken < seats && seats - taken >= persons;
+    }
+
+    /**
+    Finds the first service day of rad when hop departs after `after`,
+    but not after latest, and enough seats are free for seatsConstraints.
+    @return false if there is no such service day
+    */
+    bool bookableService(const RouteAlternativeData &rad, unsigned hop,
+                         long after, long latest, long &serviceDay) const {
+      while(earliestService(rad, hop, after, latest, serviceDay)) {
+        if(enoughSeats(rad, serviceDay))
+          return true;
+        after = serviceDay * MinutesPerDay + rad.departures[hop];
+      }
+      return false;
+    }
+
+    /// @return the price of a ride between the traversed stops boarding and
+    /// alighting on the route alternative starting on serviceDay
+    float fare(const RouteAlternativeData &rad, size_t boarding, size_t alighting,
+               long serviceDay) const {
+      const float normalFare = rad.route->fare(rad.routeStop(boarding),
+                                               rad.routeStop(alighting),
+                                               economyClass);
+      if(rad.transpMode != TranspModes::AIR || normalFare <= 0.f)
+        return normalFare;
+
+      // The price considers the occupancy after booking the seats of `persons`
+      return normalFare *
+        g.airfares.factor(rad.rsi->pricingEngine(), rad.rsi->id(),
+                          occupied(rad, serviceDay) + persons,
+                          capacity(rad), serviceDay - today);
+    }
+
+    /**
+    Adds a label for every place where one can get off after boarding
+    route alternative raId at its hop `hop` on serviceDay.
+    parentIdx is the label preceding this ride or NoParent for the first ride.
+    The service day comes from bookableService, so the seats are enough.
+    */
+    void addRides(unsigned parentIdx, unsigned raId,
+                  const RouteAlternativeData &rad, unsigned hop,
+                  long serviceDay, Candidates &candidates) {
+      const long dayStart = serviceDay * MinutesPerDay,
+        departure = dayStart + rad.departures[hop];
+      const size_t hops = rad.departures.size();
+
+      // The intermediary stops of the ride count as passed through, too
+      unsigned via = (NoParent == parentIdx) ? viaBits[from] :
+        labels[parentIdx].via;
+      for(size_t j = hop; j < hops; ++j) {
+        const long arrival = dayStart + rad.arrivals[j];
+        if(arrival > arriveLast)
+          break;
+
+        const unsigned place = rad.stops[j + 1ULL];
+        if(avoided[place])
+          break;
+
+        via |= viaBits[place];
+        if(!reachesDestination[place] || place == from ||
+           visited(parentIdx, place) ||
+           (place == to && (arrival < arriveFirst || via != allVia)))
+          continue;
+
+        const float ridePrice = fare(rad, hop, j + 1ULL, serviceDay);
+        if(ridePrice <= 0.f)
+          continue;
+
+        const float dist = rad.rsi->legDistance(hop, j + 1ULL, rad.returnTrip);
+
+        Label l;
+        l.parent = parentIdx;
+        l.fromPlace = (NoParent == parentIdx) ? from : labels[parentIdx].place;
+        l.place = place;
+        l.raId = raId;
+        l.serviceDay = serviceDay;
+        l.departure = departure;
+        l.arrival = arrival;
+        l.ridePrice = ridePrice;
+        l.rideDistance = dist;
+        l.riding = arrival - departure;
+        l.price = ridePrice;
+        l.distance = dist;
+        l.firstDeparture = departure;
+        l.rides = 1U;
+        l.ridesHash = mix(mix(mix(0ULL, raId), hop), j);
+        l.via = via;
+        if(NoParent != parentIdx) {
+          const Label &p = labels[parentIdx];
+          l.riding += p.riding;
+          l.price += p.price;
+          l.distance += p.distance;
+          l.firstDeparture = p.firstDeparture;
+          l.rides += p.rides;
+          l.ridesHash = mix(mix(mix(p.ridesHash, raId), hop), j);
+        }
+
+        labels.push_back(l);
+        candidates.push(Candidate { costOf(l), arrival,
+                                    unsigned(labels.size() - 1ULL) });
+      }
+    }
+
+    /// Adds a label for every place reachable on foot
+    /// after the ride ending with label parentIdx
+    void addWalks(unsigned parentIdx, Candidates &candidates) {
+      const Label p = labels[parentIdx]; // labels grows below
+      const long departure = p.arrival + g.minTransfers[p.place];
+      for(const Footpath &fp : g.footpaths[p.place]) {
+        const long arrival = departure + fp.minutes;
+        if(arrival > arriveLast)
+          continue;
+
+        const unsigned place = fp.place, via = p.via | viaBits[place];
+        if(avoided[place] || !reachesDestination[place] || place == from ||
+           visited(parentIdx, place) ||
+           (place == to && (arrival < arriveFirst || via != allVia)))
+          continue;
+
+        Label l = p;
+        l.parent = parentIdx;
+        l.fromPlace = p.place;
+        l.place = place;
+        l.raId = NoRide;
+        l.departure = departure;
+        l.arrival = arrival;
+        l.ridePrice = 0.f;
+        l.rideDistance = fp.distance;
+        l.distance += fp.distance;
+        ++l.rides;
+        l.ridesHash = mix(mix(p.ridesHash, NoRide), place);
+        l.via = via;
+
+        labels.push_back(l);
+        candidates.push(Candidate { costOf(l), arrival,
+                                    unsigned(labels.size() - 1ULL) });
+      }
+    }
+
+    /// Appends to results the variant ending with label labelIdx
+    void addVariant(unsigned labelIdx, FlatResults &results) const {
+      array<ConnectionRecord, MaxRides> conns;
+      size_t count = size_t(labels[labelIdx].rides);
+      assert(count > 0ULL && count <= MaxRides);
+      for(size_t i = count; labelIdx != NoParent;
+          labelIdx = labels[labelIdx].parent) {
+        const Label &l = labels[labelIdx];
+        conns[--i] = ConnectionRecord {
+          g.placeIds[l.fromPlace], g.placeIds[l.place],
+          toPtime(l.departure), toPtime(l.arrival),
+          (NoRide == l.raId) ? size_t(TranspModes::FOOT) :
+            size_t(g.routeAlternatives.at(l.raId).transpMode),
+          l.ridePrice, l.rideDistance, l.raId };
+      }
+      results.addVariant(size_t(categ), conns.data(), count);
+    }
+
+  public:
+    Query(const GraphMap &g_, unsigned from_, unsigned to_, size_t maxCount_,
+          const ITimeConstraints &timeConstraints,
+          const ISeatsConstraints *seatsConstraints_,
+          const IOccupancyView *occupancy_, size_t transpModes,
+          const IPlaceConstraints *placeConstraints,
+          const ISearchLimits *limits_ = nullptr) :
+        g(g_), from(from_), to(to_), maxCount(maxCount_),
+        leaveFirst(toMinutes(timeConstraints.leavePeriod().begin(), true)),
+        leaveLast(toMinutes(timeConstraints.leavePeriod().last(), false)),
+        arriveFirst(toMinutes(timeConstraints.arrivePeriod().begin(), true)),
+        arriveLast(toMinutes(timeConstraints.arrivePeriod().last(), false)),
+        seatsConstraints(seatsConstraints_), occupancy(occupancy_),
+        persons((nullptr == seatsConstraints_) ? 1U : seatsConstraints_->persons()),
+        economyClass((nullptr == seatsConstraints_) ||
+                     seatsConstraints_->economyClass()),
+        today(long(nowUTC().date().day_number())),
+        walking((transpModes & size_t(TranspModes::FOOT)) != 0ULL),
+        viaBits(g_.placeIds.size(), 0U), avoided(g_.placeIds.size(), false),
+        limits(limits_),
+        reachesDestination(g_.placeIds.size(), false),
+        explorations(variantCategories().size()), categ(MostRapid) {
+      for(size_t m = 0ULL; m < ModesCount; ++m)
+        if((transpModes & (size_t(1ULL) << m)) != 0ULL)
+          modes[modesCount++] = m;
+
+      if(nullptr != placeConstraints) {
+        for(unsigned id : placeConstraints->avoidedPlaces()) {
+          const auto it = g.placeIndices.find(id);
+          if(cend(g.placeIndices) != it)
+            avoided[it->second] = true;
+        }
+        satisfiable = !avoided[from] && !avoided[to];
+
+        // Other implementations of IPlaceConstraints than PlaceConstraints
+        // might provide unsorted ids, duplicates or too many via places
+        vector<unsigned> viaIds = placeConstraints->viaPlaces();
+        sort(BOUNDS(viaIds));
+        viaIds.erase(unique(BOUNDS(viaIds)), end(viaIds));
+        if(viaIds.size() > IPlaceConstraints::MaxViaPlaces)
+          throw invalid_argument(string(__func__) + " accepts at most " +
+                                 to_string(IPlaceConstraints::MaxViaPlaces) +
+                                 " via places!");
+
+        unsigned viaCount = 0U;
+        for(unsigned id : viaIds) {
+          const auto it = g.placeIndices.find(id);
+          if(cend(g.placeIndices) == it) {
+            satisfiable = false;
+            continue;
+          }
+          viaBits[it->second] = 1U << viaCount++;
+          allVia |= viaBits[it->second];
+        }
+
+        avoidedRoutes = placeConstraints->avoidedRoutes();
+        sort(BOUNDS(avoidedRoutes));
+      }
+
+      // Places from where the destination is reachable using the allowed modes,
+      // without stopping in avoided places
+      vector<unsigned> toVisit { to };
+      reachesDestination[to] = true;
+      while(!toVisit.empty()) {
+        const unsigned place = toVisit.back();
+        toVisit.pop_back();
+        for(size_t i = 0ULL; i < modesCount; ++i) {
+          for(unsigned prev : g.predecessors[modes[i]][place]) {
+            if(!reachesDestination[prev] && !avoided[prev]) {
+              reachesDestination[prev] = true;
+              toVisit.push_back(prev);
+            }
+          }
+        }
+
+        // The footpaths are symmetric
+        if(walking) {
+          for(const Footpath &fp : g.footpaths[place]) {
+            if(!reachesDestination[fp.place] && !avoided[fp.place]) {
+              reachesDestination[fp.place] = true;
+              toVisit.push_back(fp.place);
+            }
+          }
+        }
+      }
+
+      for(size_t place = 0ULL; place < viaBits.size(); ++place)
+        if(viaBits[place] != 0U && !reachesDestination[place])
+          satisfiable = false;
+    }
+
+    /// @return true if the destination might be reachable from the origin
+    bool connected() const {
+      return satisfiable && reachesDestination[from];
+    }
+
+    /// @return true if the limits stopped an exploration
+    bool stoppedByLimits() const {
+      return interrupted;
+    }
+
+    /// @return true when category categ_ cannot provide more variants
+    bool exhausted(Category categ_) const {
+      const Exploration &e = explorations[size_t(categ_)];
+      return e.found >= maxCount || (e.started && e.candidates.empty());
+    }
+
+    /// Releases the state of the exploration of category categ_
+    void release(Category categ_) {
+      explorations[size_t(categ_)] = Exploration();
+    }
+
+    /**
+    Appends to results the next best variants for category categ_,
+    resuming its previous exploration.
+
+    @param categ_ the category
+    @param count the maximum count of new variants
+    @param results receives the new variants
+
+    @return the count of new variants
+    */
+    size_t resume(Category categ_, size_t count, FlatResults &results) {
+      Exploration &e = explorations[size_t(categ_)];
+      categ = categ_;
+
+      // The labels of categ_ become the current ones until returning
+      struct LabelsSwap {
+        vector<Label> &a, &b;
+        LabelsSwap(vector<Label> &a_, vector<Label> &b_) : a(a_), b(b_) { a.swap(b); }
+        ~LabelsSwap() { a.swap(b); }
+      } labelsSwap(labels, e.labels);
+
+      // The time-dependent costs might improve when the same rides
+      // happen in another day of the week
+      const unsigned instancesPerRides =
+        (categ == MostRapid || categ == LeastStationary) ? 7U : 1U;
+
+      Candidates &candidates = e.candidates;
+      if(!e.started) {
+        e.started = true;
+        e.distinctRides.assign(g.placeIds.size() * (allVia + 1U), 0ULL);
+        for(size_t m = 0ULL; m < modesCount; ++m) {
+          for(const Edge &edge : g.outEdges[modes[m]][from]) {
+            const RouteAlternativeData &rad = g.routeAlternatives.at(edge.raId);
+            if(avoidedRoute(rad))
+              continue;
+
+            long after = leaveFirst - 1L, serviceDay = 0L;
+            for(unsigned i = 0U; i < instancesPerRides &&
+                bookableService(rad, edge.hopIdx, after, leaveLast, serviceDay); ++i) {
+              addRides(NoParent, edge.raId, rad, edge.hopIdx, serviceDay, candidates);
+              after = serviceDay * MinutesPerDay + rad.departures[edge.hopIdx];
+            }
+          }
+        }
+      }
+
+      const size_t maxDistinctRides = maxCount * PopsPerVariant;
+      size_t added = 0ULL;
+      unsigned untilLimitsCheck = 0U;
+      while(!candidates.empty() && e.found < maxCount && added < count) {
+        if(nullptr != limits && untilLimitsCheck-- == 0U) {
+          if(limits->exceeded()) {
+            interrupted = true;
+            break;
+          }
+          untilLimitsCheck = LabelsPerLimitsCheck - 1U;
+        }
+
+        const unsigned labelIdx = candidates.top().labelIdx;
+        candidates.pop();
+        const Label l = labels[labelIdx]; // labels might grow below
+
+        unsigned &seen = e.instances[mix(l.ridesHash, l.place)];
+        if(seen >= instancesPerRides)
+          continue;
+
+        if(seen++ == 0U) { // first instance of these rides
+          size_t &distinct = e.distinctRides[l.place * (allVia + 1U) + l.via];
+          if(distinct >= maxDistinctRides) {
+            seen = instancesPerRides;
+            continue;
+          }
+          ++distinct;
+
+          if(l.place == to) {
+            addVariant(labelIdx, results);
+            ++e.found;
+            ++added;
+            continue;
+          }
+        }
+
+        if(l.place == to || l.rides >= MaxRides)
+          continue;
+
+        // The closure of the footpaths makes consecutive walks unnecessary
+        if(walking && NoRide != l.raId)
+          addWalks(labelIdx, candidates);
+
+        // Changing vehicles needs the minimum transfer time of the place
+        const long after = l.arrival + g.minTransfers[l.place] - 1L;
+        for(size_t m = 0ULL; m < modesCount; ++m) {
+          for(const Edge &edge : g.outEdges[modes[m]][l.place]) {
+            if(edge.raId == l.raId) // no getting off and on the same vehicle
+              continue;
+
+            const RouteAlternativeData &rad = g.routeAlternatives.at(edge.raId);
+            if(avoidedRoute(rad))
+              continue;
+
+            long serviceDay = 0L;
+            if(bookableService(rad, edge.hopIdx, after, arriveLast, serviceDay))
+              addRides(labelIdx, edge.raId, rad, edge.hopIdx, serviceDay, candidates);
+          }
+        }
+      }
+      return added;
+    }
+  };
+
+  /// Realization of ISearchSession based on a Query
+  class TripPlanner::GraphMap::Session : public ISearchSession {
+  protected:
+    /// Keeps the occupancy inspected by query alive
+    const shared_ptr<const IOccupancyView> occupancy;
+
+    Query query; ///< the resumable search
+
+    /// The last page of each category
+    vector<unique_ptr<FlatResults>> pages;
+
+  public:
+    Session(const GraphMap &g, unsigned from, unsigned to,
+            size_t maxCountPerCategory,
+            const ITimeConstraints &timeConstraints,
+            const ISeatsConstraints *seatsConstraints,
+            const shared_ptr<const IOccupancyView> &occupancy_,
+            size_t transpModes, const IPlaceConstraints *placeConstraints) :
+        occupancy(occupancy_),
+        query(g, from, to, maxCountPerCategory, timeConstraints,
+              seatsConstraints, occupancy_.get(), transpModes, placeConstraints),
+        pages(variantCategories().size()) {}
+
+    /// @return true if the destination might be reachable from the origin
+    bool connected() const {
+      return query.connected();
+    }
+
+    const IVariants& nextPage(size_t categ, size_t pageSize) override {
+      if(categ >= pages.size())
+        throw out_of_range(string(__func__) + " invalid categ!");
+      if(pageSize == 0ULL)
+        throw invalid_argument(string(__func__) + " expects pageSize > 0!");
+
+      // The previous page of categ is released
+      unique_ptr<FlatResults> &page = pages[categ];
+      page = make_unique<FlatResults>(pageSize * 2ULL, pageSize);
+      if(query.connected())
+        query.resume(Category(categ), pageSize, *page);
+      return (*page)[categ];
+    }
+
+    bool exhausted(size_t categ) const override {
+      if(categ >= pages.size())
+        throw out_of_range(string(__func__) + " invalid categ!");
+
+      return !query.connected() || query.exhausted(Category(categ));
+    }
+  };
+
+  /**
+  Explores the graph from an origin towards all the places, filling
+  a row of the travel matrices or an isochrone. The earliest arrivals come
+  from a time-dependent Dijkstra over the rides, while the shortest distances
+  and the lowest prices ignore the timetables.
+  The buffers are reused for all the origins handled by the same task.
+  */
+  class TripPlanner::GraphMap::OneToAll {
+  protected:
+    typedef pair<long, unsigned> TimedPlace;    ///< arrival and place index
+    typedef pair<float, unsigned> CostedPlace;  ///< cost and place index
+
+    const GraphMap &g;
+
+    const long leaveFirst, leaveLast, arriveLast;
+
+    array<size_t, ModesCount> modes;  ///< indices of the allowed modes
+    size_t modesCount = 0ULL;         ///< count of the allowed modes
+    const bool walking; ///< walks between nearby places are allowed
+
+    vector<long> arrivals;   ///< earliest arrival at each place
+    vector<float> tripPrices;    ///< price of the earliest trip to each place
+    vector<float> tripDistances; ///< length of the earliest trip to each place
+    vector<float> distances; ///< shortest distance to each place
+    vector<float> prices;    ///< lowest price towards each place
+
+    /// Sets the earliest arrivals from origin,
+    /// together with the prices and the lengths of those trips
+    void exploreArrivals(unsigned origin) {
+      const size_t placesCount = g.placeIds.size();
+      arrivals.assign(placesCount, LONG_MAX);
+      tripPrices.assign(placesCount, numeric_limits<float>::infinity());
+      tripDistances.assign(placesCount, numeric_limits<float>::infinity());
+      priority_queue<TimedPlace, vector<TimedPlace>, greater<TimedPlace>> toVisit;
+      arrivals[origin] = leaveFirst - 1L;
+      tripPrices[origin] = tripDistances[origin] = 0.f;
+      toVisit.emplace(arrivals[origin], origin);
+      while(!toVisit.empty()) {
+        const long arrival = toVisit.top().first;
+        const unsigned place = toVisit.top().second;
+        toVisit.pop();
+        if(arrival > arrivals[place])
+          continue;
+
+        // Boarding at origin happens within the leave period; later boardings
+        // need the minimum transfer time of the place
+        const bool atOrigin = (place == origin);
+        const long after = atOrigin ? arrival : (arrival + g.minTransfers[place] - 1L),
+          latest = atOrigin ? leaveLast : arriveLast;
+        for(size_t m = 0ULL; m < modesCount; ++m) {
+          for(const Edge &edge : g.outEdges[modes[m]][place]) {
+            const RouteAlternativeData &rad = g.routeAlternatives.at(edge.raId);
+            long serviceDay = 0L;
+            if(!earliestService(rad, edge.hopIdx, after, latest, serviceDay))
+              continue;
+
+            const long dayStart = serviceDay * MinutesPerDay;
+            for(size_t j = edge.hopIdx, hops = rad.departures.size(); j < hops; ++j) {
+              const long reached = dayStart + rad.arrivals[j];
+              if(reached > arriveLast)
+                break;
+
+              const unsigned next = rad.stops[j + 1ULL];
+              if(reached < arrivals[next]) {
+                arrivals[next] = reached;
+                tripPrices[next] = tripPrices[place] +
+                  max(rad.route->fare(rad.routeStop(edge.hopIdx),
+                                      rad.routeStop(j + 1ULL), true), 0.f);
+                tripDistances[next] = tripDistances[place] +
+                  rad.rsi->legDistance(edge.hopIdx, j + 1ULL, rad.returnTrip);
+                toVisit.emplace(reached, next);
+              }
+            }
+          }
+        }
+
+        if(walking && !atOrigin) {
+          for(const Footpath &fp : g.footpaths[place]) {
+            const long reached = arrival + g.minTransfers[place] + fp.minutes;
+            if(reached <= arriveLast && reached < arrivals[fp.place]) {
+              arrivals[fp.place] = reached;
+              tripPrices[fp.place] = tripPrices[place];
+              tripDistances[fp.place] = tripDistances[place] + fp.distance;
+              toVisit.emplace(reached, fp.place);
+            }
+          }
+        }
+      }
+    }
+
+    /**
+    Sets the lowest costs from origin, regardless of the timetables.
+    @param costs the costs to set
+    @param rideCost the cost of riding rad from stop i to stop j;
+      negative when the ride is not allowed
+    @param walkCost the cost of a footpath
+    */
+    template<class RideCost, class WalkCost>
+    void exploreCosts(unsigned origin, vector<float> &costs,
+                      RideCost rideCost, WalkCost walkCost) const {
+      costs.assign(g.placeIds.size(), numeric_limits<float>::infinity());
+      priority_queue<CostedPlace, vector<CostedPlace>, greater<CostedPlace>> toVisit;
+      costs[origin] = 0.f;
+      toVisit.emplace(0.f, origin);
+      while(!toVisit.empty()) {
+        const float cost = toVisit.top().first;
+        const unsigned place = toVisit.top().second;
+        toVisit.pop();
+        if(cost > costs[place])
+          continue;
+
+        for(size_t m = 0ULL; m < modesCount; ++m) {
+          for(const Edge &edge : g.outEdges[modes[m]][place]) {
+            const RouteAlternativeData &rad = g.routeAlternatives.at(edge.raId);
+            for(size_t j = edge.hopIdx, hops = rad.departures.size(); j < hops; ++j) {
+              const float ride = rideCost(rad, edge.hopIdx, j + 1ULL);
+              if(ride < 0.f)
+                continue;
+
+              const unsigned next = rad.stops[j + 1ULL];
+              if(cost + ride < costs[next]) {
+                costs[next] = cost + ride;
+                toVisit.emplace(costs[next], next);
+              }
+            }
+          }
+        }
+
+        if(walking && place != origin) {
+          for(const Footpath &fp : g.footpaths[place]) {
+            const float reached = cost + walkCost(fp);
+            if(reached < costs[fp.place]) {
+              costs[fp.place] = reached;
+              toVisit.emplace(reached, fp.place);
+            }
+          }
+        }
+      }
+    }
+
+  public:
+    OneToAll(const GraphMap &g_, const ITimeConstraints &timeConstraints,
+             size_t transpModes) : g(g_),
+        leaveFirst(toMinutes(timeConstraints.leavePeriod().begin(), true)),
+        leaveLast(toMinutes(timeConstraints.leavePeriod().last(), false)),
+        arriveLast(toMinutes(timeConstraints.arrivePeriod().last(), false)),
+        walking((transpModes & size_t(TranspModes::FOOT)) != 0ULL) {
+      for(size_t m = 0ULL; m < ModesCount; ++m)
+        if((transpModes & (size_t(1ULL) << m)) != 0ULL)
+          modes[modesCount++] = m;
+    }
+
+    /// Fills in row the cells from the place with index origin
+    /// towards the places with the indices from columns
+    void fillRow(unsigned origin, const vector<unsigned> &columns,
+                 TravelMatrixCell *row) {
+      exploreArrivals(origin);
+      exploreCosts(origin, distances,
+                   [](const RouteAlternativeData &rad, size_t i, size_t j) {
+                     return float(rad.rsi->legDistance(i, j, rad.returnTrip));
+                   },
+                   [](const Footpath &fp) { return fp.distance; });
+      exploreCosts(origin, prices,
+                   [](const RouteAlternativeData &rad, size_t i, size_t j) {
+                     const float price = rad.route->fare(rad.routeStop(i),
+                                                         rad.routeStop(j), true);
+                     return (price > 0.f) ? price : -1.f;
+                   },
+                   [](const Footpath&) { return 0.f; });
+
+      for(size_t c = 0ULL, count = columns.size(); c < count; ++c) {
+        const unsigned dest = columns[c];
+        TravelMatrixCell &cell = row[c];
+        if(dest == origin) {
+          cell.earliestArrival = int64_t(leaveFirst - EpochMinutes);
+          cell.minDistance = cell.minPrice = 0.f;
+          continue;
+        }
+
+        cell.earliestArrival = (LONG_MAX == arrivals[dest]) ?
+          TravelMatrixCell::Unreachable : int64_t(arrivals[dest] - EpochMinutes);
+        cell.minDistance = distances[dest];
+        cell.minPrice = prices[dest];
+      }
+    }
+
+    /// Fills in cells the isochrone from the place with index origin
+    void fillIsochrone(unsigned origin, vector<IsochroneCell> &cells) {
+      exploreArrivals(origin);
+
+      const size_t placesCount = g.placeIds.size();
+      cells.resize(placesCount);
+      for(size_t p = 0ULL; p < placesCount; ++p) {
+        IsochroneCell &cell = cells[p];
+        cell.placeId = g.placeIds[p];
+        cell.earliestArrival = (p == origin) ?
+          int64_t(leaveFirst - EpochMinutes) :
+          (LONG_MAX == arrivals[p]) ? IsochroneCell::Unreachable :
+          int64_t(arrivals[p] - EpochMinutes);
+        cell.price = tripPrices[p];
+        cell.distance = tripDistances[p];
+      }
+    }
+  };
+
+  constexpr size_t TripPlanner::GraphMap::ModesCount;
+  constexpr int64_t TravelMatrixCell::Unreachable;
+  constexpr int64_t IsochroneCell::Unreachable;
+
+  size_t TripPlanner::GraphMap::modeIndex(size_t transpMode) {
+    for(size_t m = 0ULL; m < ModesCount; ++m)
+      if(transpMode == (size_t(1ULL) << m))
+        return m;
+
+    throw invalid_argument(string(__func__) +
+                           " expects a single known transportation mode!");
+  }
+
+  TripPlanner::GraphMap::GraphMap(InfoSource &infoSrc_) : infoSrc(infoSrc_) {
+		vector<unsigned> routeSharedInfoIds;
+		infoSrc.idsOfAllPlaces(placeIds);
+		infoSrc.idsOfAllRoutes(routeSharedInfoIds);
+
+    const size_t placesCount = placeIds.size();
+    for(size_t i = 0ULL; i < placesCount; ++i)
+      placeIndices[placeIds[i]] = unsigned(i);
+    for(size_t m = 0ULL; m < ModesCount; ++m) {
+      outEdges[m].resize(placesCount);
+      predecessors[m].resize(placesCount);
+    }
+
+    // Base date of the timetables
+    static const ptime timetableStart(from_simple_string("2017-Jan-1"s));
+
+		for(unsigned rsiId : routeSharedInfoIds) {
+			IRouteSharedInfo &rsi = infoSrc.routeSharedInfo(rsiId);
+			const size_t stopsCountM1 = rsi.stopsCount() - 1ULL;
+
+      // The normal fares between any 2 stops, computed as a single batch per class
+      RouteData &route = routes[rsiId];
+      vector<float> pairDistances;
+      pairDistances.reserve(stopsCountM1 * (stopsCountM1 + 1ULL) / 2ULL);
+      for(size_t j = 1ULL; j <= stopsCountM1; ++j)
+        for(size_t i = 0ULL; i < j; ++i)
+          pairDistances.push_back(rsi.legDistance(i, j, false));
+
+      ITicketPriceCalculator &pricing = rsi.pricingEngine();
+      route.economyFares.resize(pairDistances.size());
+      route.businessFares.resize(pairDistances.size());
+      pricing.normalFares(pairDistances.data(), pairDistances.size(),
+                          route.economyFares.data(), true);
+      pricing.normalFares(pairDistances.data(), pairDistances.size(),
+                          route.businessFares.data(), false);
+
+			for(unsigned raId : rsi.alternatives()) {
+				const IRouteAlternative &ra = infoSrc.routeAlternative(raId);
+        const bool returnTrip = ra.returnTrip();
+        const vector<time_period> &timetable = ra.timetable();
+        assert(timetable.size() == stopsCountM1);
+
+        RouteAlternativeData &rad = routeAlternatives[raId];
+        rad.ra = &ra;
+        rad.rsi = &rsi;
+        rad.route = &route;
+        rad.returnTrip = returnTrip;
+        rad.transpMode = int(rsi.transpMode());
+        const size_t mode = modeIndex(rsi.transpMode());
+        for(size_t i = 0ULL; i <= stopsCountM1; ++i)
+          rad.stops.push_back(placeIndices.at(rsi.nthStop(i, returnTrip)));
+
+        // The timetable follows the traversal order, even for return trips
+				for(size_t i = 0ULL; i < stopsCountM1; ++i) {
+          rad.departures.push_back(
+            (timetable[i].begin() - timetableStart).total_seconds() / 60L);
+          rad.arrivals.push_back(
+            (timetable[i].last() - timetableStart).total_seconds() / 60L);
+
+          outEdges[mode][rad.stops[i]].push_back(Edge { raId, unsigned(i) });
+          predecessors[mode][rad.stops[i + 1ULL]].push_back(rad.stops[i]);
+				}
+			}
+		}
+
+    static_assert(sizeof MinTransferMinutes / sizeof(long) == ModesCount,
+                  "MinTransferMinutes must cover all TranspModes!");
+    minTransfers.assign(placesCount, 1L); // departures strictly after arrivals
+    for(size_t m = 0ULL; m < ModesCount; ++m) {
+      for(size_t place = 0ULL; place < placesCount; ++place)
+        if(!outEdges[m][place].empty() || !predecessors[m][place].empty())
+          minTransfers[place] = max(minTransfers[place], MinTransferMinutes[m]);
+    }
+
+    for(vector<vector<unsigned>> &modePredecessors : predecessors) {
+      for(vector<unsigned> &prevPlaces : modePredecessors) {
+        sort(BOUNDS(prevPlaces));
+        prevPlaces.erase(unique(BOUNDS(prevPlaces)), end(prevPlaces));
+      }
+    }
+
+    buildFootpaths();
+	}
+
+  bool TripPlanner::GraphMap::earliestService(const RouteAlternativeData &rad,
+                                              unsigned hop, long after,
+                                              long latest, long &serviceDay) {
+    const long depOffset = rad.departures[hop];
+
+    // The smallest day with: day * MinutesPerDay + depOffset > after
+    long day = after + 1L - depOffset;
+    day = (day >= 0L) ? (day + MinutesPerDay - 1L) / MinutesPerDay :
+      -((-day) / MinutesPerDay);
+    for(; day * MinutesPerDay + depOffset <= latest; ++day) {
+      if(operatesOn(*rad.ra, dateOf(day))) {
+        serviceDay = day;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void TripPlanner::GraphMap::buildFootpaths() {
+    const size_t placesCount = placeIds.size();
+    vector<const GpsCoord<float>*> coords;
+    coords.reserve(placesCount);
+    for(unsigned id : placeIds)
+      coords.push_back(&infoSrc.getPlace(id).gpsCoord());
+
+    // Only the places with close latitudes need their distance computed
+    vector<unsigned> byLatitude(placesCount);
+    for(size_t i = 0ULL; i < placesCount; ++i)
+      byLatitude[i] = unsigned(i);
+    sort(BOUNDS(byLatitude), [&coords] (unsigned a, unsigned b) {
+      return coords[a]->latitude().get() < coords[b]->latitude().get();
+    });
+
+    const float maxLatitudeDiff = MaxFootpathKm / EarthMeanRadiusKm;
+    vector<vector<Footpath>> links(placesCount);
+    for(size_t i = 0ULL; i < placesCount; ++i) {
+      const unsigned a = byLatitude[i];
+      for(size_t j = i + 1ULL; j < placesCount; ++j) {
+        const unsigned b = byLatitude[j];
+        if(coords[b]->latitude().get() - coords[a]->latitude().get() >
+           maxLatitudeDiff)
+          break;
+
+        const float km = coords[a]->distanceTo(*coords[b]);
+        if(km > MaxFootpathKm)
+          continue;
+
+        const long minutes =
+          max(long(ceil(km * 60.f / WalkingKmPerHour)), 1L);
+        links[a].push_back(Footpath { b, minutes, km });
+        links[b].push_back(Footpath { a, minutes, km });
+      }
+    }
+
+    // Transitive closure: the shortest walks from each place,
+    // through any nearby places, up to MaxWalkMinutes
+    footpaths.assign(placesCount, vector<Footpath>());
+    vector<long> reachedIn(placesCount, LONG_MAX);
+    vector<float> walked(placesCount, 0.f);
+    for(size_t source = 0ULL; source < placesCount; ++source) {
+      if(links[source].empty())
+        continue;
+
+      typedef pair<long, unsigned> Step; // minutes and place
+      priority_queue<Step, vector<Step>, greater<Step>> toVisit;
+      vector<unsigned> touched { unsigned(source) };
+      reachedIn[source] = 0L;
+      toVisit.emplace(0L, unsigned(source));
+      while(!toVisit.empty()) {
+        const Step step = toVisit.top();
+        toVisit.pop();
+        if(step.first > reachedIn[step.second])
+          continue;
+
+        if(step.second != source)
+          footpaths[source].push_back(Footpath { step.second, step.first,
+                                                 walked[step.second] });
+        for(const Footpath &link : links[step.second]) {
+          const long minutes = step.first + link.minutes;
+          if(minutes > MaxWalkMinutes || minutes >= reachedIn[link.place])
+            continue;
+
+          if(LONG_MAX == reachedIn[link.place])
+            touched.push_back(link.place);
+          reachedIn[link.place] = minutes;
+          walked[link.place] = walked[step.second] + link.distance;
+          toVisit.emplace(minutes, link.place);
+        }
+      }
+
+      sort(BOUNDS(footpaths[source]),
+           [] (const Footpath &a, const Footpath &b) { return a.place < b.place; });
+      for(unsigned place : touched) {
+        reachedIn[place] = LONG_MAX;
+        walked[place] = 0.f;
+      }
+    }
+  }
+
+	unique_ptr<FlatResults>
+    TripPlanner::GraphMap::search(unsigned idFrom, unsigned idTo,
+                                  size_t maxCountPerCategory,
+                                  const ITimeConstraints &timeConstraints,
+                                  const ISeatsConstraints *seatsConstraints
+                                    /* = nullptr*/,
+                                  const IOccupancyView *occupancy
+                                    /* = nullptr*/,
+                                  size_t transpModes
+                                    /* = TranspModes::all*/,
+                                  const IPlaceConstraints *placeConstraints
+                                    /* = nullptr*/,
+                                  const ISearchLimits *limits/* = nullptr*/,
+                                  TaskPool *pool/* = nullptr*/) const {
+    const auto itFrom = placeIndices.find(idFrom),
+      itTo = placeIndices.find(idTo);
+    if(cend(placeIndices) == itFrom || cend(placeIndices) == itTo)
+      return nullptr;
+
+    Query query(*this, itFrom->second, itTo->second, maxCountPerCategory,
+                timeConstraints, seatsConstraints, occupancy, transpModes,
+                placeConstraints, limits);
+    if(!query.connected())
+      return nullptr;
+
+    // Records for the typical variants, so they seldom need to grow
+    const size_t categories = variantCategories().size(),
+      expectedVariants = categories * min(maxCountPerCategory, size_t(100ULL));
+    unique_ptr<FlatResults> results =
+      make_unique<FlatResults>(expectedVariants * 2ULL, expectedVariants);
+    if(nullptr != pool && pool->size() > 1ULL) {
+      // Every category explores a copy of the query, since a query
+      // shares its current labels among the categories
+      vector<unique_ptr<FlatResults>> partial(categories);
+      vector<char> stopped(categories, 0);
+      const size_t expectedPerCategory = expectedVariants / categories;
+      pool->parallelFor(categories, [&](size_t categ) {
+        Query categQuery(query);
+        partial[categ] = make_unique<FlatResults>(expectedPerCategory * 2ULL,
+                                                  expectedPerCategory);
+        categQuery.resume(Category(categ), maxCountPerCategory, *partial[categ]);
+        stopped[categ] = categQuery.stoppedByLimits() ? 1 : 0;
+      });
+      for(size_t categ = 0ULL; categ < categories; ++categ) {
+        results->appendVariants(categ, *partial[categ]);
+        if(stopped[categ] != 0)
+          results->markPartial();
+      }
+
+    } else {
+      // After reaching the limits, the remaining categories are skipped
+      for(size_t categ = 0ULL; categ < categories; ++categ) {
+        query.resume(Category(categ), maxCountPerCategory, *results);
+        query.release(Category(categ));
+        if(query.stoppedByLimits()) {
+          results->markPartial();
+          break;
+        }
+      }
+    }
+
+    bool foundAny = false;
+    for(size_t categ = 0ULL; categ < categories; ++categ)
+      foundAny = foundAny || results->variantsCount(categ) > 0ULL;
+
+    // Interrupted searches report their results, even when empty
+    if(!foundAny && !results->partial())
+      return nullptr;
+		return results;
+	}
+
+  unique_ptr<ISearchSession>
+    TripPlanner::GraphMap::startSession(unsigned idFrom, unsigned idTo,
+                                        size_t maxCountPerCategory,
+                                        const ITimeConstraints &timeConstraints,
+                                        const ISeatsConstraints *seatsConstraints,
+                                        const shared_ptr<const IOccupancyView>
+                                          &occupancy,
+                                        size_t transpModes
+                                          /* = TranspModes::all*/,
+                                        const IPlaceConstraints *placeConstraints
+                                          /* = nullptr*/) const {
+    const auto itFrom = placeIndices.find(idFrom),
+      itTo = placeIndices.find(idTo);
+    if(cend(placeIndices) == itFrom || cend(placeIndices) == itTo)
+      return nullptr;
+
+    unique_ptr<Session> session =
+      make_unique<Session>(*this, itFrom->second, itTo->second,
+                           maxCountPerCategory, timeConstraints,
+                           seatsConstraints, occupancy, transpModes,
+                           placeConstraints);
+    if(!session->connected())
+      return nullptr;
+    return move(session);
+  }
+
+  void TripPlanner::GraphMap::travelMatrix(const vector<unsigned> &ids,
+                                           TravelMatrixCell *cells,
+                                           const ITimeConstraints &timeConstraints,
+                                           size_t transpModes,
+                                           TaskPool *pool/* = nullptr*/) const {
+    vector<unsigned> indices;
+    indices.reserve(ids.size());
+    for(unsigned id : ids) {
+      const auto it = placeIndices.find(id);
+      if(cend(placeIndices) == it)
+        throw invalid_argument(string(__func__) + " got an unknown place id!");
+      indices.push_back(it->second);
+    }
+
+    const size_t n = indices.size();
+    if(n == 0ULL)
+      return;
+
+    if(nullptr == pool || pool->size() <= 1ULL || n == 1ULL) {
+      OneToAll explorer(*this, timeConstraints, transpModes);
+      for(size_t r = 0ULL; r < n; ++r)
+        explorer.fillRow(indices[r], indices, cells + r * n);
+      return;
+    }
+
+    // Each task keeps its explorer and takes the next unfilled row,
+    // so the slower origins don't delay the rows of the other tasks
+    atomic<size_t> nextRow(0ULL);
+    pool->parallelFor(min(pool->size(), n), [&](size_t) {
+      try {
+        OneToAll explorer(*this, timeConstraints, transpModes);
+        for(size_t r = nextRow++; r < n; r = nextRow++)
+          explorer.fillRow(indices[r], indices, cells + r * n);
+      } catch(...) {
+        nextRow = n; // the other tasks stop after their current row
+        throw;
+      }
+    });
+  }
+
+  void TripPlanner::GraphMap::isochrone(unsigned idFrom,
+                                        const ITimeConstraints &timeConstraints,
+                                        size_t transpModes,
+                                        vector<IsochroneCell> &cells) const {
+    const auto it = placeIndices.find(idFrom);
+    if(cend(placeIndices) == it)
+      throw invalid_argument(string(__func__) + " got an unknown place id!");
+
+    OneToAll explorer(*this, timeConstraints, transpModes);
+    explorer.fillIsochrone(it->second, cells);
+  }
+
+} // namespace tp
@@ -0,0 +1,303 @@
+/*****************************************************************************
+ TripPlanner explores various issues common to navigation and booking systems.
+
+ Copyrights from the libraries used by the program:
+ - (c) 2017 Boost (www.boost.org)
+		License: <http://www.boost.org/LICENSE_1_0.txt>
+ 
+ (c) 2017 Florin Tulba <florintulba@yahoo.com>
+
+ This program is free software: you can use its results,
+ redistribute it and/or modify it under the terms of the GNU
+ Affero General Public License version 3 as published by the
+ Free Software Foundation.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU Affero General Public License for more details.
+
+ You should have received a copy of the GNU Affero General Public License
+ along with this program ('agpl-3.0.txt').
+ If not, see <http://www.gnu.org/licenses/agpl-3.0.txt>.
+ *****************************************************************************/
+
+#ifndef H_GRAPH_MAP
+#define H_GRAPH_MAP
+
+#include "planner.h"
+#include "airfareCache.h"
+#include "flatResults.h"
+#include "transpModes.h"
+#include "travelMatrix.h"
+#include "taskPool.h"
+
+#pragma warning ( push, 0 )
+
+#include <array>
+#include <vector>
+#include <utility>
+#include <unordered_map>
+
+#pragma warning ( pop )
+
+namespace tp { // trip planner
+
+  /**
+  Handle class for building the map`s graph and resolving queries.
+
+  The normal fares between any 2 stops of a route are computed when
+  building the graph, so the searches only need to adjust the airplane fares
+  based on the urgency and the occupancy. The distance between any 2 stops is provided in
+  constant time by IRouteSharedInfo::legDistance.
+
+  The vertices are the places. Every hop of every route alternative is
+  an edge leaving the place where that hop starts.
+  An edge contains only the id of the route alternative and
+  the index of the hop when traversing that route alternative.
+  The edges are partitioned by transportation mode, so the searches
+  restricted to some modes never scan the edges of the other modes.
+
+  Changing vehicles at a place needs at least the minimum transfer time
+  of that place, which is the largest one among the modes serving the place
+  (a few minutes for roads and rails, more for ships and airplanes).
+  The places closer than a walking distance are linked by footpaths.
+  Their transitive closure is computed when building the graph, so a search
+  needs at most one walk between 2 rides. A walk leaves a place after
+  its minimum transfer time and appears within the variants as
+  a connection of mode TranspModes::FOOT. The searches excluding FOOT
+  ignore the footpaths.
+
+  A search explores the rides (one or more consecutive hops of the same
+  route alternative during the same service date) in a best-first order
+  for each of the categories from variantCategories().
+  Each partial trip carries a bitmask of the via places passed through.
+  Only the trips with all the bits set may end at the destination.
+  The rides stop before the avoided places, and the avoided routes
+  are never boarded.
+  The categories are independent explorations, so a search might
+  run them in parallel on the workers of a TaskPool.
+  */
+  class TripPlanner::GraphMap {
+  protected:
+    /// Count of the transportation modes from TranspModes
+    static constexpr size_t ModesCount = 5ULL;
+    static_assert((size_t(1ULL) << (ModesCount - 1ULL)) == specs::TranspModes::last,
+                  "ModesCount must match TranspModes!");
+
+    /// @return the index of a single transportation mode
+    /// @throw invalid_argument for combinations of modes or unknown modes
+    static size_t modeIndex(size_t transpMode);
+
+    /// Hop hopIdx of route alternative raId
+    struct Edge {
+      unsigned raId;    ///< id of the route alternative
+      unsigned hopIdx;  ///< index of the hop when traversing the route alternative
+    };
+
+    /**
+    Normal fares between any 2 stops of a route, shared by all its alternatives.
+    The stops are indexed in the normal order of the route.
+    */
+    struct RouteData {
+      /// Normal fares for economy / business class between stops i < j,
+      /// found at index j*(j-1)/2 + i (triangular tables)
+      std::vector<float> economyFares, businessFares;
+
+      /// @return the normal fare between the stops i != j
+      float fare(size_t i, size_t j, bool economyClass) const {
+        if(i > j)
+          std::swap(i, j);
+        const std::vector<float> &fares = economyClass ? economyFares : businessFares;
+        return fares[j * (j - 1ULL) / 2ULL + i];
+      }
+    };
+
+    /// Details of a route alternative, ordered as its hops are traversed
+    struct RouteAlternativeData {
+      const specs::IRouteAlternative *ra = nullptr;  ///< the route alternative
+      specs::IRouteSharedInfo *rsi = nullptr;        ///< its shared information
+      const RouteData *route = nullptr;  ///< the normal fares of the route
+      bool returnTrip = false;           ///< traverses the route in reversed order
+
+      std::vector<unsigned> stops;      ///< indices of the traversed places
+
+      /// Departure / arrival for each hop in minutes after
+      /// the midnight of the date when the route alternative starts
+      std::vector<long> departures, arrivals;
+
+      int transpMode = 0; ///< the transportation mode
+
+      /// @return the index within the route of the traversed stop `stop`
+      size_t routeStop(size_t stop) const {
+        return returnTrip ? (stops.size() - 1ULL - stop) : stop;
+      }
+    };
+
+    /// The provider of places, routes and schedules
+	  specs::InfoSource &infoSrc;
+
+    std::vector<unsigned> placeIds; ///< id of the place with a given index
+    std::unordered_map<unsigned, unsigned> placeIndices; ///< index of each place id
+
+    /// For each transportation mode, the edges leaving each place
+    std::array<std::vector<std::vector<Edge>>, ModesCount> outEdges;
+
+    /// For each transportation mode, the places with hops towards each place
+    std::array<std::vector<std::vector<unsigned>>, ModesCount> predecessors;
+
+    /// A walk towards a nearby place
+    struct Footpath {
+      unsigned place;   ///< index of the reached place
+      long minutes;     ///< duration of the walk
+      float distance;   ///< length of the walk (km)
+    };
+
+    /// Minimum minutes between arriving at each place and leaving it again
+    std::vector<long> minTransfers;
+
+    /// The places reachable on foot from each place, either directly
+    /// or through other nearby places, sorted by their index
+    std::vector<std::vector<Footpath>> footpaths;
+
+    /// The normal fares of each route by their id
+    std::unordered_map<unsigned, RouteData> routes;
+
+    /// Details of each route alternative by their id
+    std::unordered_map<unsigned, RouteAlternativeData> routeAlternatives;
+
+    /// The factors of the airplane fares, shared by the searches
+    mutable AirfareCache airfares;
+
+    /// Links the nearby places and completes the links with
+    /// the walks through intermediary places
+    void buildFootpaths();
+
+    /**
+    Finds the first service day of rad when hop departs after `after`,
+    but not after latest.
+    @return false if there is no such service day
+    */
+    static bool earliestService(const RouteAlternativeData &rad, unsigned hop,
+                                long after, long latest, long &serviceDay);
+
+    class OneToAll; ///< explores the graph from an origin towards all places
+
+    class Query;    ///< resolves a single search
+    class Session;  ///< provides the variants of a search page by page
+
+  public:
+    /// Builds the map`s graph
+	  GraphMap(specs::InfoSource &infoSrc_);
+
+    GraphMap(const GraphMap&) = delete;
+    GraphMap(GraphMap&&) = delete;
+    void operator=(const GraphMap&) = delete;
+    void operator=(GraphMap&&) = delete;
+
+    /**
+	  Searches for itinerary variants between the 2 places.
+
+	  @param idFrom id of the starting location
+	  @param idTo id of the destination location
+	  @param maxCountPerCategory maximum number of variants
+	  for each considered category (price, distance, duration, soonest at destination)
+	  @param timeConstraints the imposed periods when to leave and when to arrive
+    @param seatsConstraints when not nullptr, the connections need at least
+      seatsConstraints->persons() free seats within the chosen class
+    @param occupancy the occupied seats, considered by the airplane fares
+      and, when seatsConstraints is provided, by the availability of the seats
+    @param transpModes the allowed transportation modes (see TranspModes)
+    @param placeConstraints optional places to pass through or to avoid
+      and routes to avoid, enforced while exploring
+    @param limits when not nullptr, the search stops after exceeding them,
+      returning the variants found so far as partial results
+    @param pool when not nullptr, the categories are explored in parallel
+      by its workers. The variants are the same as for a sequential search
+
+	  @return the found variants for the trip if the places can be connected
+      or the search was interrupted; nullptr otherwise
+	  */
+	  std::unique_ptr<queries::FlatResults>
+      search(unsigned idFrom, unsigned idTo, size_t maxCountPerCategory,
+             const queries::ITimeConstraints &timeConstraints,
+             const queries::ISeatsConstraints *seatsConstraints = nullptr,
+             const bookings::IOccupancyView *occupancy = nullptr,
+             size_t transpModes = specs::TranspModes::all,
+             const queries::IPlaceConstraints *placeConstraints = nullptr,
+             const queries::ISearchLimits *limits = nullptr,
+             TaskPool *pool = nullptr) const;
+
+    /**
+    Starts a search between the 2 places whose variants are found on demand,
+    page by page, for each category. See ISearchSession.
+
+    @param idFrom id of the starting location
+    @param idTo id of the destination location
+    @param maxCountPerCategory maximum number of variants for each category
+      among all pages. The variants are the same as for search, but
+      the categories which are never inspected are never explored
+    @param timeConstraints the imposed periods when to leave and when to arrive
+    @param seatsConstraints when not nullptr, the connections need at least
+      seatsConstraints->persons() free seats within the chosen class.
+      It must outlive the session
+    @param occupancy the occupied seats, considered by the airplane fares
+      and, when seatsConstraints is provided, by the availability of the seats
+    @param transpModes the allowed transportation modes (see TranspModes)
+    @param placeConstraints optional places to pass through or to avoid
+      and routes to avoid. The session copies them
+
+    @return the session if the places might be connected; nullptr otherwise
+    */
+    std::unique_ptr<queries::ISearchSession>
+      startSession(unsigned idFrom, unsigned idTo, size_t maxCountPerCategory,
+                   const queries::ITimeConstraints &timeConstraints,
+                   const queries::ISeatsConstraints *seatsConstraints,
+                   const std::shared_ptr<const bookings::IOccupancyView>
+                     &occupancy,
+                   size_t transpModes = specs::TranspModes::all,
+                   const queries::IPlaceConstraints *placeConstraints
+                     = nullptr) const;
+
+    /**
+    Fills the origin-destination matrices of the given places.
+    Each origin needs a single exploration of the graph for all destinations,
+    instead of a search for each pair. The origins are spread among
+    the workers of pool, when provided.
+
+    @param placeIds ids of the origins and of the destinations
+    @param cells receives placeIds.size()^2 cells in row-major order
+    @param timeConstraints the period for leaving the origins
+      and the period for arriving at the destinations
+    @param transpModes the allowed transportation modes (see TranspModes)
+    @param pool the workers sharing the origins or nullptr for computing
+      the rows sequentially
+
+    @throw invalid_argument for unknown place ids
+    */
+    void travelMatrix(const std::vector<unsigned> &placeIds,
+                      queries::TravelMatrixCell *cells,
+                      const queries::ITimeConstraints &timeConstraints,
+                      size_t transpModes, TaskPool *pool = nullptr) const;
+
+    /**
+    Finds the earliest arrival at every place when leaving idFrom within
+    the leave period, using a single exploration of the graph.
+
+    @param idFrom id of the starting location
+    @param timeConstraints the period for leaving idFrom
+      and the period for arriving at the other places
+    @param transpModes the allowed transportation modes (see TranspModes)
+    @param cells receives a cell for each place, in the order of their index
+
+    @throw invalid_argument for an unknown idFrom
+    */
+    void isochrone(unsigned idFrom,
+                   const queries::ITimeConstraints &timeConstraints,
+                   size_t transpModes,
+                   std::vector<queries::IsochroneCell> &cells) const;
+  };
+
+} // namespace tp
+
+#endif // H_GRAPH_MAP
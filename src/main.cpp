@@ -24,6 +24,13 @@
 
 #include "planner.h"
 #include "jsonSource.h"
+#include "requestServer.h"
+
+#pragma warning ( push, 0 )
+
+#include <cstring>
+
+#pragma warning ( pop )
 
 using namespace std;
 using namespace boost::filesystem;
@@ -31,7 +38,45 @@ using namespace tp;
 using namespace tp::specs;
 using namespace tp::queries;
 
-int main(/*int argc, const char* argv[]*/) {
+/**
+Serves the requests described by RequestServer, loading the map only once.
+Without socketPath, the requests come from stdin and the responses go to stdout.
+*/
+static int serve(const char *socketPath) {
+  try {
+    // The planner keeps the source alive while serving
+    unique_ptr<JsonSource> infoSrc = make_unique<JsonSource>(path("input.json"));
+    const ResultsSerializer serializer(*infoSrc);
+    const TripPlanner tp(move(infoSrc));
+    const RequestServer server(tp, serializer);
+    if(nullptr == socketPath) {
+      server.serve(cin, cout);
+    } else {
+#ifndef _WIN32
+      server.serveUnixSocket(socketPath);
+#else // _WIN32
+      cerr<<"Unix domain sockets are not supported on this platform!"<<endl;
+      return 1;
+#endif // _WIN32
+    }
+  } catch(exception &e) {
+    cerr<<e.what()<<endl;
+    return 1;
+  }
+  return 0;
+}
+
+/**
+Usage:
+- TripPlanner : prompts for the ends of each trip
+- TripPlanner --serve : answers the JSON requests (1 per line) from stdin
+- TripPlanner --serve <socketPath> : answers the JSON requests
+  from the clients of a Unix domain socket, until SIGINT or SIGTERM
+*/
+int main(int argc, const char* argv[]) {
+  if(argc > 1 && strcmp(argv[1], "--serve") == 0)
+    return serve((argc > 2) ? argv[2] : nullptr);
+
   /*
   cout<<"Initial locale: "<<setlocale(LC_ALL, nullptr)<<endl;
   cout<<"Setting locale: "<<setlocale(LC_ALL, "utf-8")<<endl;
@@ -23,11 +23,22 @@
  *****************************************************************************/
 
 #include "planner.h"
+#include "graphMap.h"
 #include "constraints.h"
 #include "results.h"
 #include "place.h"
+#include "bookingSystem.h"
+#include "customDateTimeProcessor.h"
+#include "util.h"
+
+#pragma warning ( push, 0 )
+
+#include <algorithm>
+
+#pragma warning ( pop )
 
 using namespace std;
+using namespace boost::posix_time;
 
 namespace tp { // trip planner
   using namespace specs;
@@ -35,83 +46,71 @@ namespace tp { // trip planner
 
   static const TimeConstraints defaultConstraints;
 
-  /// Handle class for building the map`s graph and resolving queries
-  class TripPlanner::GraphMap {
-  protected:
-    /// The provider of places, routes and schedules
-	  InfoSource &infoSrc;
+  /// @throw invalid_argument if transpModes has no known modes or has unknown ones
+  static void checkTranspModes(size_t transpModes) {
+    if(transpModes == 0ULL || (transpModes & ~size_t(TranspModes::all)) != 0ULL)
+      throw invalid_argument(string(__func__) + " expects a combination of "
+                             "known transportation modes!");
+  }
 
-  public:
-    /// Builds the map`s graph
-	  GraphMap(InfoSource &infoSrc_) : infoSrc(infoSrc_) {
-		  vector<unsigned> placeIds, routeSharedInfoIds;
-		  infoSrc.idsOfAllPlaces(placeIds);
-		  infoSrc.idsOfAllRoutes(routeSharedInfoIds);
-
-		  for(unsigned placeId : placeIds) {
-			  // TODO: add vertex placeId to the graph
-		  }
-
-		  for(unsigned rsiId : routeSharedInfoIds) {
-			  IRouteSharedInfo &rsi = infoSrc.routeSharedInfo(rsiId);
-			  const vector<unsigned> &stops = rsi.traversedStops();
-			  const size_t stopsCountM1 = stops.size() - 1ULL;
-			  for(unsigned raId : rsi.alternatives()) {
-				  IRouteAlternative &ra = infoSrc.routeAlternative(raId);
-				  if(ra.returnTrip()) {
-					  for(size_t i = stopsCountM1; i > 0ULL; --i) {
-						  // TODO: add edge from stops[i] to stop[i-1]
-						  // The edge should contain only:
-						  // - raId - to provide access to the route information 
-						  // - (stopsCountM1-i) - to know the index of this stop when traversing the route
-					  }
-				  } else {
-					  for(size_t i = 0ULL; i < stopsCountM1; ++i) {
-						  // TODO: add edge from stops[i] to stop[i+1]
-						  // The edge should contain only:
-						  // - raId - to provide access to the route information 
-						  // - i - to know the index of this stop when traversing the route
-					  }
-				  }
-			  }
-		  }
-	  }
-
-    GraphMap(const GraphMap&) = delete;
-    GraphMap(GraphMap&&) = delete;
-    void operator=(const GraphMap&) = delete;
-    void operator=(GraphMap&&) = delete;
-    
-    /**
-	  Searches for itinerary variants between the 2 places.
-
-	  @param idFrom id of the starting location
-	  @param idTo id of the destination location
-	  @param maxCountPerCategory maximum number of variants
-	  for each considered category (price, distance, duration, soonest at destination)
-	  @param timeConstraints the imposed periods when to leave and when to arrive
-
-	  @return the found variants for the trip if the places can be connected; nullptr otherwise
-	  */
-	  unique_ptr<IResults> search(const unsigned idFrom,
-                                const unsigned idTo,
-                                size_t maxCountPerCategory,
-                                const ITimeConstraints &timeConstraints) const {
-		  unique_ptr<IResults> results = make_unique<Results>();
-		  return results;
-	  }
-  };
+  /// @return the occupancy from bookingSys when the search might inspect it
+  /// (for seatsConstraints or for airplane fares) or nullptr otherwise
+  static shared_ptr<const bookings::IOccupancyView>
+      occupancyFor(const bookings::IBookingSystem &bookingSys,
+                   const ISeatsConstraints *seatsConstraints,
+                   size_t transpModes) {
+    if(nullptr == seatsConstraints &&
+       (transpModes & size_t(TranspModes::AIR)) == 0ULL)
+      return nullptr;
+    return bookingSys.occupancyView();
+  }
 
   void TripPlanner::reset() {
     if(nullptr != g) {
       delete g;
       g = nullptr;
+
+      // Only the booked route alternatives need to be compared
+      const bookings::TravelConditionsById before =
+        bookingSys->bookedTravelConditions();
       infoSrc->reload();
+      affectedBookings = bookingSys->affectedBookings(before);
     }
 
     g = new GraphMap(*infoSrc);
+    ++generation;
+    resultsCache.clear();
   }
 
+  /// Forwards the pages of a GraphMap session while its graph is still valid
+  class TripPlanner::GuardedSession : public ISearchSession {
+  protected:
+    const TripPlanner &planner;       ///< the planner which started the session
+    const size_t generation;          ///< the generation of the graph of the session
+    unique_ptr<ISearchSession> session; ///< the session from the graph
+
+  public:
+    GuardedSession(const TripPlanner &planner_,
+                   unique_ptr<ISearchSession> session_) :
+      planner(planner_), generation(planner_.generation),
+      session(move(session_)) {}
+
+    const IVariants& nextPage(size_t categ, size_t pageSize) override {
+      shared_lock<shared_timed_mutex> sharedDataAccess(planner.dataAccess, 50ms);
+      if(!sharedDataAccess.owns_lock())
+        throw runtime_error(string(__func__) + " couldn't obtain data access!");
+      if(generation != planner.generation)
+        throw logic_error(string(__func__) + " - the session expired after "
+                          "an update of the specifications!");
+
+      return session->nextPage(categ, pageSize);
+    }
+
+    bool exhausted(size_t categ) const override {
+      return session->exhausted(categ);
+    }
+  };
+
   unsigned TripPlanner::pickPlace(const string &name,
                                   istream &promptStream/* = cin*/,
                                   ostream &outStream/* = cout*/) const {
@@ -161,16 +160,46 @@ namespace tp { // trip planner
     }
   }
 
-  TripPlanner::TripPlanner(unique_ptr<InfoSource> infoSrc_) :
-		  infoSrc(move(infoSrc_)) {
+  void TripPlanner::pickTripEnds(const string &fromPlace,
+                                 const string &toPlace,
+                                 unsigned &idFrom, unsigned &idTo) const {
+    idFrom = pickPlace(fromPlace);
+    idTo = pickPlace(toPlace);
+    if(idFrom == idTo) {
+      ostringstream oss;
+      oss<<"search should be called with fromPlace != toPlace, but `"
+        <<fromPlace<<"` and `"<<toPlace<<"` are aliases for the same place!";
+      throw invalid_argument(oss.str());
+    }
+  }
+
+  TripPlanner::TripPlanner(unique_ptr<InfoSource> infoSrc_,
+                           unique_ptr<bookings::BookingJournal>
+                             bookingJournal/* = nullptr*/,
+                           unsigned searchThreads/* = 1U*/,
+                           unsigned asyncThreads_/* = 0U*/,
+                           size_t maxQueuedSearches_/* = 1'000ULL*/) :
+		  infoSrc(move(infoSrc_)), asyncThreads(asyncThreads_),
+      maxQueuedSearches(maxQueuedSearches_) {
 	  if(nullptr == infoSrc)
 		  throw invalid_argument(string(__func__) + " expects non-null parameter!");
+    if(maxQueuedSearches == 0ULL)
+      throw invalid_argument(string(__func__) + " expects maxQueuedSearches_ > 0!");
+
+    if(searchThreads != 1U)
+      searchPool = make_unique<TaskPool>(searchThreads);
+
+    bookingSys = make_unique<bookings::BookingSystem>(*infoSrc,
+                                                      move(bookingJournal));
     
     dataAccess.lock(); // block data access until g is built
     allowDataAccess(); // build g and then allow data access
   }
 
   TripPlanner::~TripPlanner() {
+    // The pending asynchronous searches still need g
+    asyncSearches.reset();
+
     if(nullptr != g) {
       delete g;
       g = nullptr;
@@ -193,15 +222,26 @@ namespace tp { // trip planner
     }
   }
 
+  const set<unsigned>& TripPlanner::bookingsAffectedByLastUpdate() const {
+    return affectedBookings;
+  }
+
   unique_ptr<IResults> 
 	  TripPlanner::search(const string &fromPlace,
                         const string &toPlace,
                         size_t maxCountPerCategory,
                         const ITimeConstraints *timeConstraints
-                          /* = nullptr*/) const {
+                          /* = nullptr*/,
+                        const ISeatsConstraints *seatsConstraints
+                          /* = nullptr*/,
+                        size_t transpModes/* = TranspModes::all*/,
+                        const IPlaceConstraints *placeConstraints
+                          /* = nullptr*/,
+                        const ISearchLimits *limits/* = nullptr*/) const {
 	  if(fromPlace.compare(toPlace) == 0 || maxCountPerCategory == 0ULL) 
       throw invalid_argument(string(__func__) + " should be called with "
                              "fromPlace != toPlace and maxCountPerCategory > 0!");
+    checkTranspModes(transpModes);
 
     shared_lock<shared_timed_mutex> sharedDataAccess(dataAccess, 50ms);
     if(!sharedDataAccess.owns_lock())
@@ -210,15 +250,275 @@ namespace tp { // trip planner
 	  const ITimeConstraints &constraints =
 		  (nullptr != timeConstraints) ? *timeConstraints : defaultConstraints;
 
-    const unsigned idFrom = pickPlace(fromPlace), idTo = pickPlace(toPlace);
-    if(idFrom == idTo) {
-      ostringstream oss;
-      oss<<__func__<<" should be called with fromPlace != toPlace, but `"
-        <<fromPlace<<"` and `"<<toPlace<<"` are aliases for the same place!";
-      throw invalid_argument(oss.str());
+    unsigned idFrom, idTo;
+    pickTripEnds(fromPlace, toPlace, idFrom, idTo);
+
+    const long today = long(nowUTC().date().day_number());
+
+    // Explores the graph within the given constraints, remembering under key
+    // the results which don't depend on the timing of the search
+    const auto searchGraph = [&] (const ResultsCache::Key &key,
+                                  const ITimeConstraints &searchConstraints) {
+      // Any cancellation after reading the version, or any booking using
+      // the route alternatives of the results, prevents remembering them
+      const uint64_t cacheVersion = resultsCache.version();
+
+      // Searches don't block bookings: they read the occupancy without locking,
+      // which influences the airplane fares and, optionally, the seats availability
+      const shared_ptr<const bookings::IOccupancyView> occupancy =
+        occupancyFor(*bookingSys, seatsConstraints, transpModes);
+      unique_ptr<FlatResults> found =
+        g->search(idFrom, idTo, maxCountPerCategory, searchConstraints,
+                  seatsConstraints, occupancy.get(), transpModes,
+                  placeConstraints, limits, searchPool.get());
+
+      // Partial results depend on the timing of the search, so they aren't remembered
+      if(nullptr != found && found->partial())
+        return shared_ptr<const FlatResults>(move(found));
+      return resultsCache.insert(key, move(found), cacheVersion);
+    };
+
+    // Searches within the same time buckets share a search over the whole buckets
+    const TimeConstraints widened = ResultsCache::widened(constraints);
+    const ResultsCache::Key key =
+      ResultsCache::keyOf(idFrom, idTo, maxCountPerCategory, widened,
+                          seatsConstraints, transpModes, placeConstraints, today);
+    shared_ptr<const FlatResults> shared;
+    if(!resultsCache.find(key, shared))
+      shared = searchGraph(key, widened);
+
+    bool complete = true;
+    unique_ptr<IResults> results = ResultsCache::requested(
+      shared, constraints, maxCountPerCategory, complete);
+    if(complete || shared->partial())
+      return results;
+
+    // The variants from the margins of the buckets displaced some requested
+    // variants, so the exact constraints get their own search and entry
+    const ResultsCache::Key exactKey =
+      ResultsCache::keyOf(idFrom, idTo, maxCountPerCategory, constraints,
+                          seatsConstraints, transpModes, placeConstraints, today);
+    if(!resultsCache.find(exactKey, shared))
+      shared = searchGraph(exactKey, constraints);
+    return ResultsCache::requested(shared, constraints, maxCountPerCategory,
+                                   complete);
+  }
+
+  BoundedExecutor& TripPlanner::asyncExecutor() const {
+    call_once(asyncSearchesStarted, [this] {
+      asyncSearches = make_unique<BoundedExecutor>(asyncThreads,
+                                                   maxQueuedSearches);
+    });
+    return *asyncSearches;
+  }
+
+  void TripPlanner::searchAsync(const SearchCallback &onDone,
+                                const string &fromPlace, const string &toPlace,
+                                size_t maxCountPerCategory,
+                                const ITimeConstraints *timeConstraints
+                                  /* = nullptr*/,
+                                const ISeatsConstraints *seatsConstraints
+                                  /* = nullptr*/,
+                                size_t transpModes/* = TranspModes::all*/,
+                                const IPlaceConstraints *placeConstraints
+                                  /* = nullptr*/,
+                                const ISearchLimits *limits
+                                  /* = nullptr*/) const {
+    if(!onDone)
+      throw invalid_argument(string(__func__) + " expects a callback!");
+
+    // The caller may release its constraints as soon as this returns
+    struct Request {
+      SearchCallback onDone;
+      string fromPlace, toPlace;
+      size_t maxCountPerCategory, transpModes;
+      unique_ptr<TimeConstraints> timeConstraints;
+      unique_ptr<SeatsConstraints> seatsConstraints;
+      unique_ptr<PlaceConstraints> placeConstraints;
+      const ISearchLimits *limits;
+    };
+    const shared_ptr<Request> req = make_shared<Request>();
+    req->onDone = onDone;
+    req->fromPlace = fromPlace;
+    req->toPlace = toPlace;
+    req->maxCountPerCategory = maxCountPerCategory;
+    req->transpModes = transpModes;
+    if(nullptr != timeConstraints) {
+      const time_period &leave = timeConstraints->leavePeriod(),
+        &arrive = timeConstraints->arrivePeriod();
+      req->timeConstraints = make_unique<TimeConstraints>(
+        time_period(leave.begin(), leave.last()),
+        time_period(arrive.begin(), arrive.last()));
     }
+    if(nullptr != seatsConstraints)
+      req->seatsConstraints =
+        make_unique<SeatsConstraints>(seatsConstraints->persons(),
+                                      seatsConstraints->economyClass());
+    if(nullptr != placeConstraints)
+      req->placeConstraints =
+        make_unique<PlaceConstraints>(placeConstraints->viaPlaces(),
+                                      placeConstraints->avoidedPlaces(),
+                                      placeConstraints->avoidedRoutes());
+    req->limits = limits;
+
+    const bool accepted = asyncExecutor().trySubmit([this, req] {
+      unique_ptr<IResults> results;
+      exception_ptr failure;
+      try {
+        results = search(req->fromPlace, req->toPlace, req->maxCountPerCategory,
+                         req->timeConstraints.get(), req->seatsConstraints.get(),
+                         req->transpModes, req->placeConstraints.get(),
+                         req->limits);
+      } catch(...) {
+        failure = current_exception();
+      }
+      req->onDone(move(results), failure);
+    });
+    if(!accepted)
+      throw overflow_error(string(__func__) + " rejected the search, since "
+                           "too many searches are waiting!");
+  }
+
+  future<unique_ptr<IResults>>
+    TripPlanner::searchAsync(const string &fromPlace, const string &toPlace,
+                             size_t maxCountPerCategory,
+                             const ITimeConstraints *timeConstraints
+                               /* = nullptr*/,
+                             const ISeatsConstraints *seatsConstraints
+                               /* = nullptr*/,
+                             size_t transpModes/* = TranspModes::all*/,
+                             const IPlaceConstraints *placeConstraints
+                               /* = nullptr*/,
+                             const ISearchLimits *limits/* = nullptr*/) const {
+    // SearchCallback needs a copyable target, so the promise is shared
+    const shared_ptr<promise<unique_ptr<IResults>>> outcome =
+      make_shared<promise<unique_ptr<IResults>>>();
+    future<unique_ptr<IResults>> result = outcome->get_future();
+    searchAsync([outcome](unique_ptr<IResults> results, exception_ptr failure) {
+                  if(failure)
+                    outcome->set_exception(failure);
+                  else
+                    outcome->set_value(move(results));
+                }, fromPlace, toPlace, maxCountPerCategory, timeConstraints,
+                seatsConstraints, transpModes, placeConstraints, limits);
+    return result;
+  }
+
+  size_t TripPlanner::queuedSearches() const {
+    return asyncExecutor().queued();
+  }
+
+  unique_ptr<ISearchSession>
+    TripPlanner::searchSession(const string &fromPlace,
+                               const string &toPlace,
+                               size_t maxCountPerCategory,
+                               const ITimeConstraints *timeConstraints
+                                 /* = nullptr*/,
+                               const ISeatsConstraints *seatsConstraints
+                                 /* = nullptr*/,
+                               size_t transpModes
+                                 /* = TranspModes::all*/,
+                               const IPlaceConstraints *placeConstraints
+                                 /* = nullptr*/) const {
+	  if(fromPlace.compare(toPlace) == 0 || maxCountPerCategory == 0ULL) 
+      throw invalid_argument(string(__func__) + " should be called with "
+                             "fromPlace != toPlace and maxCountPerCategory > 0!");
+    checkTranspModes(transpModes);
+
+    shared_lock<shared_timed_mutex> sharedDataAccess(dataAccess, 50ms);
+    if(!sharedDataAccess.owns_lock())
+      throw runtime_error(string(__func__) + " couldn't obtain data access!");
+
+	  const ITimeConstraints &constraints =
+		  (nullptr != timeConstraints) ? *timeConstraints : defaultConstraints;
+
+    unsigned idFrom, idTo;
+    pickTripEnds(fromPlace, toPlace, idFrom, idTo);
+
+    unique_ptr<ISearchSession> session =
+      g->startSession(idFrom, idTo, maxCountPerCategory, constraints,
+                      seatsConstraints,
+                      occupancyFor(*bookingSys, seatsConstraints, transpModes),
+                      transpModes, placeConstraints);
+    if(nullptr == session)
+      return nullptr;
+    return make_unique<GuardedSession>(*this, move(session));
+  }
+
+  void TripPlanner::travelMatrix(const vector<string> &places,
+                                 TravelMatrixCell *cells, size_t cellsCount,
+                                 const ITimeConstraints *timeConstraints
+                                   /* = nullptr*/,
+                                 size_t transpModes/* = TranspModes::all*/) const {
+    if(cellsCount < places.size() * places.size())
+      throw length_error(string(__func__) + " needs places.size()^2 cells!");
+    checkTranspModes(transpModes);
+
+    shared_lock<shared_timed_mutex> sharedDataAccess(dataAccess, 50ms);
+    if(!sharedDataAccess.owns_lock())
+      throw runtime_error(string(__func__) + " couldn't obtain data access!");
+
+	  const ITimeConstraints &constraints =
+		  (nullptr != timeConstraints) ? *timeConstraints : defaultConstraints;
+
+    vector<unsigned> ids;
+    ids.reserve(places.size());
+    for(const string &place : places)
+      ids.push_back(pickPlace(place));
+
+    g->travelMatrix(ids, cells, constraints, transpModes, searchPool.get());
+  }
+
+  void TripPlanner::isochrone(const string &fromPlace, const ptime &departure,
+                              vector<IsochroneCell> &cells,
+                              const time_duration &budget/* =
+                                hours(366 * 24)*/,
+                              size_t transpModes/* = TranspModes::all*/) const {
+    if(budget <= time_duration(0, 0, 0))
+      throw invalid_argument(string(__func__) + " expects a positive budget!");
+    checkTranspModes(transpModes);
+
+    shared_lock<shared_timed_mutex> sharedDataAccess(dataAccess, 50ms);
+    if(!sharedDataAccess.owns_lock())
+      throw runtime_error(string(__func__) + " couldn't obtain data access!");
+
+    // Leaving and arriving anytime within the budget
+    const time_period withinBudget(departure,
+                                   min(budget, time_duration(hours(366 * 24))));
+    const TimeConstraints constraints(withinBudget, withinBudget);
+
+    g->isochrone(pickPlace(fromPlace), constraints, transpModes, cells);
+  }
+
+  bool TripPlanner::book(const vector<bookings::Leg> &legs, unsigned persons,
+                         unsigned &bookingId, unsigned &maxPersons) {
+    shared_lock<shared_timed_mutex> sharedDataAccess(dataAccess, 50ms);
+    if(!sharedDataAccess.owns_lock())
+      throw runtime_error(string(__func__) + " couldn't obtain data access!");
+
+    if(!bookingSys->book(legs, persons, bookingId, maxPersons))
+      return false;
+
+    // Only the results using the booked route alternatives are affected
+    vector<unsigned> raIds;
+    raIds.reserve(legs.size());
+    for(const bookings::Leg &leg : legs)
+      raIds.push_back(leg.raId);
+    sort(BOUNDS(raIds));
+    raIds.erase(unique(BOUNDS(raIds)), end(raIds));
+    resultsCache.invalidate(raIds);
+    return true;
+  }
+
+  void TripPlanner::cancel(unsigned bookingId, unsigned persons) {
+    shared_lock<shared_timed_mutex> sharedDataAccess(dataAccess, 50ms);
+    if(!sharedDataAccess.owns_lock())
+      throw runtime_error(string(__func__) + " couldn't obtain data access!");
+
+    bookingSys->cancel(bookingId, persons);
 
-	  return g->search(idFrom, idTo, maxCountPerCategory, constraints);
+    // The freed seats might improve any search
+    resultsCache.clear();
   }
 
 } // namespace tp
@@ -27,13 +27,27 @@
 
 #include "constraintsBase.h"
 #include "resultsBase.h"
+#include "searchSessionBase.h"
 #include "infoSource.h"
+#include "bookingJournal.h"
+#include "resultsCache.h"
+#include "transpModes.h"
+#include "travelMatrix.h"
+#include "taskPool.h"
+#include "boundedExecutor.h"
 
 #pragma warning ( push, 0 )
 
 #include <memory>
 #include <string>
+#include <vector>
+#include <mutex>
 #include <shared_mutex>
+#include <functional>
+#include <future>
+#include <exception>
+
+#include <boost/date_time/posix_time/posix_time_types.hpp>
 
 #pragma warning ( pop )
 
@@ -52,6 +66,9 @@ namespace tp { // trip planner
 	  class GraphMap;
 	  GraphMap *g = nullptr; ///< the actual planner
 
+    /// Reserves and releases the seats
+    std::unique_ptr<bookings::IBookingSystem> bookingSys;
+
     /**
     Allows controlling the access to data.
     When performing database updates / patching, the access is denied,
@@ -59,6 +76,35 @@ namespace tp { // trip planner
     */
     mutable std::shared_timed_mutex dataAccess;
 
+    /// The bookings whose travel conditions were changed by the last update
+    std::set<unsigned> affectedBookings;
+
+    /// Count of the rebuilds of g. The search sessions expire after a rebuild
+    size_t generation = 0ULL;
+
+    class GuardedSession; ///< search session which expires after rebuilding g
+
+    /**
+    The results of the latest searches.
+    Cleared when rebuilding g and after cancellations.
+    The bookings forget only the results using their route alternatives
+    */
+    mutable ResultsCache resultsCache;
+
+    /// The workers exploring the categories of a search in parallel;
+    /// nullptr for sequential searches
+    std::unique_ptr<TaskPool> searchPool;
+
+    const unsigned asyncThreads;      ///< count of the threads for searchAsync
+    const size_t maxQueuedSearches;   ///< largest backlog of searchAsync
+
+    /// Runs the searches from searchAsync; started by the first of them
+    mutable std::unique_ptr<BoundedExecutor> asyncSearches;
+    mutable std::once_flag asyncSearchesStarted; ///< starts asyncSearches once
+
+    /// @return asyncSearches, after starting it if necessary
+    BoundedExecutor& asyncExecutor() const;
+
     /// Rebuilds g from an updated infoSrc
     void reset();
 
@@ -68,20 +114,39 @@ namespace tp { // trip planner
                        std::istream &promptStream = std::cin,
                        std::ostream &outStream = std::cout) const;
 
+    /// Sets idFrom and idTo to the ids of the 2 places, picked by pickPlace
+    /// @throw invalid_argument if the names denote the same place
+    void pickTripEnds(const std::string &fromPlace, const std::string &toPlace,
+                      unsigned &idFrom, unsigned &idTo) const;
+
   public:
 	  /**
 	  Reads the provided `map` and builds the required graph.
 	
 	  @param infoSrc_ either a JsonSource or DbSource object
+    @param bookingJournal optional durable log of the bookings,
+      which also provides the bookings performed before a restart
+    @param searchThreads count of the threads sharing the categories
+      of each search and the origins of each travelMatrix;
+      1 for sequential searches and 0 for all the cores
+    @param asyncThreads_ count of the threads running the searches
+      from searchAsync; 0 for all the cores
+    @param maxQueuedSearches_ how many searches from searchAsync may wait
+      for a free thread before rejecting new ones
 	  */
-	  TripPlanner(std::unique_ptr<specs::InfoSource> infoSrc_);
+	  TripPlanner(std::unique_ptr<specs::InfoSource> infoSrc_,
+                std::unique_ptr<bookings::BookingJournal> bookingJournal = nullptr,
+                unsigned searchThreads = 1U, unsigned asyncThreads_ = 0U,
+                size_t maxQueuedSearches_ = 1'000ULL);
 
     TripPlanner(const TripPlanner&) = delete;
     TripPlanner(TripPlanner&&) = delete;
     void operator=(const TripPlanner&) = delete;
     void operator=(TripPlanner&&) = delete;
 
-    ~TripPlanner(); ///< ensure the release of g and the unlocking of dataAccess
+    /// Ensures the release of g and the unlocking of dataAccess,
+    /// after finishing the pending searches from searchAsync
+    ~TripPlanner();
 
     /**
     Manipulates or relies on dataAccess to control or get data access.
@@ -98,6 +163,14 @@ namespace tp { // trip planner
     */
     void allowDataAccess(bool allowed = true);
 
+    /**
+    @return the ids of the active bookings whose travel conditions
+    (timetable, operational days of a week, unavailable days) were changed
+    by the last update of the specifications, performed by allowDataAccess(true).
+    Should be inspected while the data access is not allowed
+    */
+    const std::set<unsigned>& bookingsAffectedByLastUpdate() const;
+
 	  /**
 	  Searches for itinerary variants between the 2 places.
 
@@ -107,18 +180,207 @@ namespace tp { // trip planner
 	    for each considered category (price, distance, duration, soonest at destination)
 	  @param timeConstraints the imposed periods when to leave and when to arrive
       or nullptr if unconstrained
+    @param seatsConstraints when not nullptr, the connections need at least
+      seatsConstraints->persons() free seats within the chosen class.
+      Otherwise, the availability of the seats is ignored.
+      The airplane fares consider the current occupancy of the flights
+    @param transpModes the allowed transportation modes, like
+      TranspModes::RAIL | TranspModes::ROAD. The other modes are never explored
+    @param placeConstraints when not nullptr, the places the variants
+      must pass through and the places and routes they must avoid.
+      The search never explores the trips breaking them
+    @param limits when not nullptr, a deadline and / or a cancellation token
+      for the search (see SearchLimits). Once exceeded, the search stops
+      and returns the best variants found until then, flagged as partial
+      (see IResults::partial)
 
-	  @return the found variants for the trip
+	  @return the found variants for the trip or nullptr if the places
+      cannot be connected under the given constraints.
+      Repeated equivalent searches reuse the results of the first one,
+      while no booking, cancellation or update affects them (see ResultsCache).
+      Partial results are never reused.
+      The searches with time constraints within the same buckets of
+      ResultsCache::BucketMinutes share a search over the whole buckets,
+      keeping only the variants within their own constraints
+      (see ResultsCache::widened and ResultsCache::requested)
     
     @throw invalid_argument when:
     - the specified locations don`t exist, or if they are not distinct
     - maxCountPerCategory is 0
+    - transpModes contains no known mode or contains unknown modes
+    - placeConstraints has more than IPlaceConstraints::MaxViaPlaces
+      distinct via places
     @throw runtime_error when dataAccess is not shared-lockable for 50ms
     */
 	  std::unique_ptr<queries::IResults>
       search(const std::string &fromPlace, const std::string &toPlace,
              size_t maxCountPerCategory,
-             const queries::ITimeConstraints *timeConstraints = nullptr) const;
+             const queries::ITimeConstraints *timeConstraints = nullptr,
+             const queries::ISeatsConstraints *seatsConstraints = nullptr,
+             size_t transpModes = specs::TranspModes::all,
+             const queries::IPlaceConstraints *placeConstraints = nullptr,
+             const queries::ISearchLimits *limits = nullptr) const;
+
+    /// Receives either the results of a search from searchAsync
+    /// or the exception thrown by that search
+    typedef std::function<void(std::unique_ptr<queries::IResults> results,
+                               std::exception_ptr failure)> SearchCallback;
+
+    /**
+    Enqueues a search performed later by one of the threads reserved
+    for the asynchronous searches. The parameters have the meaning
+    from search. The constraints are copied, except limits, which must
+    outlive the search. A deadline from limits covers the waiting
+    within the queue, too.
+
+    @param onDone receives the outcome of the search, on the thread
+      that performed it. It shouldn't block that thread for long
+
+    @throw overflow_error when maxQueuedSearches searches are already waiting.
+      Otherwise, the failures of the search reach onDone
+    */
+    void searchAsync(const SearchCallback &onDone,
+                     const std::string &fromPlace, const std::string &toPlace,
+                     size_t maxCountPerCategory,
+                     const queries::ITimeConstraints *timeConstraints = nullptr,
+                     const queries::ISeatsConstraints *seatsConstraints = nullptr,
+                     size_t transpModes = specs::TranspModes::all,
+                     const queries::IPlaceConstraints *placeConstraints = nullptr,
+                     const queries::ISearchLimits *limits = nullptr) const;
+
+    /**
+    Like the searchAsync from above, but the outcome of the search
+    is provided by the returned future.
+
+    @throw overflow_error when maxQueuedSearches searches are already waiting
+    */
+    std::future<std::unique_ptr<queries::IResults>>
+      searchAsync(const std::string &fromPlace, const std::string &toPlace,
+                  size_t maxCountPerCategory,
+                  const queries::ITimeConstraints *timeConstraints = nullptr,
+                  const queries::ISeatsConstraints *seatsConstraints = nullptr,
+                  size_t transpModes = specs::TranspModes::all,
+                  const queries::IPlaceConstraints *placeConstraints = nullptr,
+                  const queries::ISearchLimits *limits = nullptr) const;
+
+    /// @return the count of the searches from searchAsync waiting for a free thread
+    size_t queuedSearches() const;
+
+    /**
+	  Starts a search between the 2 places whose variants are found on demand,
+    page by page, for each category. See ISearchSession.
+    The pages provide the same variants as search, but the searches for
+    the categories which are never inspected are never performed.
+
+    The session sees the live occupancy of the seats.
+    Each page needs data access, like search. After an update of
+    the specifications (see allowDataAccess), the session expires and
+    its nextPage throws logic_error.
+    The session must not outlive the planner.
+
+	  @param fromPlace starting location
+	  @param toPlace destination location
+	  @param maxCountPerCategory maximum number of variants
+	    for each category among all pages
+	  @param timeConstraints the imposed periods when to leave and when to arrive
+      or nullptr if unconstrained
+    @param seatsConstraints when not nullptr, the connections need at least
+      seatsConstraints->persons() free seats within the chosen class.
+      It must outlive the session
+    @param transpModes the allowed transportation modes
+    @param placeConstraints the optional places to pass through or to avoid
+      and the routes to avoid
+
+	  @return the session or nullptr if the places cannot be connected
+
+    @throw invalid_argument in the same cases as search
+    @throw runtime_error when dataAccess is not shared-lockable for 50ms
+    */
+	  std::unique_ptr<queries::ISearchSession>
+      searchSession(const std::string &fromPlace, const std::string &toPlace,
+                    size_t maxCountPerCategory,
+                    const queries::ITimeConstraints *timeConstraints = nullptr,
+                    const queries::ISeatsConstraints *seatsConstraints = nullptr,
+                    size_t transpModes = specs::TranspModes::all,
+                    const queries::IPlaceConstraints *placeConstraints
+                      = nullptr) const;
+
+    /**
+    Computes the travel matrices among the given places: the earliest arrival,
+    the shortest distance and the lowest normal economy price
+    from each place towards each place.
+    Each origin explores the graph only once for all the destinations.
+    The origins are shared by the searchThreads from the constructor.
+
+    @param places the origins and the destinations, picked like in search
+    @param cells receives places.size()^2 cells in row-major order:
+      the cell for origin i and destination j is cells[i * places.size() + j]
+    @param cellsCount the capacity of cells
+    @param timeConstraints the imposed periods when to leave the origins and
+      when to arrive at the destinations or nullptr if unconstrained
+    @param transpModes the allowed transportation modes
+
+    @throw length_error when cellsCount < places.size()^2
+    @throw invalid_argument for unknown places or transportation modes
+    @throw runtime_error when dataAccess is not shared-lockable for 50ms
+    */
+    void travelMatrix(const std::vector<std::string> &places,
+                      queries::TravelMatrixCell *cells, size_t cellsCount,
+                      const queries::ITimeConstraints *timeConstraints = nullptr,
+                      size_t transpModes = specs::TranspModes::all) const;
+
+    /**
+    Finds the earliest arrival at every place reachable from fromPlace
+    when leaving no sooner than departure, together with the price and
+    the length of the trip arriving first. A single exploration of the graph
+    covers all the places and no variants are built.
+
+    @param fromPlace starting location
+    @param departure the moment from when to leave fromPlace
+    @param cells receives a cell for each place of the map
+    @param budget how long after departure the places might be reached.
+      It is limited to a year, like all the trips
+    @param transpModes the allowed transportation modes
+
+    @throw invalid_argument for an unknown fromPlace or transportation modes
+      or for a budget that isn't positive
+    @throw runtime_error when dataAccess is not shared-lockable for 50ms
+    */
+    void isochrone(const std::string &fromPlace,
+                   const boost::posix_time::ptime &departure,
+                   std::vector<queries::IsochroneCell> &cells,
+                   const boost::posix_time::time_duration &budget =
+                     boost::posix_time::hours(366 * 24),
+                   size_t transpModes = specs::TranspModes::all) const;
+
+    /**
+    Attempts to reserve seats for `persons` on every leg from `legs`.
+    Either all legs get reserved, or none of them.
+
+    @param legs the legs of the trip
+    @param persons how many persons travel together
+    @param bookingId receives the id of the new booking when successful
+    @param maxPersons receives the largest number of persons
+      that could have booked these legs during the attempt
+
+    @return true if all legs were reserved; false if there were not enough seats
+
+    @throw invalid_argument for empty legs, 0 persons or
+      legs whose route alternative doesn't operate on the given date
+    @throw domain_error for unknown route alternatives
+    @throw runtime_error when dataAccess is not shared-lockable for 50ms
+    */
+    bool book(const std::vector<bookings::Leg> &legs, unsigned persons,
+              unsigned &bookingId, unsigned &maxPersons);
+
+    /**
+    Cancels the tickets of `persons` from the booking with bookingId.
+
+    @throw invalid_argument for unknown bookingId,
+      or when persons is 0 or larger than the still booked persons
+    @throw runtime_error when dataAccess is not shared-lockable for 50ms
+    */
+    void cancel(unsigned bookingId, unsigned persons);
   };
 
 } // namespace tp
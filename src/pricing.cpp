@@ -27,6 +27,8 @@
 #pragma warning ( push, 0 )
 
 #include <cmath>
+#include <cstdint>
+#include <cstring>
 #include <algorithm>
 #include <stdexcept>
 
@@ -34,6 +36,50 @@
 
 using namespace std;
 
+namespace {
+  const float Ln2 = 0.693147181f;
+  const int32_t SqrtHalfBits = 0x3F3504F3; ///< the bits of the float sqrt(0.5)
+  const float SqrtTwoMinus1 = 0.414213562f;
+
+  /**
+  Branch-free approximation of ln(1+x) for x >= 0, with a relative error
+  below 5e-7 (see TicketPriceCalculator).
+  Since ln(1+x) = 2 * atanh(s) for s = x / (2+x), a short odd polynomial
+  in s suffices while |s| stays below 3 - 2*sqrt(2).
+  Small x use that s directly, as 1+x would lose the low bits of x.
+  Larger x split 1+x into m * 2^e, with m within [sqrt(0.5), sqrt(2)),
+  and use s = (m-1) / (m+1). No step relies on cancellations,
+  so the bound holds under -ffast-math, too.
+  */
+  inline float fastLog1p(float x) {
+    const float y = 1.f + x;
+    int32_t bits;
+    memcpy(&bits, &y, sizeof bits);
+    bits -= SqrtHalfBits; // m gets shifted within [sqrt(0.5), sqrt(2))
+    const int32_t e = bits >> 23;
+    bits = (bits & 0x007FFFFF) + SqrtHalfBits;
+    float m;
+    memcpy(&m, &bits, sizeof m);
+
+    const bool small = x < SqrtTwoMinus1;
+    const float mMinus1 = m - 1.f, // exact for m within [0.5, 2]
+      numerator = small ? x : mMinus1,
+      s = numerator / (numerator + 2.f), s2 = s * s,
+      exponentTerm = small ? 0.f : (float)e * Ln2;
+    return exponentTerm + 2.f * s * (1.f + s2 * (1.f/3.f + s2 * (1.f/5.f +
+      s2 * (1.f/7.f + s2 * (1.f/9.f)))));
+  }
+
+  /// @return how many of the count values are 0 or negative.
+  /// Counting (instead of returning early) keeps the loop vectorizable
+  inline unsigned nonPositiveCount(const float *values, size_t count) {
+    unsigned result = 0U;
+    for(size_t i = 0ULL; i < count; ++i)
+      result += (values[i] <= 0.f) ? 1U : 0U;
+    return result;
+  }
+} // anonymous namespace
+
 // namespace trip planner - specifications
 namespace tp { namespace specs {
 
@@ -66,21 +112,44 @@ namespace tp { namespace specs {
 	  return log1pf(k * tripDistance);
   }
 
-  /// @return ln(1 + k * tripDistance) *
-  /// (lowFareFactor + (highFareFactor - lowFareFactor) *
-  /// (e^max(urgency, occupancy) - 1) / (e - 1))
+  /// @return ln(1 + k * tripDistance) * airplaneFareFactor(urgency, occupancy)
   float TicketPriceCalculator::airplaneFare(float tripDistance,
                                             float urgency, float occupancy,
                                             bool economyClass/* = true*/) {
 	  const float basePrice = normalFare(tripDistance, economyClass);
+	  return basePrice * airplaneFareFactor(urgency, occupancy);
+  }
 
+  /// @return lowFareFactor + (highFareFactor - lowFareFactor) *
+  /// (e^max(urgency, occupancy) - 1) / (e - 1)
+  float TicketPriceCalculator::airplaneFareFactor(float urgency,
+                                                  float occupancy) {
 	  if(urgency < 0.f || urgency > 1.f || occupancy < 0.f || occupancy > 1.f)
 		  throw invalid_argument(string(__func__) + " expects urgency and occupancy "
                              "parameters within [0,1] range!");
 
-	  return basePrice * (lowFareFactor +
+	  return lowFareFactor +
 						  (highFareFactor - lowFareFactor) *
-						  expm1f(max(urgency, occupancy)) / expm1f(1.f));
+						  expm1f(max(urgency, occupancy)) / expm1f(1.f);
+  }
+
+  void TicketPriceCalculator::normalFares(const float *tripDistances,
+                                          size_t count, float *fares,
+                                          bool economyClass/* = true*/) {
+    if(count == 0ULL)
+      return;
+
+    if(nullptr == tripDistances || nullptr == fares)
+      throw invalid_argument(string(__func__) + " expects non-null arrays!");
+
+    // Validating the whole batch first keeps the loop below free of branches
+    if(nonPositiveCount(tripDistances, count) > 0U)
+      throw invalid_argument(string(__func__) + " expects only strictly positive "
+                             "tripDistances!");
+
+    const float k = economyClass ? kEconomy : kBusiness;
+    for(size_t i = 0ULL; i < count; ++i)
+      fares[i] = fastLog1p(k * tripDistances[i]);
   }
 
 }} // namespace tp::specs
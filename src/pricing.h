@@ -41,6 +41,18 @@ namespace tp { namespace specs {
   to provide boundaries for the ticket price. A formula might be:
   normalFare * (lowFareFactor + (highFareFactor - lowFareFactor) *
   (e^max(urgency, occupancy) - 1) / (e - 1))
+
+  The batch methods validate their whole input before computing anything
+  and then use branch-free loops which the compiler can vectorize.
+  Instead of log1pf and expm1f, these loops use polynomial approximations:
+  - ln(1+x) = e*ln(2) + 2*atanh((m-1)/(m+1)), where 1+x = m * 2^e and
+    m is within [sqrt(0.5), sqrt(2)). The atanh series is truncated
+    after the term of degree 7 and the rounding of 1+x is compensated,
+    leaving a relative error below 5e-7
+  - e^x - 1 for x within [0,1] is the Taylor series truncated after
+    the term of degree 10, leaving an absolute error below 1e-7
+  Together with the float rounding, the relative error of the batch fares
+  stays below 1e-5.
   */
   class TicketPriceCalculator : public ITicketPriceCalculator {
   protected:
@@ -78,6 +90,29 @@ namespace tp { namespace specs {
 	  float airplaneFare(float tripDistance,
                        float urgency, float occupancy,
                        bool economyClass = true) override;
+
+	  /**
+	  The factor applied to the normal fare by airplaneFare.
+	  Throws invalid_argument when urgency / occupancy are outside [0,1] range.
+
+	  @param urgency how soon is the booked flight (1=today, 0=one year from now)
+	  @param occupancy percentage of occupied seats after the current booking
+	  */
+	  float airplaneFareFactor(float urgency, float occupancy) override;
+
+	  /**
+	  Batch version of normalFare, computing fares[i] for tripDistances[i].
+	  The results may differ from normalFare by a relative error below 1e-5.
+	  Throws invalid_argument when any of the distances is 0 or negative,
+	  in which case fares isn't modified.
+
+	  @param tripDistances distances covered by the tickets
+	  @param count the number of tickets
+	  @param fares receives the count fares
+	  @param economyClass true for economy class; false for business class
+	  */
+	  void normalFares(const float *tripDistances, size_t count,
+                     float *fares, bool economyClass = true) override;
   };
 
 }} // namespace tp::specs
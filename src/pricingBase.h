@@ -25,6 +25,12 @@
 #ifndef H_PRICING_BASE
 #define H_PRICING_BASE
 
+#pragma warning ( push, 0 )
+
+#include <cstddef>
+
+#pragma warning ( pop )
+
 // namespace trip planner - specifications
 namespace tp { namespace specs {
 
@@ -65,6 +71,29 @@ namespace tp { namespace specs {
 	  virtual float airplaneFare(float tripDistance,
                                float urgency, float occupancy,
                                bool economyClass = true) = 0;
+
+	  /**
+	  The factor applied to the normal fare by airplaneFare.
+	  Throws invalid_argument when urgency / occupancy are outside [0,1] range.
+
+	  @param urgency how soon is the booked flight (1=today, 0=one year from now)
+	  @param occupancy percentage of occupied seats after the current booking
+	  */
+	  virtual float airplaneFareFactor(float urgency, float occupancy) = 0;
+
+	  /**
+	  Batch version of normalFare, computing fares[i] for tripDistances[i].
+	  The results may differ from normalFare by a relative error below 1e-5.
+	  Throws invalid_argument when any of the distances is 0 or negative,
+	  in which case fares isn't modified.
+
+	  @param tripDistances distances covered by the tickets
+	  @param count the number of tickets
+	  @param fares receives the count fares
+	  @param economyClass true for economy class; false for business class
+	  */
+	  virtual void normalFares(const float *tripDistances, size_t count,
+                             float *fares, bool economyClass = true) = 0;
   };
 
 }} // namespace tp::specs
@@ -0,0 +1,522 @@
+/*****************************************************************************
+ TripPlanner explores various issues common to navigation and booking systems.
+
+ Copyrights from the libraries used by the program:
+ - (c) 2017 Boost (www.boost.org)
+		License: <http://www.boost.org/LICENSE_1_0.txt>
+ 
+ (c) 2017 Florin Tulba <florintulba@yahoo.com>
+
+ This program is free software: you can use its results,
+ redistribute it and/or modify it under the terms of the GNU
+ Affero General Public License version 3 as published by the
+ Free Software Foundation.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU Affero General Public License for more details.
+
+ You should have received a copy of the GNU Affero General Public License
+ along with this program ('agpl-3.0.txt').
+ If not, see <http://www.gnu.org/licenses/agpl-3.0.txt>.
+ *****************************************************************************/
+
+#include "requestServer.h"
+#include "constraints.h"
+#include "transpModes.h"
+
+#pragma warning ( push, 0 )
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <boost/optional.hpp>
+#include <boost/property_tree/ptree.hpp>
+#include <boost/property_tree/json_parser.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif // _WIN32
+
+#pragma warning ( pop )
+
+using namespace std;
+using namespace boost::posix_time;
+using namespace boost::property_tree;
+
+namespace {
+  /// Largest count of unanswered requests from a client. Reading its next
+  /// requests waits meanwhile, instead of overloading the planner
+  const size_t MaxPendingPerClient = 64ULL;
+
+  /// Longest accepted request. The longer ones get an error response,
+  /// so a client never sending a newline can't exhaust the memory
+  const size_t MaxRequestLength = 64ULL * 1'024ULL;
+
+#ifndef _WIN32
+  /// Largest count of clients served at once. Further connections wait
+  /// in the backlog of the socket until a client leaves
+  const size_t MaxClients = 128ULL;
+
+  /// Write end of the pipe waking serveUnixSocket for an orderly shutdown
+  volatile sig_atomic_t stopWriter = -1;
+
+  /// Handles SIGINT and SIGTERM while serving a socket
+  void requestStop(int) {
+    const int savedErrno = errno;
+    const char wake = 0;
+    if(stopWriter >= 0 && write(stopWriter, &wake, 1ULL) < 0)
+      {} // a full pipe wakes serveUnixSocket anyway
+    errno = savedErrno;
+  }
+#endif // _WIN32
+
+  /// Initial size of the buffer for serializing results
+  const size_t ResultsBufferSize = 64ULL * 1'024ULL;
+
+  /// @return s as a JSON string literal
+  string quoted(const string &s) {
+    static const char hexDigits[] = "0123456789abcdef";
+    string result(1ULL, '"');
+    for(char ch : s) {
+      if(ch == '"' || ch == '\\') {
+        result += '\\';
+        result += ch;
+      } else if((unsigned char)ch < 0x20U) {
+        result += "\\u00";
+        result += hexDigits[(unsigned char)ch >> 4];
+        result += hexDigits[(unsigned char)ch & 0xFU];
+      } else {
+        result += ch;
+      }
+    }
+    result += '"';
+    return result;
+  }
+
+  /// @return the response reporting error for the request with the given id
+  string errorLine(const string &id, const string &error) {
+    return "{\"id\":" + quoted(id) + ",\"error\":" + quoted(error) + '}';
+  }
+
+  /// @return true for lines with only whitespace
+  bool blank(const string &line) {
+    return line.find_first_not_of(" \t\r") == string::npos;
+  }
+
+  /// Splits the data received from a client into requests, one per line
+  class RequestLines {
+  protected:
+    const function<void(const string&)> onRequest;  ///< handles a request
+    const function<void()> onOverlong;  ///< reports a too long request
+    string pendingData;       ///< the start of the incomplete request
+    bool discarding = false;  ///< skipping the rest of a too long request
+
+    /// Handles the line, unless it is blank or too long
+    void complete(const string &line) const {
+      if(line.size() > MaxRequestLength)
+        onOverlong();
+      else if(!blank(line))
+        onRequest(line);
+    }
+
+  public:
+    RequestLines(function<void(const string&)> onRequest_,
+                 function<void()> onOverlong_) :
+      onRequest(move(onRequest_)), onOverlong(move(onOverlong_)) {}
+
+    /// Handles the requests completed by the count bytes from data
+    void received(const char *data, size_t count) {
+      pendingData.append(data, count);
+      size_t lineStart = 0ULL;
+      for(size_t lineEnd = pendingData.find('\n');
+          lineEnd != string::npos;
+          lineEnd = pendingData.find('\n', lineStart)) {
+        if(discarding)
+          discarding = false; // the end of the too long request
+        else
+          complete(pendingData.substr(lineStart, lineEnd - lineStart));
+        lineStart = lineEnd + 1ULL;
+      }
+      pendingData.erase(0ULL, lineStart);
+
+      if(pendingData.size() > MaxRequestLength) {
+        if(!discarding)
+          onOverlong();
+        discarding = true;
+        pendingData.clear();
+      }
+    }
+
+    /// Handles the last request, which might miss its newline
+    void closed() {
+      if(!discarding)
+        complete(pendingData);
+      pendingData.clear();
+    }
+  };
+} // anonymous namespace
+
+namespace tp { // trip planner
+  using namespace specs;
+  using namespace queries;
+
+  /// Writes the responses of a client one at a time and counts its pending requests
+  class RequestServer::Channel {
+  protected:
+    const function<void(const string&)> write; ///< writes a response line
+    mutex guard;              ///< serializes the writes and protects pending
+    condition_variable freed; ///< notified when a request was answered
+    size_t pending = 0ULL;    ///< count of the unanswered requests
+
+  public:
+    explicit Channel(function<void(const string&)> write_) :
+      write(move(write_)) {}
+
+    /// Writes a response for a request that was never pending
+    void send(const string &line) {
+      lock_guard<mutex> lock(guard);
+      write(line);
+    }
+
+    /// Waits until the client has less than maxPending unanswered requests,
+    /// then counts a new pending one
+    void started(size_t maxPending) {
+      unique_lock<mutex> lock(guard);
+      freed.wait(lock, [this, maxPending] { return pending < maxPending; });
+      ++pending;
+    }
+
+    /// Writes the response of a pending request
+    void finished(const string &line) {
+      lock_guard<mutex> lock(guard);
+      write(line);
+      --pending;
+      freed.notify_all();
+    }
+
+    /// Waits until all the requests were answered
+    void waitIdle() {
+      unique_lock<mutex> lock(guard);
+      freed.wait(lock, [this] { return pending == 0ULL; });
+    }
+  };
+
+  RequestServer::RequestServer(const TripPlanner &planner_,
+                               const ResultsSerializer &serializer_) :
+    planner(planner_), serializer(serializer_) {}
+
+  void RequestServer::handle(const string &request,
+                             const shared_ptr<Channel> &channel) const {
+    string id;
+    try {
+      ptree query;
+      istringstream iss(request);
+      read_json(iss, query);
+      id = query.get<string>("id", "");
+
+      const string from = query.get<string>("from"),
+        to = query.get<string>("to");
+      const size_t count = query.get<size_t>("count", 4ULL),
+        modes = query.get<size_t>("modes", size_t(TranspModes::all));
+
+      unique_ptr<TimeConstraints> timeConstraints;
+      const boost::optional<string> leave = query.get_optional<string>("leave");
+      if(leave) {
+        const ptime leaveFirst = time_from_string(*leave);
+        timeConstraints = make_unique<TimeConstraints>(
+          time_period(leaveFirst, hours(query.get<long>("leaveHours", 24L))),
+          time_period(leaveFirst, hours(query.get<long>("arriveHours", 48L))));
+      }
+
+      // The limits must outlive the search
+      shared_ptr<const SearchLimits> limits;
+      const boost::optional<long long> timeoutMs =
+        query.get_optional<long long>("timeoutMs");
+      if(timeoutMs)
+        limits = make_shared<const SearchLimits>(chrono::milliseconds(*timeoutMs));
+
+      channel->started(MaxPendingPerClient);
+      try {
+        planner.searchAsync([this, channel, id, limits]
+                            (unique_ptr<IResults> results, exception_ptr failure) {
+          string line;
+          try {
+            if(failure)
+              rethrow_exception(failure);
+
+            line = "{\"id\":" + quoted(id) + ",\"results\":";
+            if(nullptr == results) {
+              line += "null";
+            } else {
+              vector<char> buffer(ResultsBufferSize);
+              for(;;) {
+                try {
+                  line.append(buffer.data(), serializer.toJson(*results, buffer.data(),
+                                                               buffer.size()));
+                  break;
+                } catch(length_error&) {
+                  buffer.resize(buffer.size() * 2ULL);
+                }
+              }
+            }
+            line += '}';
+          } catch(exception &e) {
+            line = errorLine(id, e.what());
+          }
+          channel->finished(line);
+        }, from, to, count, timeConstraints.get(), nullptr, modes, nullptr,
+          limits.get());
+      } catch(exception &e) {
+        channel->finished(errorLine(id, e.what()));
+      }
+
+    } catch(exception &e) {
+      channel->send(errorLine(id, e.what()));
+    }
+  }
+
+  void RequestServer::serve(istream &in, ostream &out) const {
+    const shared_ptr<Channel> channel =
+      make_shared<Channel>([&out](const string &line) {
+        out<<line<<'\n'<<flush;
+      });
+
+    RequestLines requests([this, &channel](const string &request) {
+        handle(request, channel);
+      }, [&channel] {
+        channel->send(errorLine("", "the request is too long!"));
+      });
+    // Reading at most a line per chunk keeps interactive requests answered
+    // and bounds the buffered data of a line which never ends
+    char chunk[4'096];
+    for(;;) {
+      in.get(chunk, sizeof chunk, '\n');
+      size_t count = size_t(in.gcount());
+      const bool ended = in.eof() || in.bad();
+      if(!ended) {
+        in.clear(); // get fails for empty lines
+        if(in.peek() == '\n') {
+          in.ignore();
+          chunk[count++] = '\n'; // get left room for its terminating '\0'
+        }
+      }
+      requests.received(chunk, count);
+      if(ended)
+        break;
+    }
+    requests.closed();
+    channel->waitIdle();
+  }
+
+#ifndef _WIN32
+  void RequestServer::serveUnixSocket(const string &socketPath) const {
+    sockaddr_un address;
+    memset(&address, 0, sizeof address);
+    address.sun_family = AF_UNIX;
+    if(socketPath.empty() || socketPath.size() >= sizeof address.sun_path)
+      throw invalid_argument(string(__func__) + " got an invalid socket path!");
+    memcpy(address.sun_path, socketPath.data(), socketPath.size());
+
+    // Replaces only a socket left by a previous run
+    struct stat existing;
+    if(lstat(socketPath.c_str(), &existing) == 0) {
+      if(!S_ISSOCK(existing.st_mode))
+        throw runtime_error(string(__func__) + " found a file which isn't"
+                            " a socket at " + socketPath);
+      unlink(socketPath.c_str());
+    }
+
+    // Closes the socket and removes its file on every way out
+    struct Listener {
+      const int fd;           ///< the listening socket
+      const string &path;     ///< where the socket was bound
+      bool bound = false;     ///< the file at path belongs to this socket
+
+      explicit Listener(const string &path_) :
+        fd(socket(AF_UNIX, SOCK_STREAM, 0)), path(path_) {}
+      ~Listener() {
+        if(fd >= 0)
+          close(fd);
+        if(bound)
+          unlink(path.c_str());
+      }
+    } listener(socketPath);
+    if(listener.fd < 0)
+      throw runtime_error(string(__func__) + " couldn't create the socket!");
+
+    if(bind(listener.fd, (const sockaddr*)&address, sizeof address) != 0)
+      throw runtime_error(string(__func__) + " couldn't bind to " + socketPath);
+    listener.bound = true;
+    if(listen(listener.fd, SOMAXCONN) != 0)
+      throw runtime_error(string(__func__) + " couldn't listen on " + socketPath);
+
+    // Serves a client until it closes its end of the connection
+    const auto serveClient = [this](int client) {
+      const shared_ptr<Channel> channel =
+        make_shared<Channel>([client](const string &line) {
+          const string data = line + '\n';
+          for(size_t sent = 0ULL; sent < data.size(); ) {
+            const ssize_t count = ::send(client, data.data() + sent,
+                                         data.size() - sent, MSG_NOSIGNAL);
+            if(count <= 0)
+              return; // the client is gone
+            sent += size_t(count);
+          }
+        });
+
+      RequestLines requests([this, &channel](const string &request) {
+          handle(request, channel);
+        }, [&channel] {
+          channel->send(errorLine("", "the request is too long!"));
+        });
+      char chunk[4'096];
+      for(;;) {
+        const ssize_t count = recv(client, chunk, sizeof chunk, 0);
+        if(count <= 0)
+          break;
+        requests.received(chunk, size_t(count));
+      }
+      requests.closed();
+
+      channel->waitIdle();
+    };
+
+    // The threads of the clients, joined before leaving
+    struct Clients {
+      struct Connection {
+        int client = -1;    ///< the connection, closed once done
+        thread worker;      ///< serves the client
+        bool done = false;  ///< set by worker before exiting
+      };
+
+      list<Connection> connections; ///< the clients not joined yet
+      mutex guard;                  ///< protects the clients and done flags
+      condition_variable left;      ///< notified when a client left
+
+      /// Stops reading new requests, answers the read ones and
+      /// joins the threads of all the clients
+      ~Clients() {
+        {
+          lock_guard<mutex> lock(guard);
+          for(Connection &connection : connections)
+            if(!connection.done)
+              shutdown(connection.client, SHUT_RD);
+        }
+        for(Connection &connection : connections)
+          connection.worker.join();
+      }
+
+      /// Waits until less than MaxClients are served,
+      /// joining the threads of the clients who left
+      void waitForRoom() {
+        unique_lock<mutex> lock(guard);
+        left.wait(lock, [this] {
+          for(auto it = begin(connections); it != end(connections); ) {
+            if(it->done) {
+              it->worker.join();
+              it = connections.erase(it);
+            } else {
+              ++it;
+            }
+          }
+          return connections.size() < MaxClients;
+        });
+      }
+    } clients;
+
+    // SIGINT and SIGTERM write to a pipe watched together with the socket.
+    // The previous handlers are restored when leaving
+    struct StopSignals {
+      int fds[2] = { -1, -1 };  ///< the read and the write end of the pipe
+      struct sigaction previousInt, previousTerm; ///< the replaced handlers
+
+      StopSignals() {
+        if(pipe(fds) != 0)
+          return;
+        fcntl(fds[1], F_SETFL, O_NONBLOCK); // the handler never waits
+        stopWriter = fds[1];
+        struct sigaction stopping;
+        memset(&stopping, 0, sizeof stopping);
+        stopping.sa_handler = requestStop;
+        sigemptyset(&stopping.sa_mask);
+        sigaction(SIGINT, &stopping, &previousInt);
+        sigaction(SIGTERM, &stopping, &previousTerm);
+      }
+      ~StopSignals() {
+        if(fds[0] < 0)
+          return;
+        sigaction(SIGINT, &previousInt, nullptr);
+        sigaction(SIGTERM, &previousTerm, nullptr);
+        stopWriter = -1;
+        close(fds[0]);
+        close(fds[1]);
+      }
+    } stopSignals;
+    if(stopSignals.fds[0] < 0)
+      throw runtime_error(string(__func__) + " couldn't watch for stop signals!");
+
+    for(;;) {
+      clients.waitForRoom();
+      pollfd watched[] = { { listener.fd, POLLIN, 0 },
+                           { stopSignals.fds[0], POLLIN, 0 } };
+      if(poll(watched, 2UL, -1) < 0) {
+        if(errno == EINTR)
+          continue;
+        break;
+      }
+      if(watched[1].revents != 0)
+        return; // orderly shutdown, after serving the connected clients
+
+      const int client = accept(listener.fd, nullptr, nullptr);
+      if(client < 0) {
+        if(errno == EINTR || errno == ECONNABORTED)
+          continue;
+        break;
+      }
+
+      try {
+        lock_guard<mutex> lock(clients.guard);
+        clients.connections.emplace_back();
+        Clients::Connection &connection = clients.connections.back();
+        connection.client = client;
+        try {
+          connection.worker = thread([&serveClient, &clients, &connection] {
+            serveClient(connection.client);
+            lock_guard<mutex> lock(clients.guard);
+            close(connection.client);
+            connection.done = true;
+            clients.left.notify_all();
+          });
+        } catch(...) {
+          clients.connections.pop_back();
+          throw;
+        }
+      } catch(...) {
+        close(client);
+        throw;
+      }
+    }
+
+    throw runtime_error(string(__func__) + " couldn't accept more connections!");
+  }
+#endif // _WIN32
+
+} // namespace tp
@@ -0,0 +1,103 @@
+/*****************************************************************************
+ TripPlanner explores various issues common to navigation and booking systems.
+
+ Copyrights from the libraries used by the program:
+ - (c) 2017 Boost (www.boost.org)
+		License: <http://www.boost.org/LICENSE_1_0.txt>
+ 
+ (c) 2017 Florin Tulba <florintulba@yahoo.com>
+
+ This program is free software: you can use its results,
+ redistribute it and/or modify it under the terms of the GNU
+ Affero General Public License version 3 as published by the
+ Free Software Foundation.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU Affero General Public License for more details.
+
+ You should have received a copy of the GNU Affero General Public License
+ along with this program ('agpl-3.0.txt').
+ If not, see <http://www.gnu.org/licenses/agpl-3.0.txt>.
+ *****************************************************************************/
+
+#ifndef H_REQUEST_SERVER
+#define H_REQUEST_SERVER
+
+#include "planner.h"
+#include "resultsSerializer.h"
+
+#pragma warning ( push, 0 )
+
+#include <iostream>
+#include <memory>
+#include <string>
+
+#pragma warning ( pop )
+
+namespace tp { // trip planner
+
+  /**
+  Serves searches using a line protocol, so a single loaded planner
+  answers many clients. Every request is a JSON object on its own line:
+  {"id":"q1","from":"p2","to":"p4","count":4,"leave":"2017-09-18 00:00:00",
+   "leaveHours":24,"arriveHours":48,"modes":15,"timeoutMs":500}
+  Only from and to are mandatory. count defaults to 4; without leave
+  the trips are unconstrained in time; leaveHours defaults to 24 and
+  arriveHours to 48; modes (see TranspModes) defaults to all;
+  timeoutMs bounds the search, returning partial results.
+  Requests longer than 64 KiB get an error response and are skipped.
+
+  The requests run concurrently through TripPlanner::searchAsync and
+  every response is a JSON line tagged with the id of its request
+  (as a string), in the order the searches finish:
+  {"id":"q1","results":{"categories":[...]}}
+  {"id":"q1","results":null}            - the places cannot be connected
+  {"id":"q1","error":"..."}             - invalid request, failed search or overload
+  */
+  class RequestServer {
+  protected:
+    const TripPlanner &planner;                   ///< performs the searches
+    const queries::ResultsSerializer &serializer; ///< writes the results
+
+    class Channel; ///< the responses towards a client
+
+    /// Starts the search from request, answering through channel
+    void handle(const std::string &request,
+                const std::shared_ptr<Channel> &channel) const;
+
+  public:
+    /// Both the planner and the serializer must outlive the server
+    RequestServer(const TripPlanner &planner_,
+                  const queries::ResultsSerializer &serializer_);
+
+    RequestServer(const RequestServer&) = delete;
+    RequestServer(RequestServer&&) = delete;
+    void operator=(const RequestServer&) = delete;
+    void operator=(RequestServer&&) = delete;
+
+    /// Answers the requests read from in, writing the responses to out.
+    /// Returns after the end of in, once all the responses were written
+    void serve(std::istream &in, std::ostream &out) const;
+
+#ifndef _WIN32
+    /**
+    Listens on a Unix domain socket at socketPath and serves
+    every connection like `serve`, on a separate thread.
+    At most 128 clients are served at once; the further ones wait until
+    a client leaves. SIGINT or SIGTERM stop accepting clients and
+    it returns after answering the requests read so far.
+    The socket file is removed on every way out.
+
+    @throw invalid_argument for an empty or too long socketPath
+    @throw runtime_error when socketPath is a file which isn't a socket,
+      when the socket cannot be created or when accepting connections fails
+    */
+    void serveUnixSocket(const std::string &socketPath) const;
+#endif // _WIN32
+  };
+
+} // namespace tp
+
+#endif // H_REQUEST_SERVER
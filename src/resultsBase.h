@@ -36,6 +36,10 @@ namespace tp { namespace queries {
 
 	  /// @return the variants for the given category
 	  virtual const IVariants& operator[](size_t categ) const = 0;
+
+    /// @return true when the search stopped early (deadline or cancellation),
+    /// so the variants are only the best ones found until then
+    virtual bool partial() const { return false; }
   };
 
 }} // namespace tp::queries
@@ -0,0 +1,318 @@
+/*****************************************************************************
+ TripPlanner explores various issues common to navigation and booking systems.
+
+ Copyrights from the libraries used by the program:
+ - (c) 2017 Boost (www.boost.org)
+		License: <http://www.boost.org/LICENSE_1_0.txt>
+ 
+ (c) 2017 Florin Tulba <florintulba@yahoo.com>
+
+ This program is free software: you can use its results,
+ redistribute it and/or modify it under the terms of the GNU
+ Affero General Public License version 3 as published by the
+ Free Software Foundation.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU Affero General Public License for more details.
+
+ You should have received a copy of the GNU Affero General Public License
+ along with this program ('agpl-3.0.txt').
+ If not, see <http://www.gnu.org/licenses/agpl-3.0.txt>.
+ *****************************************************************************/
+
+#include "resultsCache.h"
+
+#pragma warning ( push, 0 )
+
+#include <algorithm>
+#include <cassert>
+
+#pragma warning ( pop )
+
+using namespace std;
+using namespace boost::posix_time;
+
+namespace {
+  using tp::queries::IResults;
+  using tp::queries::IVariants;
+  using tp::queries::FlatResults;
+
+  /// Accumulates v into the hash h
+  uint64_t mix(uint64_t h, uint64_t v) {
+    h = (h ^ v) * 0x9E3779B97F4A7C15ULL;
+    return h ^ (h >> 29);
+  }
+
+  /// @return the minutes since the start of the Julian day numbering,
+  /// rounded like the searches do
+  long long toMinutes(const ptime &t, bool roundUp) {
+    const time_duration tod = t.time_of_day();
+    long long result = (long long)t.date().day_number() * 24LL * 60LL +
+      tod.hours() * 60LL + tod.minutes();
+    if(roundUp && (tod.seconds() > 0 || tod.fractional_seconds() > 0))
+      ++result;
+    return result;
+  }
+
+  /// Handle sharing the remembered results
+  class SharedResults : public IResults {
+  protected:
+    const shared_ptr<const FlatResults> results; ///< the shared results
+
+  public:
+    SharedResults(const shared_ptr<const FlatResults> &results_) :
+      results(results_) {}
+
+    const IVariants& operator[](size_t categ) const override {
+      return (*results)[categ];
+    }
+
+    bool partial() const override {
+      return results->partial();
+    }
+  };
+
+  /// Sets a to v, unless a is already larger
+  void raiseTo(atomic<uint64_t> &a, uint64_t v) {
+    uint64_t current = a.load();
+    while(current < v && !a.compare_exchange_weak(current, v));
+  }
+
+  /// @return the moment `minutes` minutes after the start of the day of ref
+  ptime fromMinutes(long long minutes, const ptime &ref) {
+    const long long dayStart = (long long)ref.date().day_number() * 24LL * 60LL;
+    return ptime(ref.date(), boost::posix_time::minutes(long(minutes - dayStart)));
+  }
+
+  /// @return m rounded up / down to a multiple of bucket
+  long long roundToBucket(long long m, long long bucket, bool up) {
+    const long long rest = m % bucket;
+    if(rest == 0LL)
+      return m;
+    return up ? (m + bucket - rest) : (m - rest);
+  }
+} // anonymous namespace
+
+namespace tp { // trip planner
+  using namespace queries;
+
+  constexpr size_t ResultsCache::DefaultCapacity;
+  constexpr long long ResultsCache::BucketMinutes;
+  constexpr size_t ResultsCache::ShardsCount;
+  constexpr size_t ResultsCache::InvalidationSlots;
+
+  bool ResultsCache::Key::operator==(const Key &other) const {
+    return idFrom == other.idFrom && idTo == other.idTo &&
+      maxCount == other.maxCount &&
+      leaveFirst == other.leaveFirst && leaveLast == other.leaveLast &&
+      arriveFirst == other.arriveFirst && arriveLast == other.arriveLast &&
+      today == other.today && persons == other.persons &&
+      economyClass == other.economyClass && transpModes == other.transpModes &&
+      viaPlaces == other.viaPlaces && avoidedPlaces == other.avoidedPlaces &&
+      avoidedRoutes == other.avoidedRoutes;
+  }
+
+  size_t ResultsCache::KeyHash::operator()(const Key &key) const {
+    uint64_t h = mix(mix(mix(0ULL, key.idFrom), key.idTo), key.maxCount);
+    h = mix(mix(h, uint64_t(key.leaveFirst)), uint64_t(key.leaveLast));
+    h = mix(mix(h, uint64_t(key.arriveFirst)), uint64_t(key.arriveLast));
+    h = mix(mix(h, uint64_t(key.today)),
+            (uint64_t(key.persons) << 1) | (key.economyClass ? 1ULL : 0ULL));
+    h = mix(h, key.transpModes);
+    for(const vector<unsigned> *ids :
+        { &key.viaPlaces, &key.avoidedPlaces, &key.avoidedRoutes }) {
+      h = mix(h, ids->size());
+      for(unsigned id : *ids)
+        h = mix(h, id);
+    }
+    return size_t(h);
+  }
+
+  ResultsCache::ResultsCache(size_t capacity/* = DefaultCapacity*/) :
+    capacityPerShard(max(size_t((capacity + ShardsCount - 1ULL) / ShardsCount),
+                         size_t(1ULL))),
+    currentVersion(0ULL), clearedAt(0ULL) {
+    for(atomic<uint64_t> &slot : invalidatedAt)
+      slot.store(0ULL);
+  }
+
+  uint64_t ResultsCache::version() const {
+    return currentVersion;
+  }
+
+  TimeConstraints ResultsCache::widened(const ITimeConstraints &timeConstraints) {
+    const time_period &leave = timeConstraints.leavePeriod(),
+      &arrive = timeConstraints.arrivePeriod();
+    const long long
+      leaveFirst = roundToBucket(toMinutes(leave.begin(), true),
+                                 BucketMinutes, false),
+      leaveLast = roundToBucket(toMinutes(leave.last(), false),
+                                BucketMinutes, true),
+      arriveFirst = roundToBucket(toMinutes(arrive.begin(), true),
+                                  BucketMinutes, false),
+      arriveLast = roundToBucket(toMinutes(arrive.last(), false),
+                                 BucketMinutes, true);
+
+    // Rounding both intervals the same way keeps their order.
+    // TimeConstraints expects the last moments of the intervals
+    return TimeConstraints(
+      time_period(fromMinutes(leaveFirst, leave.begin()),
+                  fromMinutes(leaveLast, leave.begin())),
+      time_period(fromMinutes(arriveFirst, arrive.begin()),
+                  fromMinutes(arriveLast, arrive.begin())));
+  }
+
+  unique_ptr<IResults>
+      ResultsCache::requested(const shared_ptr<const FlatResults> &results,
+                              const ITimeConstraints &timeConstraints,
+                              size_t maxCount, bool &complete) {
+    complete = true;
+    if(nullptr == results)
+      return nullptr;
+
+    vector<size_t> dropped;
+    unique_ptr<FlatResults> kept = results->within(timeConstraints, dropped);
+    if(nullptr == kept)
+      return make_unique<SharedResults>(results);
+
+    bool foundAny = false;
+    for(size_t categ = 0ULL; categ < dropped.size(); ++categ) {
+      if(dropped[categ] > 0ULL && results->variantsCount(categ) >= maxCount)
+        complete = false;
+      foundAny = foundAny || kept->variantsCount(categ) > 0ULL;
+    }
+
+    // Like the searches, the interrupted ones report their results even when empty
+    if(!foundAny && !kept->partial())
+      return nullptr;
+    return move(kept);
+  }
+
+  ResultsCache::Key
+      ResultsCache::keyOf(unsigned idFrom, unsigned idTo, size_t maxCount,
+                          const ITimeConstraints &timeConstraints,
+                          const ISeatsConstraints *seatsConstraints,
+                          size_t transpModes,
+                          const IPlaceConstraints *placeConstraints,
+                          long today) {
+    static const vector<unsigned> noIds;
+    const time_period &leave = timeConstraints.leavePeriod(),
+      &arrive = timeConstraints.arrivePeriod();
+    return Key { idFrom, idTo, maxCount,
+      toMinutes(leave.begin(), true), toMinutes(leave.last(), false),
+      toMinutes(arrive.begin(), true), toMinutes(arrive.last(), false),
+      today,
+      (nullptr == seatsConstraints) ? 0U : seatsConstraints->persons(),
+      (nullptr == seatsConstraints) || seatsConstraints->economyClass(),
+      transpModes,
+      (nullptr == placeConstraints) ? noIds : placeConstraints->viaPlaces(),
+      (nullptr == placeConstraints) ? noIds : placeConstraints->avoidedPlaces(),
+      (nullptr == placeConstraints) ? noIds : placeConstraints->avoidedRoutes() };
+  }
+
+  ResultsCache::Shard& ResultsCache::shardFor(const Key &key) {
+    const size_t h = KeyHash()(key);
+    return shards[(h ^ (h >> 32)) % ShardsCount];
+  }
+
+  void ResultsCache::forget(Shard &shard, Entries::iterator it) {
+    for(unsigned raId : it->raIds) {
+      const auto itRa = shard.byRaId.find(raId);
+      assert(cend(shard.byRaId) != itRa);
+      vector<Entries::iterator> &users = itRa->second;
+      const auto itUser = std::find(begin(users), end(users), it);
+      assert(cend(users) != itUser);
+      *itUser = users.back();
+      users.pop_back();
+      if(users.empty())
+        shard.byRaId.erase(itRa);
+    }
+    shard.index.erase(it->key);
+    shard.entries.erase(it);
+  }
+
+  bool ResultsCache::find(const Key &key,
+                          shared_ptr<const FlatResults> &results) {
+    Shard &shard = shardFor(key);
+    lock_guard<mutex> lock(shard.guard);
+    const auto it = shard.index.find(key);
+    if(cend(shard.index) == it)
+      return false;
+
+    // Now the most recently used entry
+    shard.entries.splice(begin(shard.entries), shard.entries, it->second);
+    results = it->second->results;
+    return true;
+  }
+
+  shared_ptr<const FlatResults>
+      ResultsCache::insert(const Key &key, unique_ptr<FlatResults> results,
+                           uint64_t observedVersion) {
+    const shared_ptr<const FlatResults> shared(move(results));
+    vector<unsigned> raIds;
+    if(nullptr != shared)
+      raIds = shared->routeAlternatives();
+
+    Shard &shard = shardFor(key);
+    {
+      lock_guard<mutex> lock(shard.guard);
+
+      // The invalidations mark their route alternatives before locking the shards
+      bool stale = clearedAt.load() > observedVersion;
+      for(size_t i = 0ULL; !stale && i < raIds.size(); ++i)
+        stale = invalidatedAt[raIds[i] % InvalidationSlots].load() >
+          observedVersion;
+      if(stale)
+        return shared;
+
+      const auto it = shard.index.find(key);
+      if(cend(shard.index) != it) // an equivalent concurrent search was faster
+        forget(shard, it->second);
+
+      shard.entries.push_front(Entry { key, shared, move(raIds) });
+      const Entries::iterator added = begin(shard.entries);
+      shard.index[key] = added;
+      for(unsigned raId : added->raIds)
+        shard.byRaId[raId].push_back(added);
+      if(shard.entries.size() > capacityPerShard)
+        forget(shard, prev(end(shard.entries)));
+    }
+    return shared;
+  }
+
+  void ResultsCache::invalidate(const vector<unsigned> &raIds) {
+    const uint64_t version = ++currentVersion;
+    for(unsigned raId : raIds)
+      raiseTo(invalidatedAt[raId % InvalidationSlots], version);
+
+    for(Shard &shard : shards) {
+      lock_guard<mutex> lock(shard.guard);
+      for(unsigned raId : raIds)
+        for(auto itRa = shard.byRaId.find(raId); cend(shard.byRaId) != itRa;
+            itRa = shard.byRaId.find(raId))
+          forget(shard, itRa->second.back());
+    }
+  }
+
+  void ResultsCache::clear() {
+    raiseTo(clearedAt, ++currentVersion);
+    for(Shard &shard : shards) {
+      lock_guard<mutex> lock(shard.guard);
+      shard.byRaId.clear();
+      shard.index.clear();
+      shard.entries.clear();
+    }
+  }
+
+  size_t ResultsCache::size() {
+    size_t result = 0ULL;
+    for(Shard &shard : shards) {
+      lock_guard<mutex> lock(shard.guard);
+      result += shard.entries.size();
+    }
+    return result;
+  }
+
+} // namespace tp
@@ -0,0 +1,248 @@
+/*****************************************************************************
+ TripPlanner explores various issues common to navigation and booking systems.
+
+ Copyrights from the libraries used by the program:
+ - (c) 2017 Boost (www.boost.org)
+		License: <http://www.boost.org/LICENSE_1_0.txt>
+ 
+ (c) 2017 Florin Tulba <florintulba@yahoo.com>
+
+ This program is free software: you can use its results,
+ redistribute it and/or modify it under the terms of the GNU
+ Affero General Public License version 3 as published by the
+ Free Software Foundation.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU Affero General Public License for more details.
+
+ You should have received a copy of the GNU Affero General Public License
+ along with this program ('agpl-3.0.txt').
+ If not, see <http://www.gnu.org/licenses/agpl-3.0.txt>.
+ *****************************************************************************/
+
+#ifndef H_RESULTS_CACHE
+#define H_RESULTS_CACHE
+
+#include "flatResults.h"
+#include "constraints.h"
+
+#pragma warning ( push, 0 )
+
+#include <array>
+#include <atomic>
+#include <list>
+#include <mutex>
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include <unordered_map>
+
+#pragma warning ( pop )
+
+namespace tp { // trip planner
+
+  /**
+  Remembers the results of the latest searches, so repeated searches
+  with equivalent parameters don't explore the graph again.
+
+  Equivalent searches have the same ends, the same maxCountPerCategory,
+  the same seat and place constraints, the same allowed transportation
+  modes, happen during the same day (which decides the urgency of
+  the flights) and have the same time constraints after widening them
+  to whole buckets (see widened). So the searches issued a few minutes
+  apart from `now` share the same entry, which holds the results over
+  the widened constraints. Each search then keeps only its requested
+  variants (see requested).
+  The searches which found nothing are remembered, too.
+
+  The cache forgets:
+  - all the results after an update of the specifications
+    and after cancellations (the freed seats might improve any search)
+  - the results using the route alternatives of a new booking.
+    Bookings only make the affected connections more expensive or unavailable,
+    so the results which don't use them remain the best ones.
+    The entries are indexed by route alternative, so only these are dropped,
+    and only the searches which used them can't remember their results
+
+  The entries are spread among several independently locked shards.
+  Each shard forgets its least recently used entry when full.
+  */
+  class ResultsCache {
+  public:
+    /// The parameters of a search, normalized to the precision of the searches
+    struct Key {
+      unsigned idFrom;        ///< id of the starting location
+      unsigned idTo;          ///< id of the destination location
+      size_t maxCount;        ///< maxCountPerCategory
+      long long leaveFirst, leaveLast;    ///< departure interval (minutes)
+      long long arriveFirst, arriveLast;  ///< arrival interval (minutes)
+      long today;             ///< Julian day of the search
+      unsigned persons;       ///< persons from the seats constraints or 0
+      bool economyClass;      ///< class from the seats constraints
+      size_t transpModes;     ///< the allowed transportation modes
+      std::vector<unsigned> viaPlaces;     ///< sorted ids of the places to pass through
+      std::vector<unsigned> avoidedPlaces; ///< sorted ids of the places to avoid
+      std::vector<unsigned> avoidedRoutes; ///< sorted ids of the routes to avoid
+
+      bool operator==(const Key &other) const;
+    };
+
+    /// Default count of the remembered searches
+    static constexpr size_t DefaultCapacity = 1024ULL;
+
+    /// Width of the buckets of the time constraints (minutes)
+    static constexpr long long BucketMinutes = 15LL;
+
+  protected:
+    /// Count of the independently locked parts of the cache
+    static constexpr size_t ShardsCount = 16ULL;
+
+    /// Computes the hash of a Key
+    struct KeyHash {
+      size_t operator()(const Key &key) const;
+    };
+
+    /// A remembered search
+    struct Entry {
+      Key key; ///< the parameters of the search
+      std::shared_ptr<const queries::FlatResults> results; ///< nullptr if nothing found
+      std::vector<unsigned> raIds; ///< the sorted route alternatives from results
+    };
+
+    typedef std::list<Entry> Entries; ///< ordered from the most recently used
+
+    /// Part of the cache guarded by its own lock
+    struct Shard {
+      std::mutex guard; ///< protects the fields below
+      Entries entries;  ///< the entries, from the most recently used one
+      std::unordered_map<Key, Entries::iterator, KeyHash> index; ///< entries by key
+
+      /// The entries using each route alternative
+      std::unordered_map<unsigned, std::vector<Entries::iterator>> byRaId;
+    };
+
+    /// Count of the slots remembering when the route alternatives
+    /// were invalidated. Route alternatives sharing a slot (raId % slots)
+    /// are invalidated together
+    static constexpr size_t InvalidationSlots = 4096ULL;
+
+    std::array<Shard, ShardsCount> shards; ///< the parts of the cache
+    const size_t capacityPerShard; ///< the entries a shard can hold
+
+    /// Incremented by each invalidation. Observed by the searches before starting
+    std::atomic<uint64_t> currentVersion;
+
+    /// The version of the last invalidation of the route alternatives
+    /// from each slot. Searches using them after that version aren't remembered
+    std::array<std::atomic<uint64_t>, InvalidationSlots> invalidatedAt;
+
+    /// The version of the last clear
+    std::atomic<uint64_t> clearedAt;
+
+    /// @return the shard responsible for key
+    Shard& shardFor(const Key &key);
+
+    /// Forgets the entry `it` from shard. Expects shard.guard locked
+    static void forget(Shard &shard, Entries::iterator it);
+
+  public:
+    /// Remembers up to about capacity searches
+    ResultsCache(size_t capacity = DefaultCapacity);
+
+    ResultsCache(const ResultsCache&) = delete;
+    ResultsCache(ResultsCache&&) = delete;
+    void operator=(const ResultsCache&) = delete;
+    void operator=(ResultsCache&&) = delete;
+
+    /**
+    @return timeConstraints widened to whole buckets of BucketMinutes:
+    each interval starts at the bucket boundary before it
+    and ends at the bucket boundary after it.
+    The searches within the same buckets share the key and the results.
+    */
+    static queries::TimeConstraints
+      widened(const queries::ITimeConstraints &timeConstraints);
+
+    /**
+    Extracts the variants of a search over the widened time constraints
+    which leave and arrive within the requested timeConstraints.
+
+    @param results the results over the widened constraints or nullptr
+    @param timeConstraints the requested time constraints
+    @param maxCount maxCountPerCategory
+    @param complete set to false when the results might miss requested
+      variants: a category with maxCount variants lost some of them,
+      so their places might belong to the variants found after them
+
+    @return a handle to the requested variants or nullptr if there are none
+    */
+    static std::unique_ptr<queries::IResults>
+      requested(const std::shared_ptr<const queries::FlatResults> &results,
+                const queries::ITimeConstraints &timeConstraints,
+                size_t maxCount, bool &complete);
+
+    /**
+    @return the normalized parameters of a search
+
+    @param idFrom id of the starting location
+    @param idTo id of the destination location
+    @param maxCount maxCountPerCategory
+    @param timeConstraints the imposed periods when to leave and when to arrive
+    @param seatsConstraints the optional seats constraints
+    @param transpModes the allowed transportation modes
+    @param placeConstraints the optional place constraints
+    @param today Julian day of the search
+    */
+    static Key keyOf(unsigned idFrom, unsigned idTo, size_t maxCount,
+                     const queries::ITimeConstraints &timeConstraints,
+                     const queries::ISeatsConstraints *seatsConstraints,
+                     size_t transpModes,
+                     const queries::IPlaceConstraints *placeConstraints,
+                     long today);
+
+    /**
+    Looks for the results of the search with the given key.
+
+    @param key the parameters of the search
+    @param results receives the remembered results
+      or nullptr when the search found nothing
+
+    @return false if the search isn't remembered
+    */
+    bool find(const Key &key,
+              std::shared_ptr<const queries::FlatResults> &results);
+
+    /// @return the version to be provided to insert,
+    /// read before inspecting the occupancy for a new search
+    uint64_t version() const;
+
+    /**
+    Remembers the results of the search with the given key, unless
+    the cache was cleared or any of the route alternatives from results
+    was invalidated since reading observedVersion.
+
+    @param key the parameters of the search
+    @param results the results or nullptr when the search found nothing
+    @param observedVersion the value of version() before the search
+
+    @return the shared results or nullptr when results is nullptr
+    */
+    std::shared_ptr<const queries::FlatResults>
+      insert(const Key &key, std::unique_ptr<queries::FlatResults> results,
+             uint64_t observedVersion);
+
+    /// Forgets the results using any of the route alternatives raIds
+    void invalidate(const std::vector<unsigned> &raIds);
+
+    /// Forgets all the results
+    void clear();
+
+    /// @return the count of remembered searches
+    size_t size();
+  };
+
+} // namespace tp
+
+#endif // H_RESULTS_CACHE
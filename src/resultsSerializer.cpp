@@ -0,0 +1,312 @@
+/*****************************************************************************
+ TripPlanner explores various issues common to navigation and booking systems.
+
+ Copyrights from the libraries used by the program:
+ - (c) 2017 Boost (www.boost.org)
+		License: <http://www.boost.org/LICENSE_1_0.txt>
+ 
+ (c) 2017 Florin Tulba <florintulba@yahoo.com>
+
+ This program is free software: you can use its results,
+ redistribute it and/or modify it under the terms of the GNU
+ Affero General Public License version 3 as published by the
+ Free Software Foundation.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU Affero General Public License for more details.
+
+ You should have received a copy of the GNU Affero General Public License
+ along with this program ('agpl-3.0.txt').
+ If not, see <http://www.gnu.org/licenses/agpl-3.0.txt>.
+ *****************************************************************************/
+
+#include "resultsSerializer.h"
+#include "transpModes.h"
+
+#pragma warning ( push, 0 )
+
+#include <cstring>
+#include <cstdint>
+#include <cmath>
+#include <stdexcept>
+
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+
+#pragma warning ( pop )
+
+using namespace std;
+using namespace boost::gregorian;
+using namespace boost::posix_time;
+
+namespace {
+  using tp::queries::IConnection;
+
+  const long MinutesPerDay = 24L * 60L;
+
+  /// Julian day number of 1970-Jan-1
+  const long EpochDayNumber = long(date(1970, Jan, 1).day_number());
+
+  /// @return the minutes between 1970-Jan-1 00:00 and t
+  int64_t minutesSinceEpoch(const ptime &t) {
+    const time_duration tod = t.time_of_day();
+    return int64_t(long(t.date().day_number()) - EpochDayNumber) * MinutesPerDay +
+      tod.hours() * 60L + tod.minutes();
+  }
+
+  /// Appends bytes to a buffer with a fixed capacity
+  class Writer {
+  protected:
+    char * const start; ///< the beginning of the buffer
+    char * const limit; ///< just after the end of the buffer
+    char *pos;          ///< where to write next
+
+    /// Ensures there is room for count more bytes
+    void reserve(size_t count) {
+      if(size_t(limit - pos) < count)
+        throw length_error("ResultsSerializer got a too small buffer "
+                           "for the results!");
+    }
+
+  public:
+    Writer(char *buffer, size_t capacity) :
+      start(buffer), limit(buffer + capacity), pos(buffer) {}
+
+    /// @return the count of written bytes
+    size_t written() const { return size_t(pos - start); }
+
+    /// Appends count characters from s
+    void put(const char *s, size_t count) {
+      reserve(count);
+      memcpy(pos, s, count);
+      pos += count;
+    }
+
+    /// Appends the string literal s
+    template<size_t N>
+    void put(const char (&s)[N]) { put(s, N - 1ULL); }
+
+    /// Appends character c
+    void put(char c) {
+      reserve(1ULL);
+      *pos++ = c;
+    }
+
+    /// Appends the decimal digits of v
+    void putUnsigned(uint64_t v) {
+      char digits[20];
+      size_t count = 0ULL;
+      do {
+        digits[count++] = char('0' + v % 10ULL);
+        v /= 10ULL;
+      } while(v > 0ULL);
+
+      reserve(count);
+      while(count > 0ULL)
+        *pos++ = digits[--count];
+    }
+
+    /// Appends v rounded to the given count of decimals
+    void putFixed(float v, unsigned decimals) {
+      uint64_t scale = 1ULL;
+      for(unsigned i = 0U; i < decimals; ++i)
+        scale *= 10ULL;
+      if(v < 0.f)
+        put('-');
+      const uint64_t scaled = uint64_t(llround(fabs(double(v)) * double(scale)));
+      putUnsigned(scaled / scale);
+      if(decimals == 0U)
+        return;
+
+      put('.');
+      uint64_t fraction = scaled % scale;
+      reserve(decimals);
+      for(unsigned i = decimals; i > 0U; --i) {
+        pos[i - 1U] = char('0' + fraction % 10ULL);
+        fraction /= 10ULL;
+      }
+      pos += decimals;
+    }
+
+    /// Appends v with 2 digits
+    void put2Digits(unsigned v) {
+      reserve(2ULL);
+      *pos++ = char('0' + v / 10U);
+      *pos++ = char('0' + v % 10U);
+    }
+
+    /// Appends t as a quoted "YYYY-MM-DDTHH:MM"
+    void putMoment(const ptime &t) {
+      const date::ymd_type ymd = t.date().year_month_day();
+      const time_duration tod = t.time_of_day();
+      put('"');
+      putUnsigned(unsigned(ymd.year));
+      put('-');
+      put2Digits(unsigned(ymd.month));
+      put('-');
+      put2Digits(unsigned(ymd.day));
+      put('T');
+      put2Digits(unsigned(tod.hours()));
+      put(':');
+      put2Digits(unsigned(tod.minutes()));
+      put('"');
+    }
+
+    /// Appends the bytes of v
+    template<class T>
+    void putRaw(T v) {
+      reserve(sizeof v);
+      memcpy(pos, &v, sizeof v);
+      pos += sizeof v;
+    }
+  };
+
+  /// Appends the binary form of connection c
+  void connectionToBinary(const IConnection &c, Writer &w) {
+    w.putRaw(uint32_t(c.from()));
+    w.putRaw(uint32_t(c.to()));
+    w.putRaw(minutesSinceEpoch(c.begin()));
+    w.putRaw(minutesSinceEpoch(c.end()));
+    w.putRaw(uint32_t(c.transpModes()));
+    w.putRaw(c.price());
+    w.putRaw(c.distance());
+  }
+} // anonymous namespace
+
+// namespace trip planner - queries
+namespace tp { namespace queries {
+  using namespace specs;
+
+  constexpr size_t ResultsSerializer::BinaryConnectionSize;
+
+  ResultsSerializer::ResultsSerializer(const InfoSource &infoSrc) {
+    static const char hexDigits[] = "0123456789abcdef";
+
+    vector<unsigned> placeIds;
+    infoSrc.idsOfAllPlaces(placeIds);
+    for(unsigned id : placeIds) {
+      const string &name = infoSrc.getPlace(id).names().front();
+      const size_t offset = names.size();
+      for(char ch : name) {
+        if(ch == '"' || ch == '\\') {
+          names += '\\';
+          names += ch;
+        } else if((unsigned char)ch < 0x20U) {
+          names += "\\u00";
+          names += hexDigits[(unsigned char)ch >> 4];
+          names += hexDigits[(unsigned char)ch & 0xFU];
+        } else {
+          names += ch;
+        }
+      }
+      nameSpans[id] = NameSpan { offset, names.size() - offset };
+    }
+  }
+
+  size_t ResultsSerializer::toJson(const IResults &results,
+                                   char *buffer, size_t capacity) const {
+    Writer w(buffer, capacity);
+
+    // Appends the quoted name of the place with the given id
+    const auto putPlace = [this, &w] (size_t placeId) {
+      const auto it = nameSpans.find(unsigned(placeId));
+      if(cend(nameSpans) == it)
+        throw invalid_argument("ResultsSerializer::toJson met an unknown "
+                               "place id!");
+      w.put('"');
+      w.put(names.data() + it->second.offset, it->second.length);
+      w.put('"');
+    };
+
+    // Appends the fields common to the variants and the connections
+    const auto putConnection = [&w, &putPlace] (const IConnection &c) {
+      w.put("\"from\":");
+      putPlace(c.from());
+      w.put(",\"to\":");
+      putPlace(c.to());
+      w.put(",\"departure\":");
+      w.putMoment(c.begin());
+      w.put(",\"arrival\":");
+      w.putMoment(c.end());
+    };
+
+    // Appends the fields following putConnection
+    const auto putCosts = [&w] (const IConnection &c) {
+      const char *modes = TranspModes::toString(c.transpModes());
+      w.put(",\"modes\":\"");
+      w.put(modes, strlen(modes));
+      w.put("\",\"price\":");
+      w.putFixed(c.price(), 2U);
+      w.put(",\"distance\":");
+      w.putFixed(c.distance(), 1U);
+    };
+
+    const vector<const char*> &categNames = variantCategories();
+    const size_t categories = categNames.size();
+    w.put("{\"categories\":[");
+    for(size_t categ = 0ULL; categ < categories; ++categ) {
+      if(categ > 0ULL)
+        w.put(',');
+      w.put("{\"name\":\"");
+      w.put(categNames[categ], strlen(categNames[categ]));
+      w.put("\",\"variants\":[");
+
+      const IVariants &variants = results[categ];
+      const size_t variantsCount = variants.count();
+      for(size_t i = 0ULL; i < variantsCount; ++i) {
+        const IVariant &v = variants.at(i);
+        if(i > 0ULL)
+          w.put(',');
+        w.put('{');
+        putConnection(v);
+        w.put(",\"minutes\":");
+        w.putUnsigned(uint64_t(v.duration().total_seconds() / 60L));
+        putCosts(v);
+        w.put(",\"connections\":[");
+
+        const size_t connectionsCount = v.connectionsCount();
+        for(size_t j = 0ULL; j < connectionsCount; ++j) {
+          const IConnection &c = v.connection(j);
+          if(j > 0ULL)
+            w.put(',');
+          w.put('{');
+          putConnection(c);
+          putCosts(c);
+          w.put('}');
+        }
+        w.put("]}");
+      }
+      w.put("]}");
+    }
+    w.put(']');
+    if(results.partial())
+      w.put(",\"partial\":true");
+    w.put('}');
+    return w.written();
+  }
+
+  size_t ResultsSerializer::toBinary(const IResults &results,
+                                     char *buffer, size_t capacity) const {
+    Writer w(buffer, capacity);
+    w.put("TPR2");
+    w.putRaw(uint8_t(results.partial() ? BinaryPartialFlag : 0U));
+
+    const size_t categories = variantCategories().size();
+    w.putRaw(uint32_t(categories));
+    for(size_t categ = 0ULL; categ < categories; ++categ) {
+      const IVariants &variants = results[categ];
+      const size_t variantsCount = variants.count();
+      w.putRaw(uint32_t(variantsCount));
+      for(size_t i = 0ULL; i < variantsCount; ++i) {
+        const IVariant &v = variants.at(i);
+        const size_t connectionsCount = v.connectionsCount();
+        w.putRaw(uint32_t(connectionsCount));
+        for(size_t j = 0ULL; j < connectionsCount; ++j)
+          connectionToBinary(v.connection(j), w);
+      }
+    }
+    return w.written();
+  }
+
+}} // namespace tp::queries
@@ -0,0 +1,131 @@
+/*****************************************************************************
+ TripPlanner explores various issues common to navigation and booking systems.
+
+ Copyrights from the libraries used by the program:
+ - (c) 2017 Boost (www.boost.org)
+		License: <http://www.boost.org/LICENSE_1_0.txt>
+ 
+ (c) 2017 Florin Tulba <florintulba@yahoo.com>
+
+ This program is free software: you can use its results,
+ redistribute it and/or modify it under the terms of the GNU
+ Affero General Public License version 3 as published by the
+ Free Software Foundation.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU Affero General Public License for more details.
+
+ You should have received a copy of the GNU Affero General Public License
+ along with this program ('agpl-3.0.txt').
+ If not, see <http://www.gnu.org/licenses/agpl-3.0.txt>.
+ *****************************************************************************/
+
+#ifndef H_RESULTS_SERIALIZER
+#define H_RESULTS_SERIALIZER
+
+#include "resultsBase.h"
+#include "infoSource.h"
+
+#pragma warning ( push, 0 )
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+#pragma warning ( pop )
+
+// namespace trip planner - queries
+namespace tp { namespace queries {
+
+  /**
+  Writes search results directly into a buffer provided by the caller,
+  without streams, temporary strings or locale-dependent formatting.
+
+  The names of the places are escaped for JSON once, by the constructor,
+  and appended to a single buffer. Serializing a place copies its name
+  from the offset precomputed for it. After updating the specifications,
+  build a new serializer.
+
+  The JSON output looks like:
+  {"categories":[{"name":"most rapid variants","variants":[
+    {"from":"p2","to":"p4","departure":"2017-09-18T19:40",
+     "arrival":"2017-09-18T22:00","minutes":140,"modes":"Road",
+     "price":12.34,"distance":163.6,"connections":[
+       {"from":"p2","to":"p4","departure":"2017-09-18T19:40",
+        "arrival":"2017-09-18T22:00","modes":"Road",
+        "price":12.34,"distance":163.6}]}]}, ...]}
+  without any whitespace. Prices have 2 decimals and distances have 1 decimal.
+  The results of an interrupted search end with ,"partial":true
+  after the categories.
+
+  The binary format uses the byte order of the host and contains:
+  - the magic bytes "TPR2"
+  - uint8: flags; BinaryPartialFlag is set for an interrupted search
+  - uint32: the count of categories
+  - for each category: uint32 - the count of variants
+    - for each variant: uint32 - the count of connections
+      - for each connection (BinaryConnectionSize bytes):
+        uint32 - id of the starting place; uint32 - id of the destination;
+        int64 - departure and int64 - arrival as minutes since 1970-Jan-1 00:00;
+        uint32 - the transportation modes (see TranspModes);
+        float - price; float - distance
+  */
+  class ResultsSerializer {
+  protected:
+    /// Location of the escaped name of a place within names
+    struct NameSpan {
+      size_t offset;  ///< start of the name within names
+      size_t length;  ///< length of the escaped name
+    };
+
+    std::string names; ///< the escaped names of all places, one after the other
+    std::unordered_map<unsigned, NameSpan> nameSpans; ///< name location by place id
+
+  public:
+    /// Bytes of a connection within the binary format
+    static constexpr size_t BinaryConnectionSize = 36ULL;
+
+    /// Bit of the flags byte marking the results of an interrupted search
+    static constexpr uint8_t BinaryPartialFlag = 1U;
+
+    /// Precomputes the escaped names of all places from infoSrc
+    ResultsSerializer(const specs::InfoSource &infoSrc);
+
+    ResultsSerializer(const ResultsSerializer&) = delete;
+    ResultsSerializer(ResultsSerializer&&) = delete;
+    void operator=(const ResultsSerializer&) = delete;
+    void operator=(ResultsSerializer&&) = delete;
+
+    /**
+    Writes results as compact JSON (not null-terminated).
+
+    @param results the results to serialize
+    @param buffer the destination
+    @param capacity the size of buffer
+
+    @return the count of written bytes
+
+    @throw length_error when capacity is too small
+    @throw invalid_argument for places unknown to the serializer
+    */
+    size_t toJson(const IResults &results, char *buffer, size_t capacity) const;
+
+    /**
+    Writes results in the binary format described above.
+
+    @param results the results to serialize
+    @param buffer the destination
+    @param capacity the size of buffer
+
+    @return the count of written bytes
+
+    @throw length_error when capacity is too small
+    */
+    size_t toBinary(const IResults &results, char *buffer, size_t capacity) const;
+  };
+
+}} // namespace tp::queries
+
+#endif // H_RESULTS_SERIALIZER
@@ -55,6 +55,15 @@ namespace tp { namespace specs {
 		  unavailDaysForTheYearAhead() const = 0;
   };
 
+  /// @return true if the transport described by rci operates on the given date
+  inline bool operatesOn(const IRouteCustomizableInfo &rci,
+                         const boost::gregorian::date &d) {
+    // Bit i from the operational days of a week is day i (0 = Sunday)
+    return rci.operationalDaysOfWeek()->test(
+             (size_t)d.day_of_week().as_number()) &&
+      rci.unavailDaysForTheYearAhead()->count(d) == 0ULL;
+  }
+
 }} // namespace tp::specs
 
 #endif // H_ROUTE_CUSTOMIZABLE_INFO_BASE
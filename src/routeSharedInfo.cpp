@@ -30,6 +30,7 @@
 
 #include <sstream>
 #include <algorithm>
+#include <cassert>
 
 #pragma warning ( pop )
 
@@ -126,6 +127,20 @@ namespace tp { namespace specs {
 	  return _distances[distIdx];
   }
 
+  float RouteSharedInfo::legDistance(size_t fromIdx, size_t toIdx,
+                                     bool returnTrip) const {
+	  validateStopIdx(toIdx);
+	  if(fromIdx > toIdx) {
+		  ostringstream oss;
+		  oss<<__func__<<" expects fromIdx ("<<fromIdx
+			  <<") <= toIdx ("<<toIdx<<")!";
+		  throw out_of_range(oss.str());
+	  }
+
+	  const vector<float> &sums = returnTrip ? returnDistanceSums : distanceSums;
+	  return sums[toIdx] - sums[fromIdx];
+  }
+
   ITicketPriceCalculator& RouteSharedInfo::pricingEngine() const {
 	  assert(nullptr != pricingEng);
 	  return *pricingEng;
@@ -146,6 +161,8 @@ namespace tp { namespace specs {
 	  _stopsCount = 1ULL;
 	  stopsSet.insert(placeId);
 	  stops.push_back(placeId);
+	  distanceSums.assign(1ULL, 0.f);
+	  returnDistanceSums.assign(1ULL, 0.f);
   }
 
   void RouteSharedInfo::setNextStop(unsigned placeId, float distToPrevStop) {
@@ -159,6 +176,13 @@ namespace tp { namespace specs {
 	  stops.push_back(placeId);
 	  _distances.push_back(distToPrevStop);
 	  ++_stopsCount;
+
+	  distanceSums.push_back(distanceSums.back() + distToPrevStop);
+
+	  // The new stop is the first one for return trips
+	  for(float &sum : returnDistanceSums)
+		  sum += distToPrevStop;
+	  returnDistanceSums.insert(cbegin(returnDistanceSums), 0.f);
   }
 
   void RouteSharedInfo::addAlternative(unsigned alternativeId) {
@@ -72,6 +72,10 @@ namespace tp { namespace specs {
 
 	  std::vector<float> _distances;	///< the distances between consecutive stops
 
+	  /// Distance from the first stop to each stop, for both traversal directions.
+	  /// They allow computing the distance of any leg in constant time
+	  std::vector<float> distanceSums, returnDistanceSums;
+
 	  /// Provides a calculator for ticket prices
 	  std::unique_ptr<ITicketPriceCalculator> pricingEng;
 
@@ -125,6 +129,14 @@ namespace tp { namespace specs {
 	  /// in normal or reversed order (for returnTrip = true)
 	  float nthDistance(size_t distIdx, bool returnTrip) const override;
 
+	  /**
+	  @return the distance covered between the fromIdx-th and the toIdx-th stops
+	  when traversing the routes in normal or reversed order (for returnTrip = true)
+	  @throw out_of_range for invalid indices or when fromIdx > toIdx
+	  */
+	  float legDistance(size_t fromIdx, size_t toIdx,
+                      bool returnTrip) const override;
+
 	  /// Provides a calculator for ticket prices
 	  ITicketPriceCalculator& pricingEngine() const override;
 
@@ -64,6 +64,14 @@ namespace tp { namespace specs {
 	  /// in normal or reversed order (for returnTrip = true)
 	  virtual float nthDistance(size_t distIdx, bool returnTrip) const = 0;
 
+	  /**
+	  @return the distance covered between the fromIdx-th and the toIdx-th stops
+	  when traversing the routes in normal or reversed order (for returnTrip = true)
+	  @throw out_of_range for invalid indices or when fromIdx > toIdx
+	  */
+	  virtual float legDistance(size_t fromIdx, size_t toIdx,
+                              bool returnTrip) const = 0;
+
 	  /// Provides a calculator for ticket prices
 	  virtual ITicketPriceCalculator& pricingEngine() const = 0;
 
@@ -0,0 +1,69 @@
+/*****************************************************************************
+ TripPlanner explores various issues common to navigation and booking systems.
+
+ Copyrights from the libraries used by the program:
+ - (c) 2017 Boost (www.boost.org)
+		License: <http://www.boost.org/LICENSE_1_0.txt>
+ 
+ (c) 2017 Florin Tulba <florintulba@yahoo.com>
+
+ This program is free software: you can use its results,
+ redistribute it and/or modify it under the terms of the GNU
+ Affero General Public License version 3 as published by the
+ Free Software Foundation.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU Affero General Public License for more details.
+
+ You should have received a copy of the GNU Affero General Public License
+ along with this program ('agpl-3.0.txt').
+ If not, see <http://www.gnu.org/licenses/agpl-3.0.txt>.
+ *****************************************************************************/
+
+#ifndef H_SEARCH_SESSION_BASE
+#define H_SEARCH_SESSION_BASE
+
+#include "variantsBase.h"
+
+// namespace trip planner - queries
+namespace tp { namespace queries {
+
+  /**
+  Search whose variants are produced on demand, one page at a time,
+  for each category from variantCategories().
+
+  The exploration of a category starts with its first page and
+  the later pages resume it, instead of searching again.
+  The categories which are never inspected are never explored.
+  */
+  struct ISearchSession /*abstract*/ {
+    virtual ~ISearchSession() /*= 0*/ {}
+
+    /**
+    Finds the next variants for the given category.
+
+    @param categ the category
+    @param pageSize the maximum count of new variants
+
+    @return the new variants, valid until the next page of the same category;
+      empty when the category has no more variants
+
+    @throw out_of_range for an invalid categ
+    @throw invalid_argument for pageSize 0
+    */
+    virtual const IVariants& nextPage(size_t categ, size_t pageSize) = 0;
+
+    /**
+    @return true when the given category certainly has no more variants.
+      When false, the next page might still be empty
+
+    @throw out_of_range for an invalid categ
+    */
+    virtual bool exhausted(size_t categ) const = 0;
+  };
+
+}} // namespace tp::queries
+
+#endif // H_SEARCH_SESSION_BASE
@@ -0,0 +1,184 @@
+/*****************************************************************************
+ TripPlanner explores various issues common to navigation and booking systems.
+
+ Copyrights from the libraries used by the program:
+ - (c) 2017 Boost (www.boost.org)
+		License: <http://www.boost.org/LICENSE_1_0.txt>
+ 
+ (c) 2017 Florin Tulba <florintulba@yahoo.com>
+
+ This program is free software: you can use its results,
+ redistribute it and/or modify it under the terms of the GNU
+ Affero General Public License version 3 as published by the
+ Free Software Foundation.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU Affero General Public License for more details.
+
+ You should have received a copy of the GNU Affero General Public License
+ along with this program ('agpl-3.0.txt').
+ If not, see <http://www.gnu.org/licenses/agpl-3.0.txt>.
+ *****************************************************************************/
+
+#include "seatInventory.h"
+
+#pragma warning ( push, 0 )
+
+#include <cassert>
+#include <mutex>
+
+#pragma warning ( pop )
+
+using namespace std;
+using namespace boost::gregorian;
+
+// namespace trip planner - bookings
+namespace tp { namespace bookings {
+
+  SeatInventory::View::View(const SeatInventory &inventory_) :
+      inventory(inventory_) {}
+
+  unsigned SeatInventory::View::occupied(const Leg &leg) const {
+    return inventory.occupied(leg);
+  }
+
+  SeatInventory::Table::Table(size_t slots) : mask(slots - 1ULL),
+      keys(make_unique<atomic<uint64_t>[]>(slots)),
+      occupancies(make_unique<atomic<Occupancy*>[]>(slots)) {
+    assert(slots > 0ULL && (slots & mask) == 0ULL);
+    for(size_t i = 0ULL; i < slots; ++i) {
+      keys[i].store(0ULL, memory_order_relaxed);
+      occupancies[i].store(nullptr, memory_order_relaxed);
+    }
+  }
+
+  SeatInventory::Stripe::Stripe() {
+    tables.push_back(make_unique<Table>(InitialSlots));
+    table.store(tables.back().get());
+  }
+
+  SeatInventory::SeatInventory() : _view(make_shared<View>(*this)) {}
+
+  uint64_t SeatInventory::keyOf(unsigned raId, const date &d) {
+    // The day number of any valid date is positive
+    return (uint64_t(raId) << 32) | uint64_t(d.day_number());
+  }
+
+  size_t SeatInventory::slotOf(const Table &table, uint64_t key) {
+    // The upper bits of the product depend on all the bits of key
+    return size_t((key * 0x9E3779B97F4A7C15ULL) >> 24) & table.mask;
+  }
+
+  const SeatInventory::Stripe& SeatInventory::stripeFor(uint64_t key) const {
+    // Consecutive dates of the same route alternative land on different stripes
+    return stripes[(size_t)((key ^ (key >> 29)) % StripesCount)];
+  }
+
+  SeatInventory::Stripe& SeatInventory::stripeFor(uint64_t key) {
+    return const_cast<Stripe&>(
+      static_cast<const SeatInventory*>(this)->stripeFor(key));
+  }
+
+  SeatInventory::Occupancy& SeatInventory::occupancy(unsigned raId,
+                                                     const date &d) {
+    const Occupancy *existing = find(raId, d);
+    if(nullptr != existing)
+      return const_cast<Occupancy&>(*existing);
+
+    const uint64_t key = keyOf(raId, d);
+    Stripe &stripe = stripeFor(key);
+    lock_guard<mutex> lock(stripe.guard);
+    Table *table = stripe.tables.back().get();
+    size_t slot = slotOf(*table, key);
+    for(uint64_t k; (k = table->keys[slot].load(memory_order_relaxed)) != 0ULL;
+        slot = (slot + 1ULL) & table->mask)
+      if(k == key) // created meanwhile by another thread
+        return *table->occupancies[slot].load(memory_order_relaxed);
+
+    // Keeping the table at most half full keeps the probes short
+    if(2ULL * (table->used + 1ULL) > table->mask + 1ULL) {
+      unique_ptr<Table> larger = make_unique<Table>(2ULL * (table->mask + 1ULL));
+      for(size_t i = 0ULL; i <= table->mask; ++i) {
+        const uint64_t k = table->keys[i].load(memory_order_relaxed);
+        if(k == 0ULL)
+          continue;
+        size_t j = slotOf(*larger, k);
+        while(larger->keys[j].load(memory_order_relaxed) != 0ULL)
+          j = (j + 1ULL) & larger->mask;
+        larger->occupancies[j].store(
+          table->occupancies[i].load(memory_order_relaxed),
+          memory_order_relaxed);
+        larger->keys[j].store(k, memory_order_relaxed);
+      }
+      larger->used = table->used;
+      table = larger.get();
+      stripe.tables.push_back(move(larger));
+      stripe.table.store(table, memory_order_release); // publishes the copy
+
+      slot = slotOf(*table, key);
+      while(table->keys[slot].load(memory_order_relaxed) != 0ULL)
+        slot = (slot + 1ULL) & table->mask;
+    }
+
+    stripe.counters.push_back(make_unique<Occupancy>());
+    Occupancy *result = stripe.counters.back().get();
+
+    // Readers finding the key must see the counter, so the key comes last
+    table->occupancies[slot].store(result, memory_order_relaxed);
+    table->keys[slot].store(key, memory_order_release);
+    ++table->used;
+    return *result;
+  }
+
+  const SeatInventory::Occupancy* SeatInventory::find(unsigned raId,
+                                                      const date &d) const {
+    const uint64_t key = keyOf(raId, d);
+    const Table &table = *stripeFor(key).table.load(memory_order_acquire);
+    for(size_t slot = slotOf(table, key);; slot = (slot + 1ULL) & table.mask) {
+      const uint64_t k = table.keys[slot].load(memory_order_acquire);
+      if(k == key)
+        return table.occupancies[slot].load(memory_order_relaxed);
+      if(k == 0ULL)
+        return nullptr;
+    }
+  }
+
+  unsigned SeatInventory::occupied(const Leg &leg) const {
+    const Occupancy *occ = find(leg.raId, leg.date);
+    if(nullptr == occ)
+      return 0U;
+    return occ->seats(leg.economyClass).load();
+  }
+
+  shared_ptr<const SeatInventory::View> SeatInventory::view() const {
+    return _view;
+  }
+
+  bool SeatInventory::tryOccupy(atomic<unsigned> &counter, unsigned seats,
+                                unsigned capacity, unsigned &freeSeats) {
+    unsigned taken = counter.load();
+    for(;;) {
+      // capacity might have been reduced by a data update
+      freeSeats = (taken < capacity) ? (capacity - taken) : 0U;
+      if(seats > freeSeats)
+        return false;
+
+      // On failure, taken receives the value set meanwhile by other bookings
+      if(counter.compare_exchange_weak(taken, taken + seats)) {
+        return true;
+      }
+    }
+  }
+
+  void SeatInventory::release(atomic<unsigned> &counter, unsigned seats) {
+    const unsigned previouslyTaken = counter.fetch_sub(seats);
+#ifndef NDEBUG
+    assert(previouslyTaken >= seats);
+#else // NDEBUG
+    (void)previouslyTaken;
+#endif // NDEBUG
+  }
+
+}} // namespace tp::bookings
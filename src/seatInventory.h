@@ -0,0 +1,177 @@
+/*****************************************************************************
+ TripPlanner explores various issues common to navigation and booking systems.
+
+ Copyrights from the libraries used by the program:
+ - (c) 2017 Boost (www.boost.org)
+		License: <http://www.boost.org/LICENSE_1_0.txt>
+ 
+ (c) 2017 Florin Tulba <florintulba@yahoo.com>
+
+ This program is free software: you can use its results,
+ redistribute it and/or modify it under the terms of the GNU
+ Affero General Public License version 3 as published by the
+ Free Software Foundation.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU Affero General Public License for more details.
+
+ You should have received a copy of the GNU Affero General Public License
+ along with this program ('agpl-3.0.txt').
+ If not, see <http://www.gnu.org/licenses/agpl-3.0.txt>.
+ *****************************************************************************/
+
+#ifndef H_SEAT_INVENTORY
+#define H_SEAT_INVENTORY
+
+#include "bookingBase.h"
+
+#pragma warning ( push, 0 )
+
+#include <atomic>
+#include <array>
+#include <memory>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#pragma warning ( pop )
+
+// namespace trip planner - bookings
+namespace tp { namespace bookings {
+
+  /**
+  Occupied seats of every route alternative traveling on a given date.
+
+  The counters are created on demand within one of several stripes.
+  Each stripe indexes its counters within an insert-only hash table,
+  which readers probe without locking. Creating a counter locks only
+  its stripe and replaces a full table by a larger copy; the replaced
+  tables live as long as the inventory, so readers never see them freed.
+  Occupying and releasing seats operate directly on atomic counters.
+  */
+  class SeatInventory {
+  public:
+    /// Read-only access to the live counters of the inventory
+    class View : public IOccupancyView {
+    protected:
+      const SeatInventory &inventory; ///< the inspected inventory
+
+    public:
+      View(const SeatInventory &inventory_);
+
+      /// @return the occupied seats of the class chosen by leg
+      unsigned occupied(const Leg &leg) const override;
+    };
+
+    /// Occupied seats of a route alternative on a given date
+    struct Occupancy {
+      std::atomic<unsigned> economy;  ///< occupied economy class seats
+      std::atomic<unsigned> business; ///< occupied business class seats
+
+      Occupancy() : economy(0U), business(0U) {}
+
+      /// @return the counter for the economy / business class
+      std::atomic<unsigned>& seats(bool economyClass) {
+        return economyClass ? economy : business;
+      }
+
+      /// @return the counter for the economy / business class
+      const std::atomic<unsigned>& seats(bool economyClass) const {
+        return economyClass ? economy : business;
+      }
+    };
+
+  protected:
+    /// Count of the independently locked parts of the inventory
+    static constexpr size_t StripesCount = 64ULL;
+
+    /// Initial count of slots of the table of each stripe (a power of 2)
+    static constexpr size_t InitialSlots = 16ULL;
+
+    /// Insert-only open addressing table: keys followed by their occupancies
+    struct Table {
+      const size_t mask; ///< slots count - 1
+      std::unique_ptr<std::atomic<uint64_t>[]> keys; ///< 0 for free slots
+      std::unique_ptr<std::atomic<Occupancy*>[]> occupancies; ///< by slot
+      size_t used = 0ULL; ///< the count of keys; changed under the lock
+
+      Table(size_t slots); ///< slots must be a power of 2
+    };
+
+    /// Part of the inventory with its own lock for creating counters
+    struct Stripe {
+      std::mutex guard; ///< serializes the creation of the counters
+
+      /// The table probed by the readers
+      std::atomic<const Table*> table;
+
+      /// The current table and the replaced ones
+      std::vector<std::unique_ptr<Table>> tables;
+
+      /// Owns the counters, whose address never changes
+      std::vector<std::unique_ptr<Occupancy>> counters;
+
+      Stripe();
+    };
+
+    std::array<Stripe, StripesCount> stripes; ///< the parts of the inventory
+
+    /// Shared by all the searches
+    const std::shared_ptr<const View> _view;
+
+    /// Combines raId and the date into a single value, never 0
+    static uint64_t keyOf(unsigned raId, const boost::gregorian::date &d);
+
+    /// @return the slot from table where key is or would be inserted
+    static size_t slotOf(const Table &table, uint64_t key);
+
+    /// @return the stripe responsible for key
+    const Stripe& stripeFor(uint64_t key) const;
+    Stripe& stripeFor(uint64_t key); ///< @return the stripe responsible for key
+
+  public:
+    SeatInventory();
+    SeatInventory(const SeatInventory&) = delete;
+    SeatInventory(SeatInventory&&) = delete;
+    void operator=(const SeatInventory&) = delete;
+    void operator=(SeatInventory&&) = delete;
+
+    /// @return the occupancy of raId on date d, creating it when missing
+    Occupancy& occupancy(unsigned raId, const boost::gregorian::date &d);
+
+    /// @return the occupancy of raId on date d,
+    /// or nullptr when nothing was booked there yet. It never blocks
+    const Occupancy* find(unsigned raId, const boost::gregorian::date &d) const;
+
+    /// @return the occupied seats of the class chosen by leg
+    unsigned occupied(const Leg &leg) const;
+
+    /**
+    @return read-only access to the live counters, for the searches.
+    Publishing the bookings costs nothing, as the counters are shared.
+    */
+    std::shared_ptr<const View> view() const;
+
+    /**
+    Occupies `seats` more seats from counter, unless this exceeds capacity.
+    It never blocks (compare-and-swap loop).
+
+    @param counter the occupied seats of a certain class
+    @param seats the seats to be occupied
+    @param capacity the total seats of that class
+    @param freeSeats receives the free seats found by the last attempt
+
+    @return true if the seats were occupied
+    */
+    bool tryOccupy(std::atomic<unsigned> &counter, unsigned seats,
+                   unsigned capacity, unsigned &freeSeats);
+
+    /// Releases `seats` seats previously occupied from counter
+    void release(std::atomic<unsigned> &counter, unsigned seats);
+  };
+
+}} // namespace tp::bookings
+
+#endif // H_SEAT_INVENTORY
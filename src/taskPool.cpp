@@ -0,0 +1,163 @@
+/*****************************************************************************
+ TripPlanner explores various issues common to navigation and booking systems.
+
+ Copyrights from the libraries used by the program:
+ - (c) 2017 Boost (www.boost.org)
+		License: <http://www.boost.org/LICENSE_1_0.txt>
+ 
+ (c) 2017 Florin Tulba <florintulba@yahoo.com>
+
+ This program is free software: you can use its results,
+ redistribute it and/or modify it under the terms of the GNU
+ Affero General Public License version 3 as published by the
+ Free Software Foundation.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU Affero General Public License for more details.
+
+ You should have received a copy of the GNU Affero General Public License
+ along with this program ('agpl-3.0.txt').
+ If not, see <http://www.gnu.org/licenses/agpl-3.0.txt>.
+ *****************************************************************************/
+
+#include "taskPool.h"
+
+#pragma warning ( push, 0 )
+
+#include <algorithm>
+
+#pragma warning ( pop )
+
+using namespace std;
+
+namespace tp { // trip planner
+
+  struct TaskPool::Loop {
+    const function<void(size_t)> &body; ///< the body of the loop
+    atomic<size_t> remaining; ///< count of the unfinished iterations
+    mutex guard;              ///< protects the fields below and the end of the loop
+    condition_variable done;  ///< notified by the last iteration
+    exception_ptr failure;    ///< the first exception thrown by body
+
+    Loop(const function<void(size_t)> &body_, size_t count) :
+      body(body_), remaining(count) {}
+  };
+
+  TaskPool::TaskPool(unsigned threads/* = 0U*/) {
+    if(threads == 0U)
+      threads = max(thread::hardware_concurrency(), 1U);
+
+    for(unsigned i = 0U; i < threads; ++i)
+      queues.push_back(make_unique<Queue>());
+    for(unsigned i = 0U; i < threads; ++i)
+      workers.emplace_back(&TaskPool::work, this, size_t(i));
+  }
+
+  TaskPool::~TaskPool() {
+    {
+      lock_guard<mutex> lock(idleGuard);
+      stopping = true;
+    }
+    wakeUp.notify_all();
+    for(thread &worker : workers)
+      worker.join();
+  }
+
+  size_t TaskPool::size() const {
+    return workers.size();
+  }
+
+  bool TaskPool::take(size_t preferred, Task &task) {
+    // The own queue is used like a stack, to keep its recent tasks cache-warm
+    {
+      Queue &own = *queues[preferred];
+      lock_guard<mutex> lock(own.guard);
+      if(!own.tasks.empty()) {
+        task = own.tasks.back();
+        own.tasks.pop_back();
+        --queued;
+        return true;
+      }
+    }
+
+    // Stealing the oldest task of another queue
+    const size_t queuesCount = queues.size();
+    for(size_t i = 1ULL; i < queuesCount; ++i) {
+      Queue &other = *queues[(preferred + i) % queuesCount];
+      lock_guard<mutex> lock(other.guard);
+      if(!other.tasks.empty()) {
+        task = other.tasks.front();
+        other.tasks.pop_front();
+        --queued;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void TaskPool::run(const Task &task) {
+    Loop &loop = *task.loop;
+    exception_ptr failure;
+    try {
+      loop.body(task.idx);
+    } catch(...) {
+      failure = current_exception();
+    }
+
+    // The loop might end as soon as remaining reaches 0,
+    // so loop isn't used after releasing its guard
+    lock_guard<mutex> lock(loop.guard);
+    if(failure && !loop.failure)
+      loop.failure = failure;
+    if(--loop.remaining == 0ULL)
+      loop.done.notify_all();
+  }
+
+  void TaskPool::work(size_t idx) {
+    for(;;) {
+      Task task;
+      if(take(idx, task)) {
+        run(task);
+        continue;
+      }
+
+      unique_lock<mutex> lock(idleGuard);
+      wakeUp.wait(lock, [this] { return stopping || queued > 0ULL; });
+      if(stopping && queued == 0ULL)
+        return;
+    }
+  }
+
+  void TaskPool::parallelFor(size_t count, const function<void(size_t)> &body) {
+    if(count == 0ULL)
+      return;
+
+    Loop loop(body, count);
+
+    // Counted before being queued, so the idle workers can't miss them
+    queued += count;
+    const size_t queuesCount = queues.size(), first = nextQueue++;
+    for(size_t i = 0ULL; i < count; ++i) {
+      Queue &q = *queues[(first + i) % queuesCount];
+      lock_guard<mutex> lock(q.guard);
+      q.tasks.push_back(Task { &loop, i });
+    }
+    {
+      lock_guard<mutex> lock(idleGuard);
+    }
+    wakeUp.notify_all();
+
+    // The calling thread helps until there is nothing left to take
+    Task task;
+    while(loop.remaining > 0ULL && take(first % queuesCount, task))
+      run(task);
+
+    unique_lock<mutex> lock(loop.guard);
+    loop.done.wait(lock, [&loop] { return loop.remaining == 0ULL; });
+    if(loop.failure)
+      rethrow_exception(loop.failure);
+  }
+
+} // namespace tp
@@ -0,0 +1,115 @@
+/*****************************************************************************
+ TripPlanner explores various issues common to navigation and booking systems.
+
+ Copyrights from the libraries used by the program:
+ - (c) 2017 Boost (www.boost.org)
+		License: <http://www.boost.org/LICENSE_1_0.txt>
+ 
+ (c) 2017 Florin Tulba <florintulba@yahoo.com>
+
+ This program is free software: you can use its results,
+ redistribute it and/or modify it under the terms of the GNU
+ Affero General Public License version 3 as published by the
+ Free Software Foundation.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU Affero General Public License for more details.
+
+ You should have received a copy of the GNU Affero General Public License
+ along with this program ('agpl-3.0.txt').
+ If not, see <http://www.gnu.org/licenses/agpl-3.0.txt>.
+ *****************************************************************************/
+
+#ifndef H_TASK_POOL
+#define H_TASK_POOL
+
+#pragma warning ( push, 0 )
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#pragma warning ( pop )
+
+namespace tp { // trip planner
+
+  /**
+  A pool of threads running the tasks of parallel loops.
+
+  Every worker owns a queue of tasks. A loop deals its tasks among
+  these queues and the workers start with their own queue (from its back),
+  taking tasks from the other queues (from their front) once theirs is empty,
+  so the workers finishing early steal the work of the busy ones.
+  The thread starting a loop runs its tasks, too, until the loop completes.
+  That keeps working also when a task starts a nested loop.
+  */
+  class TaskPool {
+  protected:
+    struct Loop;  ///< the state of a running parallel loop
+
+    /// Iteration idx of a loop
+    struct Task {
+      Loop *loop;
+      size_t idx;
+    };
+
+    /// The queue of a worker
+    struct Queue {
+      std::mutex guard;       ///< protects tasks
+      std::deque<Task> tasks; ///< tasks waiting to run
+    };
+
+    std::vector<std::unique_ptr<Queue>> queues; ///< the queue of each worker
+    std::vector<std::thread> workers; ///< the threads of the pool
+
+    std::mutex idleGuard;               ///< protects the waits of idle workers
+    std::condition_variable wakeUp;     ///< notifies idle workers
+    std::atomic<size_t> queued { 0ULL };///< count of the tasks within queues
+    bool stopping = false;              ///< set by the destructor
+
+    std::atomic<size_t> nextQueue { 0ULL }; ///< where to deal the next task
+
+    /// Takes a task from queues[preferred] or from another queue
+    /// @return false if all queues are empty
+    bool take(size_t preferred, Task &task);
+
+    /// Runs task, recording a possible exception within its loop
+    static void run(const Task &task);
+
+    /// The loop of worker `idx`
+    void work(size_t idx);
+
+  public:
+    /// Starts `threads` workers; 0 starts a worker for every core
+    explicit TaskPool(unsigned threads = 0U);
+
+    TaskPool(const TaskPool&) = delete;
+    TaskPool(TaskPool&&) = delete;
+    void operator=(const TaskPool&) = delete;
+    void operator=(TaskPool&&) = delete;
+
+    ~TaskPool(); ///< waits for the workers to finish their tasks
+
+    /// @return the count of workers
+    size_t size() const;
+
+    /**
+    Calls body(i) for every i in [0, count), in parallel,
+    returning after all the calls finished.
+
+    @throw the first exception thrown by body, after all the calls finished
+    */
+    void parallelFor(size_t count, const std::function<void(size_t)> &body);
+  };
+
+} // namespace tp
+
+#endif // H_TASK_POOL
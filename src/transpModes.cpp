@@ -27,6 +27,8 @@
 #pragma warning ( push, 0 )
 
 #include <map>
+#include <string>
+#include <vector>
 #include <sstream>
 #include <stdexcept>
 
@@ -38,26 +40,29 @@ using namespace std;
 namespace tp { namespace specs {
 
   const char* TranspModes::toString(size_t masksCombination) {
-	  static const char* combinations[] {
-		  "None",	// 0
-		  "Air",	// 1
-		  "Rail",	// 2
-		  "Air+Rail",	// 3
-		  "Road",	// 4
-		  "Air+Road", // 5
-		  "Rail+Road", // 6
-		  "Air+Rail+Road", // 7
-		  "Water", // 8
-		  "Air+Water", // 9
-		  "Rail+Water", // 10
-		  "Air+Rail+Water", // 11
-		  "Road+Water", // 12
-		  "Air+Road+Water", // 13
-		  "Rail+Road+Water", // 14
-		  "Air+Rail+Road+Water" // 15
-	  };
-
-	  static constexpr size_t namesCount = sizeof(combinations) / sizeof(char*);
+	  // "None", "Air", "Rail", "Air+Rail", "Road", "Air+Road" ...
+	  static const vector<string> combinations = []() {
+		  static const char* modeNames[] { "Air", "Rail", "Road", "Water", "Foot" };
+		  static_assert(size_t(1ULL) << (sizeof(modeNames) / sizeof(char*) - 1ULL) ==
+                      size_t(TranspModes::last),
+                    "modeNames must cover all TranspModes!");
+
+		  vector<string> result { "None" };
+		  for(size_t i = 1ULL, lim = size_t(TranspModes::last<<1); i < lim; ++i) {
+			  string name;
+			  for(size_t bit = 0ULL; (size_t(1ULL) << bit) <= i; ++bit) {
+				  if((i & (size_t(1ULL) << bit)) == 0ULL)
+					  continue;
+				  if(!name.empty())
+					  name += '+';
+				  name += modeNames[bit];
+			  }
+			  result.push_back(name);
+		  }
+		  return result;
+	  } ();
+
+	  const size_t namesCount = combinations.size();
 	  if(masksCombination == 0ULL || masksCombination >= namesCount) {
 		  ostringstream oss;
 		  oss<<__func__<<" accepts values between [1,"
@@ -65,7 +70,7 @@ namespace tp { namespace specs {
 		  throw invalid_argument(oss.str());
 	  }
 
-	  return combinations[masksCombination];
+	  return combinations[masksCombination].c_str();
   }
 
   size_t TranspModes::fromString(const char* description) {
@@ -41,8 +41,11 @@ namespace tp { namespace specs {
 		  RAIL = 1<<1,
 		  ROAD = 1<<2,
 		  WATER = 1<<3,
+		  FOOT = 1<<4, ///< walking between nearby places or along foot routes
 
-		  last = WATER // update this to be the last introduce transport mode
+		  last = FOOT, // update this to be the last introduce transport mode
+
+		  all = (last<<1) - 1 ///< the combination of all transportation modes
 	  };
 
 	  /// @return the description of the utilized transportation modes
@@ -0,0 +1,88 @@
+/*****************************************************************************
+ TripPlanner explores various issues common to navigation and booking systems.
+
+ Copyrights from the libraries used by the program:
+ - (c) 2017 Boost (www.boost.org)
+		License: <http://www.boost.org/LICENSE_1_0.txt>
+ 
+ (c) 2017 Florin Tulba <florintulba@yahoo.com>
+
+ This program is free software: you can use its results,
+ redistribute it and/or modify it under the terms of the GNU
+ Affero General Public License version 3 as published by the
+ Free Software Foundation.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU Affero General Public License for more details.
+
+ You should have received a copy of the GNU Affero General Public License
+ along with this program ('agpl-3.0.txt').
+ If not, see <http://www.gnu.org/licenses/agpl-3.0.txt>.
+ *****************************************************************************/
+
+
+#ifndef H_TRAVEL_MATRIX
+#define H_TRAVEL_MATRIX
+
+#pragma warning ( push, 0 )
+
+#include <cstdint>
+
+#pragma warning ( pop )
+
+// namespace trip planner - queries
+namespace tp { namespace queries {
+
+  /**
+  A cell of the origin-destination matrices from TripPlanner::travelMatrix.
+
+  The cells are plain values, so the matrices fit in a dense buffer,
+  in row-major order (a row for each origin).
+  */
+  struct TravelMatrixCell {
+    /// Value of earliestArrival when the destination cannot be reached in time
+    static constexpr int64_t Unreachable = INT64_MAX;
+
+    /// Earliest arrival at the destination as minutes since 1970-Jan-1 00:00,
+    /// or Unreachable
+    int64_t earliestArrival;
+
+    /// Shortest distance to the destination (km), regardless of the timetables.
+    /// Infinity for unreachable destinations
+    float minDistance;
+
+    /// Lowest sum of the normal economy fares towards the destination,
+    /// regardless of the timetables. Infinity for unreachable destinations
+    float minPrice;
+  };
+
+  /**
+  A place reached by TripPlanner::isochrone, together with the price and
+  the distance of the trip reaching it first.
+
+  The cells are plain values, so the isochrones fit in a dense buffer,
+  with a cell for each place.
+  */
+  struct IsochroneCell {
+    /// Value of earliestArrival when the place cannot be reached in time
+    static constexpr int64_t Unreachable = INT64_MAX;
+
+    unsigned placeId; ///< id of the reached place
+
+    /// Earliest arrival at the place as minutes since 1970-Jan-1 00:00,
+    /// or Unreachable
+    int64_t earliestArrival;
+
+    /// Sum of the normal economy fares of the trip arriving first.
+    /// Infinity for unreachable places
+    float price;
+
+    /// Length of the trip arriving first (km). Infinity for unreachable places
+    float distance;
+  };
+
+}} // namespace tp::queries
+
+#endif // H_TRAVEL_MATRIX
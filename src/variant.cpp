@@ -62,6 +62,18 @@ namespace tp { namespace queries {
 	  return conns;
   }
 
+  size_t Variant::connectionsCount() const {
+	  return conns.size();
+  }
+
+  const IConnection& Variant::connection(size_t idx) const {
+	  if(idx >= conns.size())
+		  throw out_of_range(string(__func__) + " invalid idx!");
+
+	  assert(conns[idx]);
+	  return *conns[idx];
+  }
+
   ptime Variant::begin() const {
 	  assert(!conns.empty() && conns.back());
 	  return conns.front()->begin();
@@ -119,27 +131,35 @@ ostream& operator<<(ostream &os, const tp::queries::IVariant &variant) {
   using namespace tp::specs;
   using namespace tp::queries;
   using namespace tp::var;
-  const vector<unique_ptr<IConnection>> &conns = variant.connections();
-	const size_t count = conns.size();
+	const size_t count = variant.connectionsCount();
+
+	// The moments and the durations are written without temporary strings
+	char beginText[TimePointBufferSize], endText[TimePointBufferSize],
+		durationText[DurationBufferSize];
+	formatTimePoint(variant.begin(), beginText);
+	formatTimePoint(variant.end(), endText);
+	formatDuration(variant.duration(), durationText);
 	os<<"Summary: "
-		<<variant.from()<<" ["<<formatTimePoint(variant.begin())<<" - "
+		<<variant.from()<<" ["<<beginText<<" - "
 		<<TranspModes::toString(variant.transpModes())<<"; "
 		<<roundf(10.f * variant.distance())/10.f<<"km; "
-		<<formatDuration(variant.duration())<<"; "
+		<<durationText<<"; "
 		<<roundf(100.f * variant.price())/100.f<<"$ - "
-		<<formatTimePoint(variant.end())<<"] "<<variant.to()
+		<<endText<<"] "<<variant.to()
 		<<endl;
 	os<<"Details:"<<endl;
 	os<<variant.from();
 	for(size_t i = 0ULL; i < count; ++i) {
-		const unique_ptr<IConnection> &c = conns[i];
-		assert(c);
-		os<<" ["<<formatTimePoint(c->begin())<<" - "
-			<<TranspModes::toString(c->transpModes())<<"; "
-			<<roundf(10.f * c->distance())/10.f<<"km; "
-			<<formatDuration(c->duration())<<"; "
-			<<roundf(100.f * c->price())/100.f<<"$ - "
-			<<formatTimePoint(c->end())<<"] "<<c->to();
+		const IConnection &c = variant.connection(i);
+		formatTimePoint(c.begin(), beginText);
+		formatTimePoint(c.end(), endText);
+		formatDuration(c.duration(), durationText);
+		os<<" ["<<beginText<<" - "
+			<<TranspModes::toString(c.transpModes())<<"; "
+			<<roundf(10.f * c.distance())/10.f<<"km; "
+			<<durationText<<"; "
+			<<roundf(100.f * c.price())/100.f<<"$ - "
+			<<endText<<"] "<<c.to();
 	}
 	os<<endl;
 	return os;
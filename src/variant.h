@@ -42,6 +42,12 @@ namespace tp { namespace queries {
 	  /// @return the connections
 	  const std::vector<std::unique_ptr<IConnection>>& connections() const override;
 
+	  /// @return the count of connections
+	  size_t connectionsCount() const override;
+
+	  /// @return connection idx. Throws out_of_range for an invalid idx
+	  const IConnection& connection(size_t idx) const override;
+
 	  /// The start of the interval
 	  boost::posix_time::ptime begin() const override;
 
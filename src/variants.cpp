@@ -48,14 +48,23 @@ namespace tp { namespace queries {
 	  return variants;
   }
 
+  size_t Variants::count() const {
+	  return variants.size();
+  }
+
+  const IVariant& Variants::at(size_t idx) const {
+	  if(idx >= variants.size())
+		  throw out_of_range(string(__func__) + " invalid idx!");
+
+	  assert(variants[idx]);
+	  return *variants[idx];
+  }
+
 }} // namespace tp::queries
 
 ostream& operator<<(ostream &os, const tp::queries::IVariants &variants) {
-	const vector<unique_ptr<tp::queries::IVariant>> &v = variants.get();
-	const size_t count = v.size();
-	for(size_t i = 0ULL; i < count; ++i) {
-		assert(v[i]);
-		os<<"Variant "<<i<<endl<<*v[i]<<endl;
-	}
+	const size_t count = variants.count();
+	for(size_t i = 0ULL; i < count; ++i)
+		os<<"Variant "<<i<<endl<<variants.at(i)<<endl;
 	return os;
 }
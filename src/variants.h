@@ -41,6 +41,12 @@ namespace tp { namespace queries {
 
 	  /// @return the stored variants
 	  const std::vector<std::unique_ptr<IVariant>>& get() const override;
+
+	  /// @return the count of stored variants
+	  size_t count() const override;
+
+	  /// @return variant idx. Throws out_of_range for an invalid idx
+	  const IVariant& at(size_t idx) const override;
   };
 
 }} // namespace tp::queries
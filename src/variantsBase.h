@@ -81,6 +81,12 @@ namespace tp { namespace queries {
 
     /// @return the connections 
 	  virtual const std::vector<std::unique_ptr<IConnection>>& connections() const = 0;
+
+	  /// @return the count of connections
+	  virtual size_t connectionsCount() const = 0;
+
+	  /// @return connection idx, without building the vector from connections()
+	  virtual const IConnection& connection(size_t idx) const = 0;
   };
 
   /// The variants within a certain category
@@ -89,6 +95,12 @@ namespace tp { namespace queries {
 
 	  /// @return the stored variants
 	  virtual const std::vector<std::unique_ptr<IVariant>>& get() const = 0;
+
+	  /// @return the count of stored variants
+	  virtual size_t count() const = 0;
+
+	  /// @return variant idx, without building the vector from get()
+	  virtual const IVariant& at(size_t idx) const = 0;
   };
 
 }} // namespace tp::queries